@@ -75,7 +75,36 @@ my $streamitem =
                 current_pending => 7, uncorrectables => 8,
                 soft_read_error_rate => 9, g_sense_error_rate => 10,
                 temperature2 => 10, free_fall_protection => 11},
-     load   => {load1 => 1, load5 => 2, load15 => 3}
+     load   => {load1 => 1, load5 => 2, load15 => 3},
+     cpuagg => {busy_min => 1, busy_max => 2, busy_avg => 3, busy_p99 => 4},
+     ifagg  => {ibytes_min => 1, ibytes_max => 2, ibytes_avg => 3,
+                ibytes_p99 => 4, obytes_min => 5, obytes_max => 6,
+                obytes_avg => 7, obytes_p99 => 8, ipackets_min => 9,
+                ipackets_max => 10, ipackets_avg => 11, ipackets_p99 => 12,
+                opackets_min => 13, opackets_max => 14, opackets_avg => 15,
+                opackets_p99 => 16},
+     ioagg  => {rbytes_min => 1, rbytes_max => 2, rbytes_avg => 3,
+                rbytes_p99 => 4, wbytes_min => 5, wbytes_max => 6,
+                wbytes_avg => 7, wbytes_p99 => 8, rxfer_min => 9,
+                rxfer_max => 10, rxfer_avg => 11, rxfer_p99 => 12,
+                wxfer_min => 13, wxfer_max => 14, wxfer_avg => 15,
+                wxfer_p99 => 16},
+     cpuhist => {b0_10 => 1, b10_20 => 2, b20_30 => 3, b30_40 => 4,
+                 b40_50 => 5, b50_60 => 6, b60_70 => 7, b70_80 => 8,
+                 b80_90 => 9, b90_100 => 10},
+     cgroup => {usage_usec => 1, user_usec => 2, system_usec => 3,
+                nr_throttled => 4, throttled_usec => 5, mem_current => 6,
+                mem_anon => 7, mem_file => 8, rbytes => 9, wbytes => 10,
+                rios => 11, wios => 12, cpu_some => 13, mem_some => 14,
+                mem_full => 15},
+     plugin => {c0 => 1, c1 => 2, c2 => 3, c3 => 4, c4 => 5, c5 => 6,
+                c6 => 7, c7 => 8, g0 => 9, g1 => 10, g2 => 11, g3 => 12,
+                g4 => 13, g5 => 14, g6 => 15, g7 => 16},
+     exec   => {v0 => 1, v1 => 2, v2 => 3, v3 => 4, v4 => 5, v5 => 6,
+                v6 => 7, v7 => 8},
+     pressure => {some_avg10 => 1, some_avg60 => 2, some_avg300 => 3,
+                some_total => 4, full_avg10 => 5, full_avg60 => 6,
+                full_avg300 => 7, full_total => 8}
 };
 
 sub new {
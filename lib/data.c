@@ -54,9 +54,9 @@
 #include "net.h"
 #include "xmalloc.h"
 
+int bytelentype(int);
 int bytelenvar(char);
 int checklen(int, int, int);
-struct stream *create_stream(int, char *);
 char *formatstrvar(char);
 char *rrdstrvar(char);
 int strlenvar(char);
@@ -113,6 +113,14 @@ struct {
     { MT_FLUKSO, "D" },
     { MT_WG, "LLl" },
     { MT_TIME, "l" },
+    { MT_CPUAGG, "cccc" },
+    { MT_IFAGG, "LLLLLLLLLLLLLLLL" },
+    { MT_IOAGG, "LLLLLLLLLLLLLLLL" },
+    { MT_CPUHIST, "ssssssssss" },
+    { MT_CGROUP, "LLLLLLLLLLLLccc" },
+    { MT_PLUGIN, "LLLLLLLLDDDDDDDD" },
+    { MT_EXEC, "DDDDDDDD" },
+    { MT_PRESSURE, "cccLcccL" },
     { MT_TEST, "LLLLDDDDllllssssccccbbbb" },
     { MT_EOT, "" }
 };
@@ -141,6 +149,14 @@ struct {
     { MT_FLUKSO, LXT_FLUKSO },
     { MT_WG, LXT_WG },
     { MT_TIME, LXT_TIME },
+    { MT_CPUAGG, LXT_CPUAGG },
+    { MT_IFAGG, LXT_IFAGG },
+    { MT_IOAGG, LXT_IOAGG },
+    { MT_CPUHIST, LXT_CPUHIST },
+    { MT_CGROUP, LXT_CGROUP },
+    { MT_PLUGIN, LXT_PLUGIN },
+    { MT_EXEC, LXT_EXEC },
+    { MT_PRESSURE, LXT_PRESSURE },
     { MT_EOT, LXT_BADTOKEN }
 };
 /* parallel crc32 table */
@@ -181,6 +197,17 @@ type2str(const int streamtype)
 }
 /* Return the maximum lenght of the ascii representation of type <type> */
 int
+bytelentype(int type)
+{
+    int i = 0;
+    int sum = 0;
+
+    while (streamform[type].form[i])
+        sum += bytelenvar(streamform[type].form[i++]);
+
+    return sum;
+}
+int
 strlentype(int type)
 {
     int i = 0;
@@ -834,8 +861,10 @@ add_mux(struct muxlist * mul, char *name)
     p = (struct mux *) xmalloc(sizeof(struct mux));
     bzero(p, sizeof(struct mux));
     p->name = xstrdup(name);
+    p->socktype = SOCK_DGRAM;
     SLIST_INSERT_HEAD(mul, p, muxes);
     SLIST_INIT(&p->sol);
+    SLIST_INIT(&p->cl);
 
     return p;
 }
@@ -859,6 +888,7 @@ rename_mux(struct muxlist * mul, struct mux * mux, char *name)
 void
 free_muxlist(struct muxlist * mul)
 {
+    struct symonconn *c;
     struct mux *p, *np;
     int i;
 
@@ -880,10 +910,25 @@ free_muxlist(struct muxlist * mul)
             close(p->symuxsocket);
         if (p->packet.data)
             xfree(p->packet.data);
+        if (p->queue)
+            xfree(p->queue);
+        if (p->spoolfile)
+            xfree(p->spoolfile);
 
-        for (i = 0; i < AF_MAX; i++)
+        for (i = 0; i < AF_MAX; i++) {
             if (p->symonsocket[i])
                 close(p->symonsocket[i]);
+            if (p->symonlistener[i])
+                close(p->symonlistener[i]);
+        }
+
+        while (!SLIST_EMPTY(&p->cl)) {
+            c = SLIST_FIRST(&p->cl);
+            SLIST_REMOVE_HEAD(&p->cl, conns);
+            close(c->fd);
+            xfree(c->data);
+            xfree(c);
+        }
 
         free_streamlist(&p->sl);
         free_sourcelist(&p->sol);
@@ -893,6 +938,30 @@ free_muxlist(struct muxlist * mul)
     }
 }
 void
+free_stream(struct stream * p)
+{
+    int i;
+
+    if (p->arg != NULL)
+        xfree(p->arg);
+    if (p->file != NULL)
+        xfree(p->file);
+    if (p->pending != NULL) {
+        for (i = 0; i < p->npending; i++)
+            xfree(p->pending[i]);
+        xfree(p->pending);
+    }
+    if (p->sample != NULL)
+        xfree(p->sample);
+    if (p->agg != NULL) {
+        for (i = 0; i < SYMON_AGGFIELDS; i++)
+            if (p->agg->samples[i] != NULL)
+                xfree(p->agg->samples[i]);
+        xfree(p->agg);
+    }
+    xfree(p);
+}
+void
 free_streamlist(struct streamlist * sl)
 {
     struct stream *p, *np;
@@ -904,13 +973,7 @@ free_streamlist(struct streamlist * sl)
 
     while (p) {
         np = SLIST_NEXT(p, streams);
-
-        if (p->arg != NULL)
-            xfree(p->arg);
-        if (p->file != NULL)
-            xfree(p->file);
-        xfree(p);
-
+        free_stream(p);
         p = np;
     }
 }
@@ -944,13 +1007,15 @@ bytelen_streamlist(struct streamlist * sl)
 {
     struct stream *stream;
     int len = 0;
-    int i;
 
     SLIST_FOREACH(stream, sl, streams) {
+        /* wildcards can expand to a packet full of streams */
+        if (stream->pattern)
+            return SYMON_MAXPACKET - sizeof(struct symonpacketheader);
+
         len += 1; /* type */
         len += strlen(stream->arg) + 1; /* arg */
-        for (i = 0; streamform[stream->type].form[i] != 0; i++) /* packedstream */
-            len += bytelenvar(streamform[stream->type].form[i]);
+        len += bytelentype(stream->type); /* packedstream */
     }
 
     return len;
@@ -983,6 +1048,7 @@ strlen_sourcelist(struct sourcelist * sol)
     struct source *source;
     struct stream *stream;
     int maxlen;
+    int alen;
     int len;
     int n;
 
@@ -995,11 +1061,18 @@ strlen_sourcelist(struct sourcelist * sol)
     SLIST_FOREACH(source, sol, sources) {
         len = snprintf(&buf[0], _POSIX2_LINE_MAX, "%s;", source->addr);
         SLIST_FOREACH(stream, &source->sl, streams) {
-            len += strlen(type2str(stream->type)) + strlen(":");
-            len += strlen(stream->arg) + strlen(":");
-            len += (sizeof(time_t) * 3) + strlen(":"); /* 3 > ln(255) / ln(10) */
-            len += strlentype(stream->type);
-            n++;
+            /* a wildcard accepts as many streams as fit in a packet */
+            n = 1;
+            alen = strlen(stream->arg);
+            if (stream->pattern) {
+                n = SYMON_MAXPACKET / (bytelentype(stream->type) + 2);
+                alen = SYMON_PS_ARGLENV2 - 1;
+            }
+
+            len += n * (strlen(type2str(stream->type)) + strlen(":"));
+            len += n * (alen + strlen(":"));
+            len += n * ((sizeof(time_t) * 3) + strlen(":")); /* 3 > ln(255) / ln(10) */
+            len += n * strlentype(stream->type);
         }
         if (len > maxlen)
             maxlen = len;
@@ -1076,6 +1149,12 @@ init_crc32(void)
         crc32_table[i] = c;
     }
 }
+/* Does a stream argument contain shell wildcard characters */
+int
+is_wildcard(const char *arg)
+{
+    return (arg != NULL && strpbrk(arg, "*?[") != NULL);
+}
 int
 gcd(int a, int b)
 {
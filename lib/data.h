@@ -40,6 +40,8 @@
 
 #include "platform.h"
 
+#include <sys/time.h>
+
 #include <stdarg.h>
 #include <netinet/in.h>
 #include <limits.h>
@@ -76,6 +78,11 @@ static inline u_int64_t
 #define SYMON_PACKET_VER  2
 #define SYMON_UNKMUX   "<unknown mux>"  /* mux nodes without host addr */
 
+/* Over tcp each packet is preceded by its length as a network order
+ * u_int16: frame = length:packet
+ */
+#define SYMON_FRAMEHDR    2
+
 /* Sending structures over the network is dangerous as the compiler might have
  * added extra padding between items. symonpacketheader below is therefore also
  * marshalled and demarshalled via snpack and sunpack. The actual values are
@@ -101,10 +108,43 @@ struct symonpacket {
  *
  * A stream is meta data describing properties, a packed stream is the data itself.
  */
+/* Aggregated streams sample a base stream several times per interval and
+ * report min, max, avg and p99 of the rates seen */
+#define SYMON_AGGFIELDS 4
+
+struct aggregate {
+    int resolution;             /* ms between samples */
+    int count;                  /* samples taken this interval */
+    int size;                   /* samples allocated per field */
+    double *samples[SYMON_AGGFIELDS];
+    u_int64_t prev[SYMON_AGGFIELDS];    /* counters at previous sample */
+    struct timeval prevtime;
+    int primed;
+};
+
 struct stream {
     int type;
     char *arg;
     char *file;
+    time_t last;                /* symux; time of last stored sample */
+    char **pending;             /* symux; samples waiting for batch update */
+    int npending;
+    int failed;                 /* symux; a batch update failed since the
+                                 * source was last flushed */
+    struct aggregate *agg;      /* symon; state of aggregated streams */
+    int interval;               /* symon; seconds between measurements, 0 =
+                                 * every interval of the mux */
+    struct probe *probe;        /* symon; probe that measures the stream */
+    char *sample;               /* symon; result of the last get */
+    int samplelen;
+    int pattern;                /* arg is a wildcard that is expanded at
+                                 * runtime (symon) or on arrival (symux) */
+    struct stream *origin;      /* wildcard stream this one was expanded
+                                 * from (symon) or accepted by (symux) */
+    time_t seen;                /* symux; last sample of an accepted stream */
+    time_t tried;               /* symux; last look for its rrd file */
+    int uninit;                 /* symon; init waits until the probe of the
+                                 * module is done */
     SLIST_ENTRY(stream) streams;
     union stream_parg parg;
 };
@@ -119,18 +159,50 @@ struct source {
 };
 SLIST_HEAD(sourcelist, source);
 
+/* A tcp connection from a symon to symux */
+struct symonconn {
+    int fd;
+    struct source *source;
+    struct sockaddr_storage sockaddr;
+    u_int32_t len;              /* bytes in data */
+    u_int32_t size;             /* size of data */
+    u_int32_t skip;             /* bytes of oversized frame still to discard */
+    u_int32_t ack;              /* crc of last frame, network order */
+    int held;                   /* ack held back until samples are stored */
+    char *data;
+    SLIST_ENTRY(symonconn) conns;
+};
+SLIST_HEAD(connlist, symonconn);
+
 struct mux {
     char *name;
     char *addr;
     char *port;
     char *localaddr;
     struct sourcelist sol;
+    int socktype;               /* SOCK_DGRAM or SOCK_STREAM */
     int symonsocket[AF_MAX];    /* symux; incoming symon data */
+    int symonlistener[AF_MAX];  /* symux; incoming symon tcp connections */
+    struct connlist cl;         /* symux; accepted symon tcp connections */
+    struct symonconn *ackconn;  /* symux; connection of current packet */
+    int backlog;                /* symux; more packets of source waiting */
     int symuxsocket;            /* symon; outgoing data to mux */
-    int last;
+    int tcpstate;               /* symon; state of tcp connection to mux */
+    char *queue;                /* symon; frames waiting for tcp */
+    u_int32_t queuelen;
+    u_int32_t queuesize;
+    u_int32_t queuesent;        /* symon; bytes of queue already written */
+    struct mux *leader;         /* symon; mux that builds our packets */
+    char *spoolfile;            /* symon; spool for unacknowledged packets */
+    u_int32_t spoolsize;
+    struct spool *spool;
+    int phase;                  /* symon; ms between sampling and sending */
+    int sendpending;            /* symon; packet waits for its phase */
+    struct timeval sendtime;
     int interval;
     struct symonpacket packet;
     struct sockaddr_storage sockaddr;
+    struct sockaddr_storage localsockaddr;
     struct streamlist sl;
     u_int32_t senderr;
     SLIST_ENTRY(mux) muxes;
@@ -166,8 +238,16 @@ SLIST_HEAD(muxlist, mux);
 #define MT_FLUKSO 17
 #define MT_WG     18
 #define MT_TIME   19
-#define MT_TEST   20
-#define MT_EOT    21
+#define MT_CPUAGG 20
+#define MT_IFAGG  21
+#define MT_IOAGG  22
+#define MT_CPUHIST 23
+#define MT_CGROUP 24
+#define MT_PLUGIN 25
+#define MT_EXEC   26
+#define MT_PRESSURE 27
+#define MT_TEST   28
+#define MT_EOT    29
 
 /*
  * Unpacking of incoming packets is done via a packedstream structure. This
@@ -364,6 +444,58 @@ struct packedstream {
         struct {
             u_int32_t usec;
         }      ps_time;
+        struct {
+            u_int16_t busy[4];
+        }      ps_cpuagg;
+        struct {
+            u_int64_t ibytes[4];
+            u_int64_t obytes[4];
+            u_int64_t ipackets[4];
+            u_int64_t opackets[4];
+        }      ps_ifagg;
+        struct {
+            u_int64_t rbytes[4];
+            u_int64_t wbytes[4];
+            u_int64_t rxfer[4];
+            u_int64_t wxfer[4];
+        }      ps_ioagg;
+        struct {
+            u_int16_t cores[10];
+        }      ps_cpuhist;
+        struct {
+            u_int64_t usage_usec;
+            u_int64_t user_usec;
+            u_int64_t system_usec;
+            u_int64_t nr_throttled;
+            u_int64_t throttled_usec;
+            u_int64_t mem_current;
+            u_int64_t mem_anon;
+            u_int64_t mem_file;
+            u_int64_t rbytes;
+            u_int64_t wbytes;
+            u_int64_t rios;
+            u_int64_t wios;
+            u_int16_t cpu_some;
+            u_int16_t mem_some;
+            u_int16_t mem_full;
+        }      ps_cgroup;
+        struct {
+            u_int64_t counter[8];
+            int64_t gauge[8];
+        }      ps_plugin;
+        struct {
+            int64_t value[8];
+        }      ps_exec;
+        struct {
+            u_int16_t some_avg10;
+            u_int16_t some_avg60;
+            u_int16_t some_avg300;
+            u_int64_t some_total;
+            u_int16_t full_avg10;
+            u_int16_t full_avg60;
+            u_int16_t full_avg300;
+            u_int64_t full_total;
+        }      ps_pressure;
     }     data;
 };
 
@@ -373,6 +505,7 @@ int bytelen_sourcelist(struct sourcelist *);
 int bytelen_streamlist(struct streamlist *);
 int gcd(int a, int b);
 int getheader(char *, struct symonpacketheader *);
+int is_wildcard(const char *);
 int ps2strn(struct packedstream *, char *, int, int);
 int setheader(char *, struct symonpacketheader *);
 int snpack(char *, int, char *, int, ...);
@@ -393,11 +526,13 @@ struct source *find_source(struct sourcelist *, char *);
 struct source *find_source_sockaddr(struct sourcelist *, struct sockaddr *);
 struct stream *add_mux_stream(struct mux *, int, char *);
 struct stream *add_source_stream(struct source *, int, char *);
+struct stream *create_stream(int, char *);
 struct stream *find_mux_stream(struct mux *, int, char *);
 struct stream *find_source_stream(struct source *, int, char *);
 u_int32_t crc32(const void *, unsigned int);
 void free_muxlist(struct muxlist *);
 void free_sourcelist(struct sourcelist *);
+void free_stream(struct stream *);
 void free_streamlist(struct streamlist *);
 void init_crc32(void);
 void init_symon_packet(struct mux *);
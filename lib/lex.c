@@ -68,21 +68,28 @@ static struct {
     { ")", LXT_CLOSE },
     { ",", LXT_COMMA },
     { "accept", LXT_ACCEPT },
+    { "auto", LXT_AUTO },
+    { "cgroup", LXT_CGROUP },
     { "cpu", LXT_CPU },
+    { "cpuagg", LXT_CPUAGG },
+    { "cpuhist", LXT_CPUHIST },
     { "cpuiow", LXT_CPUIOW },
     { "datadir", LXT_DATADIR },
     { "debug", LXT_DEBUG },
     { "df", LXT_DF },
     { "every", LXT_EVERY },
+    { "exec", LXT_EXEC },
     { "flukso", LXT_FLUKSO },
     { "from", LXT_FROM },
     { "if", LXT_IF },
     { "if1", LXT_IF1 },
     { "if2", LXT_IF },
+    { "ifagg", LXT_IFAGG },
     { "in", LXT_IN },
     { "io", LXT_IO },
     { "io1", LXT_IO1 },
     { "io2", LXT_IO },
+    { "ioagg", LXT_IOAGG },
     { "load", LXT_LOAD },
     { "mbuf", LXT_MBUF },
     { "mem", LXT_MEM },
@@ -92,16 +99,24 @@ static struct {
     { "mux", LXT_MUX },
     { "pf", LXT_PF },
     { "pfq", LXT_PFQ },
+    { "phase", LXT_PHASE },
+    { "plugin", LXT_PLUGIN },
+    { "plugindir", LXT_PLUGINDIR },
     { "port", LXT_PORT },
+    { "pressure", LXT_PRESSURE },
     { "proc", LXT_PROC },
+    { "resolution", LXT_RESOLUTION },
     { "second", LXT_SECOND },
     { "seconds", LXT_SECONDS },
     { "sensor", LXT_SENSOR },
     { "smart", LXT_SMART },
     { "source", LXT_SOURCE },
+    { "spool", LXT_SPOOL },
     { "stream", LXT_STREAM },
+    { "tcp", LXT_TCP },
     { "time", LXT_TIME },
     { "to", LXT_TO },
+    { "udp", LXT_UDP },
     { "wg", LXT_WG },
     { "write", LXT_WRITE },
     { NULL, 0 }
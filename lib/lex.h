@@ -40,45 +40,60 @@
 
 /* Tokens known to lex */
 #define LXT_ACCEPT     1
+#define LXT_AUTO       2
 #define LXT_BADTOKEN   0
-#define LXT_BEGIN      2
-#define LXT_CLOSE      3
-#define LXT_COMMA      4
-#define LXT_CPU        5
-#define LXT_CPUIOW     6
-#define LXT_DATADIR    7
-#define LXT_DEBUG      8
-#define LXT_DF         9
-#define LXT_END       10
-#define LXT_EVERY     11
-#define LXT_FLUKSO    12
-#define LXT_FROM      13
-#define LXT_IF        14
-#define LXT_IF1       15
-#define LXT_IN        16
-#define LXT_IO        17
-#define LXT_IO1       18
-#define LXT_LOAD      19
-#define LXT_MBUF      20
-#define LXT_MEM       21
-#define LXT_MEM1      22
-#define LXT_MONITOR   23
-#define LXT_MUX       24
-#define LXT_OPEN      25
-#define LXT_PF        26
-#define LXT_PFQ       27
-#define LXT_PORT      28
-#define LXT_PROC      29
-#define LXT_SECOND    30
-#define LXT_SECONDS   31
-#define LXT_SENSOR    32
-#define LXT_SMART     33
-#define LXT_SOURCE    34
-#define LXT_STREAM    35
-#define LXT_TIME      36
-#define LXT_TO        37
-#define LXT_WG        38
-#define LXT_WRITE     39
+#define LXT_BEGIN      3
+#define LXT_CGROUP     4
+#define LXT_CLOSE      5
+#define LXT_COMMA      6
+#define LXT_CPU        7
+#define LXT_CPUAGG     8
+#define LXT_CPUHIST    9
+#define LXT_CPUIOW    10
+#define LXT_DATADIR   11
+#define LXT_DEBUG     12
+#define LXT_DF        13
+#define LXT_END       14
+#define LXT_EVERY     15
+#define LXT_EXEC      16
+#define LXT_FLUKSO    17
+#define LXT_FROM      18
+#define LXT_IF        19
+#define LXT_IF1       20
+#define LXT_IFAGG     21
+#define LXT_IN        22
+#define LXT_IO        23
+#define LXT_IO1       24
+#define LXT_IOAGG     25
+#define LXT_LOAD      26
+#define LXT_MBUF      27
+#define LXT_MEM       28
+#define LXT_MEM1      29
+#define LXT_MONITOR   30
+#define LXT_MUX       31
+#define LXT_OPEN      32
+#define LXT_PF        33
+#define LXT_PFQ       34
+#define LXT_PHASE     35
+#define LXT_PLUGIN    36
+#define LXT_PLUGINDIR 37
+#define LXT_PORT      38
+#define LXT_PRESSURE  39
+#define LXT_PROC      40
+#define LXT_RESOLUTION 41
+#define LXT_SECOND    42
+#define LXT_SECONDS   43
+#define LXT_SENSOR    44
+#define LXT_SMART     45
+#define LXT_SOURCE    46
+#define LXT_SPOOL     47
+#define LXT_STREAM    48
+#define LXT_TCP       49
+#define LXT_TIME      50
+#define LXT_TO        51
+#define LXT_UDP       52
+#define LXT_WG        53
+#define LXT_WRITE     54
 
 struct lex {
     char *buffer;               /* current line(s) */
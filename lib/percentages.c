@@ -59,3 +59,48 @@ percentages(int cnt, int64_t *out, int64_t *new, int64_t *old, int64_t *diffs)
     /* return the total in case the caller wants to use it */
     return (total_change);
 }
+
+/*
+ * percentages for n objects at once. out, new, old and diffs hold cnt rows of
+ * stride counters, one column per object; totals holds n counters. The loops
+ * run along the rows without branches so that compilers can vectorise them.
+ * Division is done in double, which gives the same result as percentages()
+ * as long as a change times 1000 fits in 53 bits.
+ */
+void
+percentages_n(int cnt, int n, int stride, int64_t *out, int64_t *new, int64_t *old,
+              int64_t *diffs, int64_t *totals)
+{
+    int64_t change, *nw, *od, *df, *op;
+    double total;
+    int i, c;
+
+    for (c = 0; c < n; c++)
+        totals[c] = 0;
+
+    for (i = 0; i < cnt; i++) {
+        nw = new + i * stride;
+        od = old + i * stride;
+        df = diffs + i * stride;
+        for (c = 0; c < n; c++) {
+            change = nw[c] - od[c];
+            /* wrapped counters */
+            change = (change < 0) ? (QUAD_MAX - od[c]) + nw[c] : change;
+            df[c] = change;
+            totals[c] += change;
+            od[c] = nw[c];
+        }
+    }
+
+    for (c = 0; c < n; c++)
+        totals[c] = (totals[c] == 0) ? 1 : totals[c];
+
+    for (i = 0; i < cnt; i++) {
+        df = diffs + i * stride;
+        op = out + i * stride;
+        for (c = 0; c < n; c++) {
+            total = (double) totals[c];
+            op[c] = (int64_t) (((double) df[c] * 1000 + (double) (totals[c] / 2)) / total);
+        }
+    }
+}
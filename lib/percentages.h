@@ -1,4 +1,6 @@
 #ifndef _SYMON_LIB_PERCENTAGES_H
 #define _SYMON_LIB_PERCENTAGES_H
 int percentages(int cnt, int64_t *out, int64_t *new, int64_t *old, int64_t *diffs);
+void percentages_n(int cnt, int n, int stride, int64_t *out, int64_t *new, int64_t *old,
+                   int64_t *diffs, int64_t *totals);
 #endif /* _SYMON_LIB_PERCENTAGES_H */
@@ -8,6 +8,7 @@
 #define _RRD_H
 
 int rrd_update(int, const char **);
+time_t rrd_last_r(const char *);
 void rrd_clear_error(void);
 int rrd_test_error(void);
 char *rrd_get_error(void);
@@ -14,6 +14,7 @@
 #define SYMON_DFBLOCKSIZE      512
 #define SYMON_DFNAMESIZE       64
 #define SYMON_MAXPACKET        65515    /* udp packet max payload 65Kb - 20 byte header */
+#define SYMON_TCPQUEUE         16       /* packets queued for a slow tcp mux */
 #define SYMON_WGPEERDESC       IFDESCRSIZE	/* maximum wireguard peer description */
 
 #define SYMON_MAXLEXNUM        65535    /* maximum numeric argument while lexing */
@@ -55,3 +55,8 @@ fi
 if grep -q "_WANT_SEMUN" /usr/include/sys/sem.h; then
     echo "#define _WANT_SEMUN		1"
 fi
+if grep -q "sendmmsg" /usr/include/sys/socket.h; then
+    echo "#define HAS_SENDMMSG	1"
+else
+    echo "#undef HAS_SENDMMSG"
+fi
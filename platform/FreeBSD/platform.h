@@ -36,6 +36,14 @@ union stream_parg {
     struct ifreq ifr;
     int sn;
     int smart;
+    struct {
+        int slot;                     /* loaded plugin */
+        void *state;                  /* of the plugin for this stream */
+    } pl;
+    struct {
+        int slot;                     /* collector of the stream */
+        int seq;                      /* last sample sent */
+    } exec;
 };
 
 #endif
@@ -17,3 +17,41 @@ else
     echo "#undef HAS_HDDRIVECMDHDR"
 fi
 
+if [ -f /usr/include/scsi/sg.h ]; then
+    echo "#define HAS_SG_IO 1"
+else
+    echo "#undef HAS_SG_IO"
+fi
+if grep -qs "NVME_IOCTL_ADMIN_CMD" /usr/include/linux/nvme_ioctl.h; then
+    echo "#define HAS_NVME_IOCTL 1"
+else
+    echo "#undef HAS_NVME_IOCTL"
+fi
+
+if grep -qs "sendmmsg" /usr/include/sys/socket.h /usr/include/*/sys/socket.h; then
+    echo "#define HAS_SENDMMSG 1"
+else
+    echo "#undef HAS_SENDMMSG"
+fi
+
+# epoll, timerfd and signalfd for the main loop
+if grep -qs "timerfd_create" /usr/include/sys/timerfd.h /usr/include/*/sys/timerfd.h; then
+    echo "#define HAS_EPOLL 1"
+else
+    echo "#undef HAS_EPOLL"
+fi
+
+if grep -qs "IFLA_STATS64" /usr/include/linux/if_link.h; then
+    echo "#define HAS_RTNETLINK 1"
+else
+    echo "#undef HAS_RTNETLINK"
+fi
+
+if grep -qs "WG_GENL_NAME" /usr/include/linux/wireguard.h; then
+    echo "#define HAS_WIREGUARD 1"
+else
+    echo "#undef HAS_WIREGUARD"
+fi
+
+# modules can list their objects for wildcard streams
+echo "#define HAS_STREAM_NAMES 1"
@@ -51,7 +51,8 @@ union stream_parg {
         int64_t old[CPUSTATES];
         int64_t diff[CPUSTATES];
         int64_t states[CPUSTATES];
-        char name[6];
+        int slot;                     /* column in the /proc/stat table */
+        int gen;                      /* table generation of last get */
     } cp;
     struct {
         int64_t time[CPUSTATES];
@@ -62,15 +63,46 @@ union stream_parg {
     } cpw;
     struct {
         char mountpath[MAX_PATH_LEN];
+        int slot;                     /* watched mount; -1 if not mounted */
+        int gen;                      /* mount table generation resolved */
     } df;
     struct {
         int type;
+        int slot;                     /* entry of the opened sensor file */
         char path[MAX_PATH_LEN];
     } sn;
     int smart;
-    char ifname[MAX_PATH_LEN];
+    struct {
+        int slot;                     /* loaded plugin */
+        void *state;                  /* of the plugin for this stream */
+    } pl;
+    struct {
+        int slot;                     /* collector of the stream */
+        int seq;                      /* last sample sent */
+    } exec;
+    int cg;                           /* entry of the cgroup */
+    int pressure;                     /* resource in /proc/pressure */
+    struct {
+        char ifname[16];
+        int ifindex;                  /* 0 if the interface is not there */
+        uint32_t handle;
+        int root;                     /* root qdisc, handle is not used */
+    } pfq;
+    struct {
+        int iface;                    /* dumped interface; -1 if unusable */
+        uint8_t key[32];             /* public key of the peer */
+    } wg;
     char flukso[MAX_PATH_LEN];
-    char io[MAX_PATH_LEN];
+    struct {
+        char name[MAX_PATH_LEN];
+        int slot;                     /* index hint into the diskstats table */
+        unsigned int major;           /* device the name was found on */
+        unsigned int minor;
+    } io;
+    struct {
+        int64_t ticks;                /* cpu ticks at last get */
+        double when;                  /* monotonic time of last get */
+    } pr;
 };
 
 #endif
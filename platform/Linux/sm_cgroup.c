@@ -0,0 +1,524 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get cgroup v2 statistics from the unified hierarchy and return them in
+ * symon_buf as
+ *
+ * usage_usec : user_usec : system_usec : nr_throttled : throttled_usec :
+ * memory.current : anon : file : rbytes : wbytes : rios : wios :
+ * cpu some avg10 : memory some avg10 : memory full avg10
+ *
+ * for the cgroup whose path, relative to the root of the hierarchy, is the
+ * argument. Io counters are summed over all devices.
+ *
+ * A cgroup directory and its files are opened once and read with pread. Files
+ * that a cgroup does not have read as zero. Wildcard arguments are matched
+ * against the hierarchy every CG_RESCAN seconds.
+ */
+
+#include "conf.h"
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+#define CG_ROOT     "/sys/fs/cgroup"
+#define CG_HYBRID   "/sys/fs/cgroup/unified"
+#define CG_RESCAN   10          /* seconds between wildcard scans */
+
+/* files read per cgroup */
+#define CG_CPUSTAT  0
+#define CG_MEMCUR   1
+#define CG_MEMSTAT  2
+#define CG_IOSTAT   3
+#define CG_CPUPSI   4
+#define CG_MEMPSI   5
+#define CG_NFILES   6
+
+static char *cg_files[CG_NFILES] = {
+    "cpu.stat", "memory.current", "memory.stat", "io.stat",
+    "cpu.pressure", "memory.pressure"
+};
+
+/* values of a cgroup, in network order */
+#define CG_USAGE    0
+#define CG_USER     1
+#define CG_SYSTEM   2
+#define CG_NRTHR    3
+#define CG_THRUSEC  4
+#define CG_CURRENT  5
+#define CG_ANON     6
+#define CG_FILE     7
+#define CG_RBYTES   8
+#define CG_WBYTES   9
+#define CG_RIOS     10
+#define CG_WIOS     11
+#define CG_NVALUES  12
+
+/* Globals for this module all start with cg_ */
+struct cg_entry {
+    char path[MAX_PATH_LEN];    /* relative to cg_root */
+    int used;
+    int dirfd;
+    int fd[CG_NFILES];
+    int absent;                 /* files not found; retried on a scan */
+    int read;                   /* cg_gen of last read */
+    int got;                    /* cg_gen of last get */
+    int ok;
+    int warned;
+    u_int64_t value[CG_NVALUES];
+    double cpu_some;
+    double mem_some;
+    double mem_full;
+};
+static struct cg_entry *cg_entries = NULL;
+static int cg_nentries = 0;
+static int cg_maxentries = 0;
+static int cg_gen = 0;
+static char *cg_root = NULL;
+static int cg_nfds = 0;
+static int cg_maxfds = 0;
+static char cg_buf[8192];
+
+/* wildcard patterns and the cgroups that matched them on the last scan */
+static char **cg_patterns = NULL;
+static int cg_npatterns = 0;
+static glob_t cg_glob;
+static int cg_globbed = 0;
+static time_t cg_scanned = 0;
+
+void cgroup_close(struct cg_entry *);
+int cgroup_entry(char *);
+int cgroup_file(struct cg_entry *, int);
+void cgroup_keys(char *, char **, u_int64_t *, int);
+void cgroup_open(void);
+double cgroup_pressure(char *, char *);
+void cgroup_read(struct cg_entry *);
+void cgroup_scan(void);
+u_int64_t cgroup_value(char **);
+
+/* Find the unified hierarchy and size the budget of files kept open */
+void
+cgroup_open(void)
+{
+    struct stat sb;
+    struct rlimit rl;
+
+    if (cg_root != NULL)
+        return;
+
+    if (stat(CG_ROOT "/cgroup.controllers", &sb) == 0)
+        cg_root = CG_ROOT;
+    else if (stat(CG_HYBRID "/cgroup.controllers", &sb) == 0)
+        cg_root = CG_HYBRID;
+    else
+        fatal("cgroup: no cgroup v2 hierarchy at " CG_ROOT " or " CG_HYBRID);
+
+    /* a node with many cgroups needs more than the default soft limit */
+    cg_maxfds = 512;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        if (rl.rlim_cur < rl.rlim_max) {
+            rl.rlim_cur = rl.rlim_max;
+            if (setrlimit(RLIMIT_NOFILE, &rl) != 0)
+                getrlimit(RLIMIT_NOFILE, &rl);
+        }
+        if (rl.rlim_cur != RLIM_INFINITY)
+            cg_maxfds = rl.rlim_cur / 2;
+        else
+            cg_maxfds = 32768;
+    }
+}
+void
+cgroup_close(struct cg_entry *e)
+{
+    int i;
+
+    for (i = 0; i < CG_NFILES; i++)
+        if (e->fd[i] >= 0) {
+            close(e->fd[i]);
+            e->fd[i] = -1;
+            cg_nfds--;
+        }
+
+    if (e->dirfd >= 0) {
+        close(e->dirfd);
+        e->dirfd = -1;
+        cg_nfds--;
+    }
+}
+/* Entry of a cgroup; unused entries are recycled */
+int
+cgroup_entry(char *path)
+{
+    struct cg_entry *e;
+    int i, slot;
+
+    slot = -1;
+    for (i = 0; i < cg_nentries; i++) {
+        if (!cg_entries[i].used) {
+            if (slot < 0)
+                slot = i;
+        } else if (strcmp(cg_entries[i].path, path) == 0)
+            return i;
+    }
+
+    if (slot < 0) {
+        if (cg_nentries == cg_maxentries) {
+            cg_maxentries = (cg_maxentries == 0) ? 16 : cg_maxentries * 2;
+            cg_entries = xrealloc(cg_entries, cg_maxentries * sizeof(struct cg_entry));
+        }
+        slot = cg_nentries++;
+    }
+
+    e = &cg_entries[slot];
+    bzero(e, sizeof(struct cg_entry));
+    snprintf(e->path, sizeof(e->path), "%s", path);
+    e->used = 1;
+    e->dirfd = -1;
+    for (i = 0; i < CG_NFILES; i++)
+        e->fd[i] = -1;
+    e->read = -1;
+    e->got = cg_gen;
+
+    return slot;
+}
+/*
+ * Read a file of a cgroup into cg_buf. Files stay open while the budget
+ * allows; beyond that they are opened for each read.
+ */
+int
+cgroup_file(struct cg_entry *e, int i)
+{
+    char path[MAX_PATH_LEN];
+    int fd, dirfd, len, err;
+
+    if (e->absent & (1 << i))
+        return 0;
+
+    if ((fd = e->fd[i]) < 0) {
+        if ((dirfd = e->dirfd) < 0) {
+            if (snprintf(path, sizeof(path), "%s/%s", cg_root, e->path) >=
+                (int) sizeof(path)) {
+                errno = ENAMETOOLONG;
+                return -1;
+            }
+            if ((dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+                return -1;
+            if (cg_nfds < cg_maxfds) {
+                e->dirfd = dirfd;
+                cg_nfds++;
+            }
+        }
+
+        fd = openat(dirfd, cg_files[i], O_RDONLY | O_CLOEXEC);
+        err = errno;
+        if (dirfd != e->dirfd)
+            close(dirfd);
+        if (fd < 0) {
+            /* every cgroup has a cpu.stat; other files need a controller */
+            if (err == ENOENT && i != CG_CPUSTAT) {
+                e->absent |= (1 << i);
+                return 0;
+            }
+            errno = err;
+            return -1;
+        }
+
+        if (cg_nfds < cg_maxfds) {
+            e->fd[i] = fd;
+            cg_nfds++;
+        }
+    }
+
+    len = pread(fd, cg_buf, sizeof(cg_buf) - 1, 0);
+    err = errno;
+    if (fd != e->fd[i])
+        close(fd);
+    if (len < 0) {
+        errno = err;
+        return -1;
+    }
+
+    cg_buf[len] = '\0';
+    return 1;
+}
+u_int64_t
+cgroup_value(char **p)
+{
+    u_int64_t v;
+
+    for (v = 0; **p >= '0' && **p <= '9'; (*p)++)
+        v = v * 10 + (**p - '0');
+
+    return v;
+}
+/* Add "key value" and "key=value" pairs of cg_buf to the matching values */
+void
+cgroup_keys(char *buf, char **keys, u_int64_t *values, int n)
+{
+    char *p, *word;
+    int i, len, sep;
+
+    p = buf;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\n')
+            p++;
+        word = p;
+        while (*p != '\0' && *p != ' ' && *p != '=' && *p != '\n')
+            p++;
+        len = p - word;
+        if (*p != ' ' && *p != '=')
+            continue;
+        sep = *p++;
+
+        for (i = 0; i < n; i++)
+            if (strncmp(word, keys[i], len) == 0 && keys[i][len] == '\0') {
+                values[i] += cgroup_value(&p);
+                break;
+            }
+
+        /* an unknown word before a space, like the device of an io.stat
+         * line, is followed by a key rather than a value */
+        if (i == n && sep == ' ')
+            continue;
+
+        while (*p != '\0' && *p != ' ' && *p != '\n')
+            p++;
+    }
+}
+/* avg10 of the some or full line of a pressure file */
+double
+cgroup_pressure(char *buf, char *line)
+{
+    char *p;
+
+    for (p = buf; p != NULL && *p != '\0'; p = strchr(p, '\n')) {
+        if (*p == '\n')
+            p++;
+        if (strncmp(p, line, 4) == 0 && strncmp(p + 4, " avg10=", 7) == 0)
+            return strtod(p + 11, NULL);
+    }
+
+    return 0.0;
+}
+void
+cgroup_read(struct cg_entry *e)
+{
+    static char *cpu_keys[] = {
+        "usage_usec", "user_usec", "system_usec", "nr_throttled", "throttled_usec"
+    };
+    static char *mem_keys[] = { "anon", "file" };
+    static char *io_keys[] = { "rbytes", "wbytes", "rios", "wios" };
+    char *p;
+    int i, r;
+
+    e->read = cg_gen;
+    e->ok = 0;
+    bzero(e->value, sizeof(e->value));
+    e->cpu_some = e->mem_some = e->mem_full = 0.0;
+
+    for (i = 0; i < CG_NFILES; i++) {
+        if ((r = cgroup_file(e, i)) < 0) {
+            /* removed cgroups give ENODEV on files that are still open */
+            if (!e->warned) {
+                if (errno == ENOENT || errno == ENODEV)
+                    debug("cgroup(%.200s): removed", e->path);
+                else
+                    warning("cgroup(%.200s): cannot read %.200s: %.200s",
+                            e->path, cg_files[i], strerror(errno));
+            }
+            e->warned = 1;
+            cgroup_close(e);
+            return;
+        }
+        if (r == 0)
+            continue;
+
+        switch (i) {
+        case CG_CPUSTAT:
+            cgroup_keys(cg_buf, cpu_keys, &e->value[CG_USAGE], 5);
+            break;
+        case CG_MEMCUR:
+            p = cg_buf;
+            e->value[CG_CURRENT] = cgroup_value(&p);
+            break;
+        case CG_MEMSTAT:
+            cgroup_keys(cg_buf, mem_keys, &e->value[CG_ANON], 2);
+            break;
+        case CG_IOSTAT:
+            cgroup_keys(cg_buf, io_keys, &e->value[CG_RBYTES], 4);
+            break;
+        case CG_CPUPSI:
+            e->cpu_some = cgroup_pressure(cg_buf, "some");
+            break;
+        case CG_MEMPSI:
+            e->mem_some = cgroup_pressure(cg_buf, "some");
+            e->mem_full = cgroup_pressure(cg_buf, "full");
+            break;
+        }
+    }
+
+    if (e->warned)
+        info("cgroup(%.200s): found again", e->path);
+    e->ok = 1;
+    e->warned = 0;
+}
+/* List the cgroups that match the wildcard patterns */
+void
+cgroup_scan(void)
+{
+    char pattern[MAX_PATH_LEN];
+    int i, flags;
+
+    if (cg_globbed)
+        globfree(&cg_glob);
+    bzero(&cg_glob, sizeof(cg_glob));
+    cg_globbed = 1;
+
+    /* a trailing slash only matches directories */
+    flags = GLOB_NOSORT;
+    for (i = 0; i < cg_npatterns; i++) {
+        snprintf(pattern, sizeof(pattern), "%s/%s/", cg_root, cg_patterns[i]);
+        glob(pattern, flags, NULL, &cg_glob);
+        flags |= GLOB_APPEND;
+    }
+
+    for (i = 0; i < (int) cg_glob.gl_pathc; i++)
+        cg_glob.gl_pathv[i][strlen(cg_glob.gl_pathv[i]) - 1] = '\0';
+
+    cg_scanned = now;
+}
+char *
+names_cgroup(int i)
+{
+    if (!cg_globbed || i >= (int) cg_glob.gl_pathc)
+        return NULL;
+
+    return cg_glob.gl_pathv[i] + strlen(cg_root) + 1;
+}
+void
+init_cgroup(struct stream *st)
+{
+    char buf[SYMON_MAX_OBJSIZE];
+    char *p;
+
+    cgroup_open();
+
+    /* the argument is relative to the root; none is the root itself */
+    for (p = st->arg; *p == '/'; p++)
+        ;
+    if (p != st->arg)
+        memmove(st->arg, p, strlen(p) + 1);
+
+    if (st->pattern) {
+        cg_patterns = xrealloc(cg_patterns, (cg_npatterns + 1) * sizeof(char *));
+        cg_patterns[cg_npatterns++] = xstrdup(st->arg);
+        cgroup_scan();
+        info("started module cgroup(%.200s)", st->arg);
+        return;
+    }
+
+    st->parg.cg = cgroup_entry(st->arg);
+
+    get_cgroup(buf, sizeof(buf), st);
+
+    /* streams expanded from a wildcard are logged there */
+    if (st->origin == NULL)
+        info("started module cgroup(%.200s)", st->arg);
+}
+void
+gets_cgroup(void)
+{
+    struct cg_entry *e;
+    int i, last, scan;
+
+    last = cg_gen++;
+
+    /* cgroups come and go; look for them, and for missing files, again */
+    scan = (now - cg_scanned >= CG_RESCAN);
+    if (scan && cg_npatterns)
+        cgroup_scan();
+
+    for (i = 0; i < cg_nentries; i++) {
+        e = &cg_entries[i];
+        if (!e->used)
+            continue;
+
+        /* entries of removed cgroups are reused once nobody asks for them */
+        if (!e->ok && e->got != last) {
+            cgroup_close(e);
+            e->used = 0;
+            continue;
+        }
+
+        if (scan)
+            e->absent = 0;
+        if (e->got == last)
+            cgroup_read(e);
+    }
+}
+int
+get_cgroup(char *symon_buf, int maxlen, struct stream *st)
+{
+    struct cg_entry *e;
+
+    e = &cg_entries[st->parg.cg];
+    if (!e->used || strcmp(e->path, st->arg) != 0) {
+        st->parg.cg = cgroup_entry(st->arg);
+        e = &cg_entries[st->parg.cg];
+    }
+
+    if (e->read != cg_gen)
+        cgroup_read(e);
+    e->got = cg_gen;
+
+    if (!e->ok)
+        return 0;
+
+    return snpack(symon_buf, maxlen, st->arg, MT_CGROUP,
+                  e->value[CG_USAGE], e->value[CG_USER], e->value[CG_SYSTEM],
+                  e->value[CG_NRTHR], e->value[CG_THRUSEC],
+                  e->value[CG_CURRENT], e->value[CG_ANON], e->value[CG_FILE],
+                  e->value[CG_RBYTES], e->value[CG_WBYTES],
+                  e->value[CG_RIOS], e->value[CG_WIOS],
+                  e->cpu_some, e->mem_some, e->mem_full);
+}
@@ -37,6 +37,7 @@
 
 #include "conf.h"
 
+#include <sys/param.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -60,31 +61,169 @@ static int cp_size = 0;
 static int cp_maxsize = 0;
 static int cp_fd = -1;
 
+/*
+ * All cpu lines of /proc/stat are parsed in one pass into a table with a row
+ * per cpu state and a column per cpu; column 0 holds the total and column
+ * n + 1 cpu n. Deltas and percentages of all columns are computed in one go.
+ */
+static int64_t *cp_new = NULL;
+static int64_t *cp_old = NULL;
+static int64_t *cp_diff = NULL;
+static int64_t *cp_pct = NULL;
+static int64_t *cp_total = NULL;
+static char *cp_seen = NULL;    /* column was in the last read */
+static int cp_stride = 0;       /* columns allocated */
+static int cp_ncols = 0;        /* columns in use */
+static int cp_gen = 0;          /* number of reads */
+
+/* cpu numbers in the last /proc/stat, for wildcards */
+struct cp_name {
+    char id[16];
+};
+static struct cp_name *cp_names = NULL;
+static int cp_nnames = 0;
+static int cp_maxnames = 0;
+
+int cpu_table(int64_t **, char **, int *);
+int64_t *cpu_regrid(int64_t *, int, int, int);
+void cpu_grow(int);
+void cpu_open(void);
+void cpu_parse(void);
+
 void
-init_cpu(struct stream *st)
+cpu_open(void)
 {
-    char buf[SYMON_MAX_OBJSIZE];
-
     if (cp_buf == NULL) {
         cp_maxsize = SYMON_MAX_OBJSIZE;
         cp_buf = xmalloc(cp_maxsize);
     }
 
-    if (st->arg != NULL && isdigit(*st->arg)) {
-        snprintf(st->parg.cp.name, sizeof(st->parg.cp.name), "cpu%s", st->arg);
-    } else {
-        snprintf(st->parg.cp.name, sizeof(st->parg.cp.name), "cpu");
-    }
-
-    if ((cp_fd = open("/proc/stat", O_RDONLY)) < 0)
+    if (cp_fd < 0 && (cp_fd = open("/proc/stat", O_RDONLY)) < 0)
         warning("cannot access /proc/stat: %.200s", strerror(errno));
+}
+void
+init_cpu(struct stream *st)
+{
+    char buf[SYMON_MAX_OBJSIZE];
+
+    cpu_open();
+
+    if (st->arg != NULL && isdigit((unsigned char) *st->arg))
+        st->parg.cp.slot = atoi(st->arg) + 1;
+    else
+        st->parg.cp.slot = 0;
+    st->parg.cp.gen = 0;
+
+    /* streams expanded from a wildcard were found in the current stats */
+    if (st->origin == NULL)
+        gets_cpu();
+
+    if (st->pattern) {
+        info("started module cpu(%.200s)", st->arg);
+        return;
+    }
 
-    gets_cpu();
     get_cpu(buf, sizeof(buf), st);
 
-    info("started module cpu(%.200s)", st->arg);
+    /* streams expanded from a wildcard are logged there */
+    if (st->origin == NULL)
+        info("started module cpu(%.200s)", st->arg);
 }
+/* Copy a table of rows to a wider one; new columns are zero */
+int64_t *
+cpu_regrid(int64_t *table, int rows, int from, int to)
+{
+    int64_t *wide;
+    int i;
 
+    wide = xmalloc(rows * to * sizeof(int64_t));
+    bzero(wide, rows * to * sizeof(int64_t));
+    if (table != NULL) {
+        for (i = 0; i < rows; i++)
+            bcopy(table + i * from, wide + i * to, from * sizeof(int64_t));
+        xfree(table);
+    }
+
+    return wide;
+}
+void
+cpu_grow(int cols)
+{
+    int stride;
+
+    for (stride = (cp_stride == 0) ? 16 : cp_stride; stride < cols; stride *= 2)
+        ;
+
+    cp_new = cpu_regrid(cp_new, CPUSTATES, cp_stride, stride);
+    cp_old = cpu_regrid(cp_old, CPUSTATES, cp_stride, stride);
+    cp_diff = cpu_regrid(cp_diff, CPUSTATES, cp_stride, stride);
+    cp_pct = cpu_regrid(cp_pct, CPUSTATES, cp_stride, stride);
+    cp_total = xrealloc(cp_total, stride * sizeof(int64_t));
+    cp_seen = xrealloc(cp_seen, stride);
+    bzero(cp_seen + cp_stride, stride - cp_stride);
+    cp_stride = stride;
+}
+/* Scan the cpu lines of the last read into the table */
+void
+cpu_parse(void)
+{
+    char *p, *end;
+    int64_t v;
+    int col, id, i;
+
+    if (cp_stride == 0)
+        cpu_grow(1);
+    bzero(cp_seen, cp_stride);
+
+    p = cp_buf;
+    end = p + cp_size;
+    while (p < end) {
+        if (end - p > 3 && strncmp(p, "cpu", 3) == 0) {
+            p += 3;
+            col = 0;
+            if (isdigit((unsigned char) *p)) {
+                for (id = 0; p < end && isdigit((unsigned char) *p); p++)
+                    if (id <= SYMON_MAX_DOBJECTS)
+                        id = id * 10 + (*p - '0');
+                col = id + 1;
+            }
+
+            if (col <= SYMON_MAX_DOBJECTS) {
+                if (col >= cp_stride)
+                    cpu_grow(col + 1);
+
+                for (i = 0; i < CPUSTATES; i++) {
+                    while (p < end && *p == ' ')
+                        p++;
+                    if (p == end || !isdigit((unsigned char) *p))
+                        break;
+                    for (v = 0; p < end && isdigit((unsigned char) *p); p++)
+                        v = v * 10 + (*p - '0');
+                    cp_new[i * cp_stride + col] = v;
+                }
+
+                /* /proc/stat might not support steal */
+                if (i == CPUSTATES - 1) {
+                    cp_new[CP_STEAL * cp_stride + col] = 0;
+                    i++;
+                }
+
+                if (i == CPUSTATES) {
+                    cp_seen[col] = 1;
+                    cp_ncols = MAX(cp_ncols, col + 1);
+                }
+            }
+        }
+
+        /* skip to next line */
+        while (p < end && *p != '\n')
+            p++;
+        p++;
+    }
+
+    percentages_n(CPUSTATES, cp_ncols, cp_stride, cp_pct, cp_new, cp_old, cp_diff, cp_total);
+    cp_gen++;
+}
 void
 gets_cpu(void)
 {
@@ -108,58 +247,82 @@ gets_cpu(void)
 
     if (cp_size == -1) {
         warning("could not read if statistics from /proc/stat: %.200s", strerror(errno));
+        return;
     }
+
+    cpu_parse();
+}
+/* Table of the last read, for cpuhist; returns the number of columns */
+int
+cpu_table(int64_t **new, char **seen, int *stride)
+{
+    *new = cp_new;
+    *seen = cp_seen;
+    *stride = cp_stride;
+
+    return (cp_size > 0) ? cp_ncols : 0;
+}
+/* The list of cpus is rebuilt from the last stats when enumeration starts */
+char *
+names_cpu(int i)
+{
+    int col;
+
+    if (i == 0) {
+        cp_nnames = 0;
+        for (col = 1; col < cp_ncols; col++) {
+            if (!cp_seen[col])
+                continue;
+            if (cp_nnames == cp_maxnames) {
+                cp_maxnames = (cp_maxnames == 0) ? 16 : cp_maxnames * 2;
+                cp_names = xrealloc(cp_names, cp_maxnames * sizeof(struct cp_name));
+            }
+            snprintf(cp_names[cp_nnames].id, sizeof(cp_names[0].id), "%d", col - 1);
+            cp_nnames++;
+        }
+    }
+
+    return (i < cp_nnames) ? cp_names[i].id : NULL;
 }
 
 int
 get_cpu(char *symon_buf, int maxlen, struct stream *st)
 {
-    char *line;
+    int64_t *states = st->parg.cp.states;
+    int col = st->parg.cp.slot;
+    int i;
 
     if (cp_size <= 0) {
         return 0;
     }
 
-    if ((line = strstr(cp_buf, st->parg.cp.name)) == NULL) {
-        warning("could not find %s", st->parg.cp.name);
+    if (col >= cp_ncols || !cp_seen[col]) {
+        if (st->origin == NULL)
+            warning("could not find cpu%.200s", st->arg);
         return 0;
     }
 
-    line += strlen(st->parg.cp.name);
-    if (CPUSTATES > sscanf(line, "%" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 "\n",
-                           &st->parg.cp.time[CP_USER],
-                           &st->parg.cp.time[CP_NICE],
-                           &st->parg.cp.time[CP_SYS],
-                           &st->parg.cp.time[CP_IDLE],
-                           &st->parg.cp.time[CP_IOWAIT],
-                           &st->parg.cp.time[CP_HARDIRQ],
-                           &st->parg.cp.time[CP_SOFTIRQ],
-                           &st->parg.cp.time[CP_STEAL])) {
-      /* /proc/stat might not support steal */
-      st->parg.cp.time[CP_STEAL] = 0;
-      if ((CPUSTATES - 1) > sscanf(line, "%" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %" SCNd64 "\n",
-                                   &st->parg.cp.time[CP_USER],
-                                   &st->parg.cp.time[CP_NICE],
-                                   &st->parg.cp.time[CP_SYS],
-                                   &st->parg.cp.time[CP_IDLE],
-                                   &st->parg.cp.time[CP_IOWAIT],
-                                   &st->parg.cp.time[CP_HARDIRQ],
-                                   &st->parg.cp.time[CP_SOFTIRQ])) {
-        warning("could not parse cpu statistics for %.200s", &st->parg.cp.name);
-        return 0;
-      }
+    if (st->parg.cp.gen == cp_gen - 1) {
+        /* got at the previous read as well; the table covers the same time */
+        for (i = 0; i < CPUSTATES; i++) {
+            states[i] = cp_pct[i * cp_stride + col];
+            st->parg.cp.old[i] = cp_new[i * cp_stride + col];
+        }
+    } else {
+        for (i = 0; i < CPUSTATES; i++)
+            st->parg.cp.time[i] = cp_new[i * cp_stride + col];
+        percentages(CPUSTATES, states, st->parg.cp.time,
+                    st->parg.cp.old, st->parg.cp.diff);
     }
-
-    percentages(CPUSTATES, st->parg.cp.states, st->parg.cp.time,
-                st->parg.cp.old, st->parg.cp.diff);
+    st->parg.cp.gen = cp_gen;
 
     return snpack(symon_buf, maxlen, st->arg, MT_CPU,
-                  (double) (st->parg.cp.states[CP_USER] / 10.0),
-                  (double) (st->parg.cp.states[CP_NICE] / 10.0),
-                  (double) (st->parg.cp.states[CP_SYS] / 10.0),
-                  (double) (st->parg.cp.states[CP_IOWAIT] +
-                            st->parg.cp.states[CP_HARDIRQ] +
-                            st->parg.cp.states[CP_SOFTIRQ] +
-                            st->parg.cp.states[CP_STEAL]) / 10.0,
-                  (double) (st->parg.cp.states[CP_IDLE] / 10.0));
+                  (double) (states[CP_USER] / 10.0),
+                  (double) (states[CP_NICE] / 10.0),
+                  (double) (states[CP_SYS] / 10.0),
+                  (double) (states[CP_IOWAIT] +
+                            states[CP_HARDIRQ] +
+                            states[CP_SOFTIRQ] +
+                            states[CP_STEAL]) / 10.0,
+                  (double) (states[CP_IDLE] / 10.0));
 }
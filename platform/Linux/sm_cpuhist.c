@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Histogram of cpu utilisation: the number of cpus that were busy for 0-10%,
+ * 10-20%, ... 90-100% of the time since the previous measurement, where busy
+ * is anything but idle. It summarises many-core hosts in a single stream.
+ *
+ * The cpu table is read by gets_cpu, which cpuhist shares with the cpu module;
+ * both are measured by the same probe.
+ */
+
+#include "conf.h"
+
+#include <sys/param.h>
+#include <sys/types.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "error.h"
+#include "percentages.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+#define CH_BUCKETS 10
+
+/* sm_cpu.c */
+int cpu_table(int64_t **, char **, int *);
+int64_t *cpu_regrid(int64_t *, int, int, int);
+void cpu_open(void);
+
+/* Globals for this module all start with ch_ */
+static int64_t *ch_old = NULL;
+static int64_t *ch_diff = NULL;
+static int64_t *ch_pct = NULL;
+static int64_t *ch_total = NULL;
+static int ch_stride = 0;
+
+void
+init_cpuhist(struct stream *st)
+{
+    char buf[SYMON_MAX_OBJSIZE];
+
+    cpu_open();
+    gets_cpu();
+    get_cpuhist(buf, sizeof(buf), st);
+
+    info("started module cpuhist(%.200s)", st->arg);
+}
+
+int
+get_cpuhist(char *symon_buf, int maxlen, struct stream *st)
+{
+    int cores[CH_BUCKETS];
+    int64_t *new;
+    char *seen;
+    int ncols, stride, busy, c;
+
+    if ((ncols = cpu_table(&new, &seen, &stride)) == 0)
+        return 0;
+
+    /* keep the columns of the cpu table */
+    if (ch_stride != stride) {
+        ch_old = cpu_regrid(ch_old, CPUSTATES, ch_stride, stride);
+        ch_diff = cpu_regrid(ch_diff, CPUSTATES, ch_stride, stride);
+        ch_pct = cpu_regrid(ch_pct, CPUSTATES, ch_stride, stride);
+        ch_total = xrealloc(ch_total, stride * sizeof(int64_t));
+        ch_stride = stride;
+    }
+
+    percentages_n(CPUSTATES, ncols, stride, ch_pct, new, ch_old, ch_diff, ch_total);
+
+    bzero(cores, sizeof(cores));
+    for (c = 1; c < ncols; c++) {
+        if (!seen[c])
+            continue;
+        busy = 1000 - ch_pct[CP_IDLE * stride + c];
+        cores[MAX(0, MIN(busy * CH_BUCKETS / 1000, CH_BUCKETS - 1))]++;
+    }
+
+    return snpack(symon_buf, maxlen, st->arg, MT_CPUHIST,
+                  cores[0], cores[1], cores[2], cores[3], cores[4],
+                  cores[5], cores[6], cores[7], cores[8], cores[9]);
+}
@@ -145,7 +145,7 @@ get_cpuiow(char *symon_buf, int maxlen, struct stream *st)
                                    &st->parg.cp.time[CP_IOWAIT],
                                    &st->parg.cp.time[CP_HARDIRQ],
                                    &st->parg.cp.time[CP_SOFTIRQ])) {
-        warning("could not parse cpu statistics for %.200s", &st->parg.cp.name);
+        warning("could not parse cpu statistics for %.200s", st->parg.cpw.name);
         return 0;
       }
     }
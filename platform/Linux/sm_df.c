@@ -34,61 +34,431 @@
  *
  *   blocks : bfree : bavail : files : ffree : 0 : 0
  *   syncwrites : asyncwrites are not available on linux
+ *
+ * Devices are mapped to mount points through /proc/self/mountinfo, by
+ * major:minor or else by mount source. The mount table is only read again
+ * when poll reports a change. statvfs runs on a few threads of this module
+ * with a timeout, so that a hanging network mount does not hold up the rest.
  */
 
 #include "conf.h"
 
+#include <sys/param.h>
+#include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/sysmacros.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <errno.h>
-#include <mntent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "diskname.h"
 #include "error.h"
 #include "symon.h"
+#include "xmalloc.h"
+
+#define DF_TIMEOUT    2000      /* ms to wait for statvfs of all mounts */
+#define DF_WORKERS    2
+#define DF_MAXWORKERS 8
+
+#define DF_IDLE       0
+#define DF_QUEUED     1
+#define DF_BUSY       2
+
+/* Globals for this module start with df_ */
+struct df_mount {
+    unsigned int major;
+    unsigned int minor;
+    int bind;                   /* mounts a subtree of the filesystem */
+    char source[MAX_PATH_LEN];
+    char dir[MAX_PATH_LEN];
+};
+static struct df_mount *df_mounts = NULL;
+static int df_nmounts = 0;
+static int df_maxmounts = 0;
+static char *df_buf = NULL;
+static int df_bufsize = 0;
+static int df_fd = -1;
+static int df_gen = 0;          /* mount table reads */
+
+/* Mount points that streams measure; never freed, workers may hold them */
+struct df_watch {
+    char dir[MAX_PATH_LEN];
+    struct statvfs sv;
+    int state;
+    int want;                   /* df_round it was queued for */
+    int round;                  /* df_round of the last result */
+    int got;                    /* df_round of the last get */
+    int hung;
+    struct df_watch *queue;
+};
+static struct df_watch **df_watches = NULL;
+static int df_nwatches = 0;
+static struct df_watch *df_queue = NULL;
+static int df_round = 0;
+static struct timespec df_deadline; /* for the statvfs calls of df_round */
+static int df_workers = 0;
+static pthread_mutex_t df_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t df_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t df_done = PTHREAD_COND_INITIALIZER;
+
+struct df_name {
+    char name[SYMON_PS_ARGLENV2];
+};
+static struct df_name *df_names = NULL;
+static int df_nnames = 0;
+static int df_maxnames = 0;
+
+struct df_mount *df_lookup(unsigned int, unsigned int, char *);
+void df_enqueue(struct df_watch *);
+void df_open(void);
+void df_parse(void);
+int df_resolve(struct stream *);
+void df_spawn(void);
+char *df_unescape(char *, char *, int);
+int df_watch(char *);
+void *df_worker(void *);
+u_int64_t fsbtoblk(u_int64_t, u_int64_t, u_int64_t);
 
 void
-init_df(struct stream *st)
+df_open(void)
+{
+    if (df_fd >= 0)
+        return;
+
+    if ((df_fd = open("/proc/self/mountinfo", O_RDONLY)) < 0)
+        fatal("df: cannot access /proc/self/mountinfo: %.200s", strerror(errno));
+
+    df_parse();
+}
+/* Copy a mountinfo field, undoing the octal escapes of space, tab, \n and \ */
+char *
+df_unescape(char *p, char *out, int maxlen)
+{
+    int i = 0;
+
+    while (*p != ' ' && *p != '\n' && *p != '\0') {
+        if (p[0] == '\\' && p[1] >= '0' && p[1] <= '3' && p[2] >= '0' &&
+            p[2] <= '7' && p[3] >= '0' && p[3] <= '7') {
+            if (i < maxlen - 1)
+                out[i++] = ((p[1] - '0') << 6) | ((p[2] - '0') << 3) | (p[3] - '0');
+            p += 4;
+        } else {
+            if (i < maxlen - 1)
+                out[i++] = *p;
+            p++;
+        }
+    }
+    out[i] = '\0';
+
+    return (*p == ' ') ? p + 1 : p;
+}
+/*
+ * id parent major:minor root mountpoint options [optional...] - fstype source
+ * superoptions
+ */
+void
+df_parse(void)
+{
+    struct df_mount *m;
+    char root[MAX_PATH_LEN];
+    char *p, *line, *next;
+    int len, total, field;
+
+    /* read the whole table */
+    total = 0;
+    if (lseek(df_fd, 0, SEEK_SET) != 0) {
+        warning("df: mountinfo seek error: %.200s", strerror(errno));
+        return;
+    }
+    for (;;) {
+        if (total + 1 >= df_bufsize) {
+            df_bufsize = (df_bufsize == 0) ? SYMON_MAX_OBJSIZE : df_bufsize * 2;
+            df_buf = xrealloc(df_buf, df_bufsize);
+        }
+        if ((len = read(df_fd, df_buf + total, df_bufsize - total - 1)) < 0) {
+            warning("df: cannot read mountinfo: %.200s", strerror(errno));
+            return;
+        }
+        if (len == 0)
+            break;
+        total += len;
+    }
+    df_buf[total] = '\0';
+
+    df_nmounts = 0;
+    df_nnames = 0;
+    for (line = df_buf; *line != '\0'; line = next) {
+        if ((next = strchr(line, '\n')) != NULL)
+            *next++ = '\0';
+        else
+            next = line + strlen(line);
+
+        if (df_nmounts == df_maxmounts) {
+            df_maxmounts = (df_maxmounts == 0) ? 32 : df_maxmounts * 2;
+            df_mounts = xrealloc(df_mounts, df_maxmounts * sizeof(struct df_mount));
+        }
+        m = &df_mounts[df_nmounts];
+
+        /* skip id and parent */
+        p = line;
+        for (field = 0; field < 2 && (p = strchr(p, ' ')) != NULL; field++)
+            p++;
+        if (p == NULL || sscanf(p, "%u:%u", &m->major, &m->minor) != 2)
+            continue;
+        if ((p = strchr(p, ' ')) == NULL)
+            continue;
+        p = df_unescape(p + 1, root, sizeof(root));
+        p = df_unescape(p, m->dir, sizeof(m->dir));
+        m->bind = (strcmp(root, "/") != 0);
+
+        /* source follows the separator and fstype */
+        if ((p = strstr(p, " - ")) == NULL || (p = strchr(p + 3, ' ')) == NULL)
+            continue;
+        df_unescape(p + 1, m->source, sizeof(m->source));
+        df_nmounts++;
+
+        /* mounted devices, for wildcards */
+        if (strncmp(m->source, "/dev/", 5) == 0) {
+            if (df_nnames == df_maxnames) {
+                df_maxnames = (df_maxnames == 0) ? 16 : df_maxnames * 2;
+                df_names = xrealloc(df_names, df_maxnames * sizeof(struct df_name));
+            }
+            snprintf(df_names[df_nnames].name, sizeof(df_names[0].name), "%s",
+                     m->source + 5);
+            df_nnames++;
+        }
+    }
+
+    df_gen++;
+}
+/* Mount of a device or source; whole filesystems before bind mounts */
+struct df_mount *
+df_lookup(unsigned int major, unsigned int minor, char *source)
+{
+    int i, bind;
+
+    for (bind = 0; bind < 2; bind++)
+        for (i = 0; i < df_nmounts; i++) {
+            if (df_mounts[i].bind != bind)
+                continue;
+            if (source == NULL && df_mounts[i].major == major &&
+                df_mounts[i].minor == minor)
+                return &df_mounts[i];
+            if (source != NULL && strcmp(df_mounts[i].source, source) == 0)
+                return &df_mounts[i];
+        }
+
+    return NULL;
+}
+int
+df_watch(char *dir)
+{
+    struct df_watch *w;
+    int i;
+
+    for (i = 0; i < df_nwatches; i++)
+        if (strcmp(df_watches[i]->dir, dir) == 0)
+            return i;
+
+    w = xmalloc(sizeof(struct df_watch));
+    bzero(w, sizeof(struct df_watch));
+    snprintf(w->dir, sizeof(w->dir), "%s", dir);
+    w->round = w->got = -1;
+
+    pthread_mutex_lock(&df_lock);
+    df_watches = xrealloc(df_watches, (df_nwatches + 1) * sizeof(struct df_watch *));
+    df_watches[df_nwatches] = w;
+    pthread_mutex_unlock(&df_lock);
+
+    return df_nwatches++;
+}
+/* Find the mount point of a stream in the current mount table */
+int
+df_resolve(struct stream *st)
 {
     struct disknamectx c;
     char drivename[MAX_PATH_LEN];
-    FILE *fp;
-    struct mntent *mount;
+    struct df_mount *m = NULL;
+    struct stat sb;
+
+    initdisknamectx(&c, st->arg, drivename, sizeof(drivename));
+
+    while (m == NULL && nextdiskname(&c)) {
+        if (stat(drivename, &sb) == 0 && S_ISBLK(sb.st_mode))
+            m = df_lookup(major(sb.st_rdev), minor(sb.st_rdev), NULL);
+        if (m == NULL)
+            m = df_lookup(0, 0, drivename);
+    }
+
+    st->parg.df.gen = df_gen;
+    if (m == NULL) {
+        st->parg.df.mountpath[0] = '\0';
+        st->parg.df.slot = -1;
+        return 0;
+    }
+
+    snprintf(st->parg.df.mountpath, sizeof(st->parg.df.mountpath), "%s", m->dir);
+    st->parg.df.slot = df_watch(m->dir);
+    return 1;
+}
+void
+init_df(struct stream *st)
+{
+    int resolved;
 
     if (st->arg == NULL)
         fatal("df: need a <disk device|name> argument");
 
-    initdisknamectx(&c, st->arg, drivename, sizeof(drivename));
+    df_open();
 
-    while (nextdiskname(&c)) {
-        fp = setmntent("/etc/mtab", "r");
-
-        if (fp == NULL)
-            fatal("df: cannot access /etc/mtab: %.200s", strerror(errno));
-
-        while ((mount = getmntent(fp))) {
-            if (strncmp(mount->mnt_fsname, drivename, sizeof(drivename)) == 0) {
-                snprintf(st->parg.df.mountpath,
-                         sizeof(st->parg.df.mountpath),
-                         "%s", mount->mnt_dir);
-                info("started module df(%.200s = %.200s)", st->arg,
-                     st->parg.df.mountpath);
-                endmntent(fp);
-                return;
-            }
-        }
+    if (st->pattern) {
+        /* wildcards are expanded from the mounted devices */
+        info("started module df(%.200s)", st->arg);
+        return;
+    }
+
+    resolved = df_resolve(st);
+
+    /* streams expanded from a wildcard are logged there */
+    if (st->origin != NULL)
+        return;
 
-        endmntent(fp);
+    if (resolved)
+        info("started module df(%.200s = %.200s)", st->arg,
+             st->parg.df.mountpath);
+    else
+        warning("df(%.200s): not mounted", st->arg);
+}
+void *
+df_worker(void *arg)
+{
+    struct df_watch *w;
+    struct statvfs sv;
+    int ok;
+
+    pthread_mutex_lock(&df_lock);
+    for (;;) {
+        while (df_queue == NULL)
+            pthread_cond_wait(&df_work, &df_lock);
+
+        w = df_queue;
+        df_queue = w->queue;
+        w->state = DF_BUSY;
+        pthread_mutex_unlock(&df_lock);
+
+        ok = (statvfs(w->dir, &sv) == 0);
+
+        pthread_mutex_lock(&df_lock);
+        if (ok) {
+            w->sv = sv;
+            w->round = w->want;
+        }
+        w->state = DF_IDLE;
+        pthread_cond_broadcast(&df_done);
     }
 
-    warning("df(%.200s): not mounted", st->arg);
+    return NULL;                /* NOTREACHED */
 }
+/* Hand a mount to the workers for this round; df_lock is held */
+void
+df_enqueue(struct df_watch *w)
+{
+    w->state = DF_QUEUED;
+    w->want = df_round;
+    w->queue = df_queue;
+    df_queue = w;
+}
+/* Add a worker; signals stay with the main thread */
+void
+df_spawn(void)
+{
+    sigset_t all, old;
+    pthread_t tid;
+    int error;
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    error = pthread_create(&tid, NULL, df_worker, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
 
+    if (error != 0) {
+        warning("df: cannot start worker: %.200s", strerror(error));
+        return;
+    }
+
+    pthread_detach(tid);
+    df_workers++;
+}
+/* Reread the mount table if it changed and statvfs the mounts that are in use */
 void
 gets_df(void)
 {
+    struct pollfd pfd;
+    struct timeval tv;
+    struct df_watch *w;
+    int i, stuck, pending, timeout;
+
+    df_round++;
+
+    if (df_fd < 0)
+        return;
+
+    pfd.fd = df_fd;
+    pfd.events = POLLPRI;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR)))
+        df_parse();
+
+    /* stay well within the deadline of the probe */
+    timeout = MIN(DF_TIMEOUT, symon_interval * 250);
+    gettimeofday(&tv, NULL);
+    df_deadline.tv_sec = tv.tv_sec + timeout / 1000;
+    df_deadline.tv_nsec = tv.tv_usec * 1000 + (timeout % 1000) * 1000000;
+    if (df_deadline.tv_nsec >= 1000000000) {
+        df_deadline.tv_sec++;
+        df_deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&df_lock);
+
+    /* mounts that still hang keep their worker */
+    stuck = 0;
+    for (i = 0; i < df_nwatches; i++)
+        if (df_watches[i]->state == DF_BUSY)
+            stuck++;
+    while (df_workers - stuck < DF_WORKERS && df_workers < DF_MAXWORKERS)
+        df_spawn();
+
+    /* mounts that were measured in the previous round */
+    for (i = 0; i < df_nwatches; i++) {
+        w = df_watches[i];
+        if (w->got == df_round - 1 && w->state == DF_IDLE)
+            df_enqueue(w);
+    }
+    pthread_cond_broadcast(&df_work);
+
+    do {
+        pending = 0;
+        for (i = 0; i < df_nwatches; i++)
+            if (df_watches[i]->want == df_round && df_watches[i]->state != DF_IDLE)
+                pending++;
+    } while (pending &&
+             pthread_cond_timedwait(&df_done, &df_lock, &df_deadline) != ETIMEDOUT);
+
+    pthread_mutex_unlock(&df_lock);
+}
+
+char *
+names_df(int i)
+{
+    return (i < df_nnames) ? df_names[i].name : NULL;
 }
 
 /*
@@ -108,8 +478,46 @@ int
 get_df(char *symon_buf, int maxlen, struct stream *st)
 {
     struct statvfs buf;
+    struct df_watch *w;
+    int ok, busy;
+
+    /* mounts may have moved */
+    if (st->parg.df.gen != df_gen && !df_resolve(st) && st->origin == NULL) {
+        warning("df(%.200s): not mounted", st->arg);
+        return 0;
+    }
+
+    if (st->parg.df.slot < 0)
+        return 0;
+
+    pthread_mutex_lock(&df_lock);
+    w = df_watches[st->parg.df.slot];
+    w->got = df_round;
+
+    /* not measured in the previous round, like a new mount or a stream with
+     * an interval of its own; a worker does it within the same deadline */
+    if (w->state == DF_IDLE && w->round != df_round) {
+        df_enqueue(w);
+        pthread_cond_broadcast(&df_work);
+    }
+    while (w->state != DF_IDLE &&
+           pthread_cond_timedwait(&df_done, &df_lock, &df_deadline) != ETIMEDOUT)
+        ;
+
+    busy = (w->state != DF_IDLE);
+    if ((ok = (w->round == df_round)))
+        buf = w->sv;
+    pthread_mutex_unlock(&df_lock);
+
+    if (busy) {
+        if (!w->hung)
+            warning("df(%.200s): statvfs of %.200s hangs", st->arg, w->dir);
+        w->hung = 1;
+        return 0;
+    }
+    w->hung = 0;
 
-    if (statvfs(st->parg.df.mountpath, &buf) == 0 ) {
+    if (ok) {
         return snpack(symon_buf, maxlen, st->arg, MT_DF,
                       (u_int64_t)fsbtoblk(buf.f_blocks, buf.f_bsize, SYMON_DFBLOCKSIZE),
                       (u_int64_t)fsbtoblk(buf.f_bfree, buf.f_bsize, SYMON_DFBLOCKSIZE),
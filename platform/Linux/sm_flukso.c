@@ -33,6 +33,9 @@
  *
  * num : value
  *
+ * The serial port is watched by the event loop, so lines are consumed and
+ * added to the averages as they arrive instead of piling up in the tty buffer
+ * between measurements.
  */
 
 #include "conf.h"
@@ -40,9 +43,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <errno.h>
 #include <string.h>
 #include <inttypes.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <termios.h>
 #include <unistd.h>
 #include <ctype.h>
@@ -61,6 +66,10 @@ static char *flukso_buf = NULL;
 static int flukso_size = 0;
 static int flukso_maxsize = 0;
 static int flukso_nrsensors = 0;
+static int flukso_warned = 0;
+
+/* the event loop reads while probes get */
+static pthread_mutex_t flukso_lock = PTHREAD_MUTEX_INITIALIZER;
 
 struct flukso_sensor {
     char id[FLUKSO_IDLEN];
@@ -69,14 +78,17 @@ struct flukso_sensor {
 };
 struct flukso_sensor flukso_sensor[FLUKSO_MAXSENSORS];
 
+void flukso_event(int, void *);
+int flukso_read(void);
+void flukso_parse(void);
+
 void
 init_flukso(struct stream *st)
 {
     struct termios tio;
 
-    bzero(flukso_sensor, sizeof(struct flukso_sensor) * FLUKSO_MAXSENSORS);
-
     if (flukso_buf == NULL) {
+        bzero(flukso_sensor, sizeof(struct flukso_sensor) * FLUKSO_MAXSENSORS);
         flukso_maxsize = SYMON_MAX_OBJSIZE;
         flukso_buf = xmalloc(flukso_maxsize);
     }
@@ -91,10 +103,9 @@ init_flukso(struct stream *st)
             fatal("flukso: could not open '%s' for read", "/dev/ttyS0");
         cfsetispeed(&tio, B4800);
         tcsetattr(flukso_fd, TCSANOW, &tio);
-    }
 
-    if (flukso_size == 0)
-        gets_flukso();
+        event_watch(flukso_fd, flukso_event, NULL);
+    }
 
     if (st->arg != NULL &&
         FLUKSO_IDLEN == strspn(st->arg, "0123456789abcdef")) {
@@ -104,9 +115,9 @@ init_flukso(struct stream *st)
         fatal("flukso: could not parse sensor name %.200s", st->arg);
     }
 }
-
+/* Add complete lines in the buffer to the sensor averages */
 void
-gets_flukso(void)
+flukso_parse(void)
 {
     int len = 0;
     int p = 0;
@@ -115,13 +126,6 @@ gets_flukso(void)
     uint32_t value;
     char id[FLUKSO_IDLEN];
 
-    if ((len = read(flukso_fd, flukso_buf + flukso_size, flukso_maxsize - flukso_size)) < 0) {
-        warning("flukso: cannot read data");
-        return;
-    }
-
-    flukso_size += len;
-
     /* We read the pwr messages rather than the pls pulse messages as we are
      * interested in the current load only */
     while ((p < flukso_size) &&
@@ -157,6 +161,51 @@ gets_flukso(void)
     } else {
         flukso_size = 0;
     }
+
+    /* a full buffer without a line in it is noise */
+    if (flukso_size == flukso_maxsize) {
+        debug("flukso: dropping %d bytes without newline", flukso_size);
+        flukso_size = 0;
+    }
+}
+/* Read all that the port has; returns 0 on errors other than no data */
+int
+flukso_read(void)
+{
+    int len;
+
+    pthread_mutex_lock(&flukso_lock);
+    for (;;) {
+        len = read(flukso_fd, flukso_buf + flukso_size, flukso_maxsize - flukso_size);
+        if (len <= 0)
+            break;
+
+        flukso_size += len;
+        flukso_parse();
+    }
+    pthread_mutex_unlock(&flukso_lock);
+
+    if (len < 0 && (errno == EAGAIN || errno == EINTR))
+        return 1;
+
+    if (!flukso_warned)
+        warning("flukso: cannot read data: %.200s",
+                (len < 0) ? strerror(errno) : "end of file");
+    flukso_warned = 1;
+    return 0;
+}
+void
+flukso_event(int fd, void *arg)
+{
+    /* a port that fails is left to the measurements */
+    if (!flukso_read())
+        event_unwatch(fd);
+}
+void
+gets_flukso(void)
+{
+    if (flukso_read())
+        flukso_warned = 0;
 }
 
 int
@@ -165,15 +214,21 @@ get_flukso(char *symon_buf, int maxlen, struct stream *st)
     int i;
     double avgwatts;
 
+    pthread_mutex_lock(&flukso_lock);
     for (i = 0; i < flukso_nrsensors; i++) {
         if (strncmp(st->parg.flukso, flukso_sensor[i].id, FLUKSO_IDLEN) == 0) {
+            if (flukso_sensor[i].n == 0)
+                break;
+
             avgwatts = (double) flukso_sensor[i].value / (double) flukso_sensor[i].n;
             flukso_sensor[i].value = 0;
             flukso_sensor[i].n = 0;
+            pthread_mutex_unlock(&flukso_lock);
 
             return snpack(symon_buf, maxlen, st->arg, MT_FLUKSO, avgwatts);
         }
     }
+    pthread_mutex_unlock(&flukso_lock);
 
     return 0;
 }
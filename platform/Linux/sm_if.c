@@ -38,14 +38,22 @@
 #include "conf.h"
 
 #include <sys/types.h>
+#include <sys/param.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 
 #include <errno.h>
 #include <fcntl.h>
-#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
+#ifdef HAS_RTNETLINK
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#endif
+
 #include "xmalloc.h"
 #include "error.h"
 #include "symon.h"
@@ -55,6 +63,38 @@ static void *if_buf = NULL;
 static int if_size = 0;
 static int if_maxsize = 0;
 static int if_fd = -1;
+static int if_valid = 0;
+
+/* Counters are collected once per interval into an index of name -> counters */
+#define IF_FIELDS 16
+struct if_entry {
+    char name[SYMON_PS_ARGLENV2];
+    u_int64_t v[IF_FIELDS];
+    int next;
+};
+static struct if_entry *if_entries = NULL;
+static int if_count = 0;
+static int if_maxcount = 0;
+static int *if_hash = NULL;
+static int if_hashsize = 0;
+
+#ifdef HAS_RTNETLINK
+/* Up to this many configured interfaces are requested one by one, more get a dump */
+#define IF_NL_FILTERMAX 8
+struct if_name {
+    char name[SYMON_PS_ARGLENV2];
+    int index;                        /* cached ifindex, 0 = unknown */
+};
+static struct if_name *if_names = NULL;
+static int if_nnames = 0;
+static int if_wantall = 0;            /* dump even when few names are watched */
+static int if_nl = -1;                /* requests */
+static int if_nlmon = -1;             /* link notifications */
+static u_int32_t if_nlseq = 0;
+static char *if_nlbuf = NULL;
+static int if_nlbufsize = 0;
+#endif
+
 struct if_device_stats
 {
     u_int64_t rx_packets;             /* total packets received       */
@@ -79,29 +119,144 @@ struct if_device_stats
     u_int64_t drops;
 };
 
-void
-init_if(struct stream *st)
+static unsigned int
+if_hashname(const char *name, size_t len)
 {
-    if (if_buf == NULL) {
-        if_maxsize = SYMON_MAX_OBJSIZE;
-        if_buf = xmalloc(if_maxsize);
+    unsigned int h = 2166136261U;
+
+    while (len--) {
+        h ^= (unsigned char) *name++;
+        h *= 16777619U;
     }
 
-    snprintf(st->parg.ifname, sizeof(st->parg.ifname), "%s:", st->arg);
+    return h;
+}
 
-    if ((if_fd = open("/proc/net/dev", O_RDONLY)) < 0)
-        warning("cannot access /proc/net/dev: %.200s", strerror(errno));
+static struct if_entry *
+if_lookup(const char *name)
+{
+    int i;
+
+    if (if_hashsize == 0)
+        return NULL;
 
-    info("started module if(%.200s)", st->arg);
+    for (i = if_hash[if_hashname(name, strlen(name)) & (if_hashsize - 1)];
+         i >= 0; i = if_entries[i].next) {
+        if (strcmp(if_entries[i].name, name) == 0)
+            return &if_entries[i];
+    }
+
+    return NULL;
 }
 
-void
-gets_if(void)
+/* Append an entry for name; the caller fills in the counters */
+static struct if_entry *
+if_add(const char *name, size_t len)
+{
+    struct if_entry *e;
+
+    if (len == 0 || len >= sizeof(e->name))
+        return NULL;
+
+    if (if_count == if_maxcount) {
+        if_maxcount = (if_maxcount == 0) ? 16 : if_maxcount * 2;
+        if_entries = xrealloc(if_entries, if_maxcount * sizeof(struct if_entry));
+    }
+
+    e = &if_entries[if_count++];
+    memcpy(e->name, name, len);
+    e->name[len] = '\0';
+
+    return e;
+}
+
+static void
+if_rehash(void)
+{
+    unsigned int h;
+    int i;
+
+    /* keep the table at most half full */
+    if (if_hashsize < 2 * if_count) {
+        for (if_hashsize = 16; if_hashsize < 2 * if_count; if_hashsize <<= 1)
+            ;
+        if_hash = xrealloc(if_hash, if_hashsize * sizeof(int));
+    }
+
+    for (i = 0; i < if_hashsize; i++)
+        if_hash[i] = -1;
+
+    for (i = 0; i < if_count; i++) {
+        h = if_hashname(if_entries[i].name, strlen(if_entries[i].name)) & (if_hashsize - 1);
+        if_entries[i].next = if_hash[h];
+        if_hash[h] = i;
+    }
+}
+
+/* Scan an unsigned decimal; returns pointer past it or NULL if none found */
+static char *
+if_scanu64(char *p, char *end, u_int64_t *v)
+{
+    u_int64_t n = 0;
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    if (p == end || *p < '0' || *p > '9')
+        return NULL;
+
+    while (p < end && *p >= '0' && *p <= '9')
+        n = n * 10 + (*p++ - '0');
+
+    *v = n;
+    return p;
+}
+
+/*
+ * Inter-|   Receive                                                |  Transmit
+ *  face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed
+ *   eth0: 1234 ...
+ */
+static void
+if_proc_index(void)
+{
+    char *p, *end, *eol, *name, *colon;
+    struct if_entry *e;
+    int i;
+
+    p = if_buf;
+    end = p + if_size;
+
+    for (; p < end; p = eol + 1) {
+        if ((eol = memchr(p, '\n', end - p)) == NULL)
+            eol = end;
+
+        if ((colon = memchr(p, ':', eol - p)) == NULL)
+            continue; /* header lines */
+
+        for (name = p; name < colon && (*name == ' ' || *name == '\t'); name++)
+            ;
+
+        if ((e = if_add(name, colon - name)) == NULL)
+            continue;
+
+        for (i = 0, p = colon + 1; i < IF_FIELDS; i++)
+            if ((p = if_scanu64(p, eol, &e->v[i])) == NULL)
+                break;
+
+        if (i < IF_FIELDS) {
+            warning("could not parse interface statistics for %.200s", e->name);
+            if_count--;
+        }
+    }
+}
+
+static void
+if_proc_gets(void)
 {
     if (lseek(if_fd, 0, SEEK_SET) != 0)
         fatal("/proc/net/dev seek error: %.200s", strerror(errno));
 
-    bzero(if_buf, if_maxsize);
     if_size = read(if_fd, if_buf, if_maxsize);
 
     if (if_size == if_maxsize) {
@@ -112,47 +267,358 @@ gets_if(void)
                   __FILE__, __LINE__, SYMON_MAX_OBJSIZE * SYMON_MAX_DOBJECTS);
         }
         if_buf = xrealloc(if_buf, if_maxsize);
-        gets_if();
+        if_proc_gets();
         return;
     }
 
     if (if_size == -1) {
         warning("could not read if statistics from /proc/net/dev: %.200s", strerror(errno));
+        return;
+    }
+
+    if_proc_index();
+    if_valid = 1;
+}
+
+#ifdef HAS_RTNETLINK
+static int
+if_nl_open(int groups)
+{
+    struct sockaddr_nl sa;
+    int fd;
+
+    if ((fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | (groups ? SOCK_NONBLOCK : 0),
+                     NETLINK_ROUTE)) < 0)
+        return -1;
+
+    bzero(&sa, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = groups;
+    if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Receive one datagram into if_nlbuf, growing it to fit; returns length */
+static int
+if_nl_recv(int fd)
+{
+    int len;
+
+    if ((len = recv(fd, if_nlbuf, if_nlbufsize, MSG_PEEK | MSG_TRUNC)) < 0)
+        return -1;
+
+    if (len > if_nlbufsize) {
+        if_nlbufsize = len;
+        if_nlbuf = xrealloc(if_nlbuf, if_nlbufsize);
+    }
+
+    return recv(fd, if_nlbuf, if_nlbufsize, 0);
+}
+
+/* Keep the ifindex cache of configured names in step with a link message */
+static void
+if_nl_cache(int index, const char *name, int deleted)
+{
+    int i;
+
+    for (i = 0; i < if_nnames; i++) {
+        if (if_names[i].index == index)
+            if_names[i].index = 0;
+        if (!deleted && name != NULL && strcmp(if_names[i].name, name) == 0)
+            if_names[i].index = index;
+    }
+}
+
+/* Parse a RTM_NEWLINK into the index, in /proc/net/dev field order */
+static void
+if_nl_link(struct nlmsghdr *nh, int store)
+{
+    struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    struct rtnl_link_stats64 s;
+    struct rtattr *rta;
+    struct if_entry *e;
+    char *name = NULL;
+    int len, stats = 0;
+
+    if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi)))
+        return;
+
+    bzero(&s, sizeof(s));
+    len = IFLA_PAYLOAD(nh);
+    for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            name = RTA_DATA(rta);
+            name[RTA_PAYLOAD(rta) - 1] = '\0';
+        } else if (rta->rta_type == IFLA_STATS64) {
+            memcpy(&s, RTA_DATA(rta), MIN(RTA_PAYLOAD(rta), sizeof(s)));
+            stats = 1;
+        }
+    }
+
+    if_nl_cache(ifi->ifi_index, name, 0);
+
+    if (!store || name == NULL || !stats || (e = if_add(name, strlen(name))) == NULL)
+        return;
+
+    e->v[0] = s.rx_bytes;
+    e->v[1] = s.rx_packets;
+    e->v[2] = s.rx_errors;
+    e->v[3] = s.rx_dropped + s.rx_missed_errors;
+    e->v[4] = s.rx_fifo_errors;
+    e->v[5] = s.rx_length_errors + s.rx_over_errors + s.rx_crc_errors + s.rx_frame_errors;
+    e->v[6] = s.rx_compressed;
+    e->v[7] = s.multicast;
+    e->v[8] = s.tx_bytes;
+    e->v[9] = s.tx_packets;
+    e->v[10] = s.tx_errors;
+    e->v[11] = s.tx_dropped;
+    e->v[12] = s.tx_fifo_errors;
+    e->v[13] = s.collisions;
+    e->v[14] = s.tx_carrier_errors + s.tx_aborted_errors + s.tx_window_errors + s.tx_heartbeat_errors;
+    e->v[15] = s.tx_compressed;
+}
+
+/* Drain pending link notifications: renames, hotplug and removals */
+static void
+if_nl_events(void)
+{
+    struct nlmsghdr *nh;
+    int i, len;
+
+    while ((len = if_nl_recv(if_nlmon)) > 0) {
+        for (nh = (struct nlmsghdr *) if_nlbuf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type == RTM_NEWLINK)
+                if_nl_link(nh, 0);
+            else if (nh->nlmsg_type == RTM_DELLINK)
+                if_nl_cache(((struct ifinfomsg *) NLMSG_DATA(nh))->ifi_index, NULL, 1);
+        }
+    }
+
+    if (len < 0 && errno == ENOBUFS) {
+        /* missed notifications; forget all cached indexes */
+        for (i = 0; i < if_nnames; i++)
+            if_names[i].index = 0;
+    }
+}
+
+/* Request one link by index or name, or dump all links; returns -1 on error */
+static int
+if_nl_request(int index, const char *name)
+{
+    struct {
+        struct nlmsghdr nh;
+        struct ifinfomsg ifi;
+        char attr[RTA_SPACE(SYMON_PS_ARGLENV2)];
+    } req;
+    struct nlmsghdr *nh;
+    struct nlmsgerr *err;
+    struct rtattr *rta;
+    int len, dump;
+
+    dump = (index == 0 && name == NULL);
+
+    bzero(&req, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifi));
+    req.nh.nlmsg_type = RTM_GETLINK;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | (dump ? NLM_F_DUMP : 0);
+    req.nh.nlmsg_seq = ++if_nlseq;
+    req.ifi.ifi_family = AF_UNSPEC;
+    req.ifi.ifi_index = index;
+
+    if (index == 0 && name != NULL) {
+        rta = (struct rtattr *) ((char *) &req + NLMSG_ALIGN(req.nh.nlmsg_len));
+        rta->rta_type = IFLA_IFNAME;
+        rta->rta_len = RTA_LENGTH(strlen(name) + 1);
+        snprintf(RTA_DATA(rta), SYMON_PS_ARGLENV2, "%s", name);
+        req.nh.nlmsg_len = NLMSG_ALIGN(req.nh.nlmsg_len) + RTA_ALIGN(rta->rta_len);
+    }
+
+    if (send(if_nl, &req, req.nh.nlmsg_len, 0) < 0)
+        return -1;
+
+    while ((len = if_nl_recv(if_nl)) > 0) {
+        for (nh = (struct nlmsghdr *) if_nlbuf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != if_nlseq)
+                continue;
+
+            switch (nh->nlmsg_type) {
+            case NLMSG_DONE:
+                return 0;
+            case NLMSG_ERROR:
+                err = NLMSG_DATA(nh);
+                errno = -err->error;
+                return (err->error == 0) ? 0 : -1;
+            case RTM_NEWLINK:
+                if_nl_link(nh, 1);
+                if (!dump)
+                    return 0;
+                break;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static void
+if_nl_gets(void)
+{
+    int i;
+
+    if_nl_events();
+
+    if (if_wantall || if_nnames > IF_NL_FILTERMAX) {
+        if (if_nl_request(0, NULL) < 0) {
+            warning("could not dump interface statistics: %.200s", strerror(errno));
+            return;
+        }
+        if_valid = 1;
+        return;
+    }
+
+    for (i = 0; i < if_nnames; i++) {
+        /* a cached index that now carries another name is corrected by the reply */
+        if (if_names[i].index != 0) {
+            if_nl_request(if_names[i].index, NULL);
+            if (if_count > 0 && strcmp(if_entries[if_count - 1].name, if_names[i].name) == 0)
+                continue;
+        }
+        if (if_nl_request(0, if_names[i].name) < 0 && errno != ENODEV)
+            warning("could not get interface statistics for %.200s: %.200s",
+                    if_names[i].name, strerror(errno));
     }
+    if_valid = 1;
+}
+#endif /* HAS_RTNETLINK */
+
+#ifdef HAS_RTNETLINK
+static void
+if_nl_init(void)
+{
+    if ((if_nl = if_nl_open(0)) < 0 || (if_nlmon = if_nl_open(RTMGRP_LINK)) < 0) {
+        warning("cannot open rtnetlink, falling back to /proc/net/dev: %.200s", strerror(errno));
+        if (if_nl >= 0)
+            close(if_nl);
+        if_nl = -1;
+        return;
+    }
+
+    if_nlbufsize = SYMON_MAX_OBJSIZE;
+    if_nlbuf = xmalloc(if_nlbufsize);
+}
+
+static void
+if_nl_watch(char *name)
+{
+    int i;
+
+    for (i = 0; i < if_nnames; i++)
+        if (strcmp(if_names[i].name, name) == 0)
+            return;
+
+    if_names = xrealloc(if_names, (if_nnames + 1) * sizeof(struct if_name));
+    snprintf(if_names[i].name, sizeof(if_names[i].name), "%s", name);
+    if_names[i].index = 0;
+    if_nnames++;
+}
+#endif /* HAS_RTNETLINK */
+
+static void
+if_proc_init(void)
+{
+    if (if_buf == NULL) {
+        if_maxsize = SYMON_MAX_OBJSIZE;
+        if_buf = xmalloc(if_maxsize);
+    }
+
+    if (if_fd < 0 && (if_fd = open("/proc/net/dev", O_RDONLY)) < 0)
+        warning("cannot access /proc/net/dev: %.200s", strerror(errno));
+}
+
+void
+init_if(struct stream *st)
+{
+#ifdef HAS_RTNETLINK
+    if (if_nl < 0 && if_fd < 0)
+        if_nl_init();
+
+    if (if_nl >= 0) {
+        if (st->pattern)
+            if_wantall = 1;     /* wildcards need to see all interfaces */
+        else
+            if_nl_watch(st->arg);
+    } else
+#endif
+        if_proc_init();
+
+    /* wildcards are expanded from a first look at the interfaces */
+    if (st->pattern)
+        gets_if();
+
+    /* streams expanded from a wildcard are logged there */
+    if (st->origin == NULL)
+        info("started module if(%.200s)", st->arg);
+}
+
+void
+gets_if(void)
+{
+    if_count = 0;
+    if_valid = 0;
+
+#ifdef HAS_RTNETLINK
+    if (if_nl >= 0)
+        if_nl_gets();
+    else
+#endif
+        if_proc_gets();
+
+    if_rehash();
+}
+
+char *
+names_if(int i)
+{
+    return (if_valid && i < if_count) ? if_entries[i].name : NULL;
 }
 
 int
 get_if(char *symon_buf, int maxlen, struct stream *st)
 {
-    char *line;
+    struct if_entry *e;
     struct if_device_stats stats;
 
-    if (if_size <= 0) {
+    if (!if_valid) {
         return 0;
     }
 
-    if ((line = strstr(if_buf, st->parg.ifname)) == NULL) {
-        warning("could not find interface %s", st->arg);
+    if ((e = if_lookup(st->arg)) == NULL) {
+        /* expanded streams can lose their object before the next expansion */
+        if (st->origin == NULL)
+            warning("could not find interface %s", st->arg);
         return 0;
     }
 
-    line += strlen(st->parg.ifname);
-    bzero(&stats, sizeof(struct if_device_stats));
-
-    /* Inter-|   Receive                                                |  Transmit
-     *  face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed
-     */
-    if (16 > sscanf(line, "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %"
-                               SCNu64 " %" SCNu64 " %" SCNu64 " %"
-                               SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %"
-                               SCNu64 " %" SCNu64 " %" SCNu64 "\n",
-                    &stats.rx_bytes, &stats.rx_packets, &stats.rx_errors, &stats.rx_dropped, &stats.rx_fifo_errors,
-                    &stats.rx_frame_errors, &stats.rx_compressed, &stats.multicast,
-                    &stats.tx_bytes, &stats.tx_packets, &stats.tx_errors, &stats.tx_dropped, &stats.tx_fifo_errors,
-                    &stats.collisions, &stats.tx_carrier_errors, &stats.tx_compressed)) {
-        warning("could not parse interface statistics for %.200s", st->arg);
-        return 0;
-    }
+    stats.rx_bytes = e->v[0];
+    stats.rx_packets = e->v[1];
+    stats.rx_errors = e->v[2];
+    stats.rx_dropped = e->v[3];
+    stats.rx_fifo_errors = e->v[4];
+    stats.rx_frame_errors = e->v[5];
+    stats.rx_compressed = e->v[6];
+    stats.multicast = e->v[7];
+    stats.tx_bytes = e->v[8];
+    stats.tx_packets = e->v[9];
+    stats.tx_errors = e->v[10];
+    stats.tx_dropped = e->v[11];
+    stats.tx_fifo_errors = e->v[12];
+    stats.collisions = e->v[13];
+    stats.tx_carrier_errors = e->v[14];
+    stats.tx_compressed = e->v[15];
 
     stats.errors_in = (stats.rx_errors + stats.rx_fifo_errors + stats.rx_frame_errors);
     stats.errors_out = (stats.tx_errors + stats.tx_fifo_errors + stats.tx_carrier_errors);
@@ -43,7 +43,6 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -57,6 +56,20 @@ static void *io_buf = NULL;
 static int io_size = 0;
 static int io_maxsize = 0;
 static int io_fd = -1;
+
+/* The statistics file is parsed once per interval into this table */
+#define IO_FIELDS 11
+struct io_entry {
+    unsigned int major;
+    unsigned int minor;
+    char name[MAX_PATH_LEN];
+    int nfields;
+    u_int64_t v[IO_FIELDS];
+};
+static struct io_entry *io_entries = NULL;
+static int io_count = 0;
+static int io_maxcount = 0;
+
 struct io_device_stats
 {
     u_int64_t read_issued;
@@ -80,10 +93,132 @@ char *io_filename = "/proc/partitions";
 #endif
 
 #if defined(HAS_PROC_DISKSTATS) || defined(HAS_PROC_PARTITIONS)
+/* Scan an unsigned decimal; returns pointer past it or NULL if none found */
+static char *
+io_scanu64(char *p, char *end, u_int64_t *v)
+{
+    u_int64_t n = 0;
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    if (p == end || *p < '0' || *p > '9')
+        return NULL;
+
+    while (p < end && *p >= '0' && *p <= '9')
+        n = n * 10 + (*p++ - '0');
+
+    *v = n;
+    return p;
+}
+
+/*
+ * diskstats:  major minor name rio rmerge rsect ruse wio wmerge wsect wuse running use aveq [...]
+ *             major minor name rio rsect wio wsect (partitions on 2.6 kernels)
+ * partitions: major minor #blocks name rio rmerge rsect ruse wio wmerge wsect wuse running use aveq
+ */
+static void
+io_index(void)
+{
+    char *p, *end, *eol, *name;
+    struct io_entry *e;
+    u_int64_t major, minor;
+#ifndef HAS_PROC_DISKSTATS
+    u_int64_t blocks;
+#endif
+    int i;
+
+    io_count = 0;
+    p = io_buf;
+    end = p + io_size;
+
+    for (; p < end; p = eol + 1) {
+        if ((eol = memchr(p, '\n', end - p)) == NULL)
+            eol = end;
+
+        if ((p = io_scanu64(p, eol, &major)) == NULL ||
+            (p = io_scanu64(p, eol, &minor)) == NULL)
+            continue; /* header or empty line */
+
+#ifndef HAS_PROC_DISKSTATS
+        if ((p = io_scanu64(p, eol, &blocks)) == NULL)
+            continue;
+#endif
+
+        while (p < eol && (*p == ' ' || *p == '\t'))
+            p++;
+        for (name = p; p < eol && *p != ' ' && *p != '\t'; p++)
+            ;
+        if (p == name || p - name >= MAX_PATH_LEN)
+            continue;
+
+        if (io_count == io_maxcount) {
+            io_maxcount = (io_maxcount == 0) ? 64 : io_maxcount * 2;
+            io_entries = xrealloc(io_entries, io_maxcount * sizeof(struct io_entry));
+        }
+
+        e = &io_entries[io_count];
+        e->major = major;
+        e->minor = minor;
+        memcpy(e->name, name, p - name);
+        e->name[p - name] = '\0';
+
+        for (i = 0; i < IO_FIELDS; i++)
+            if ((p = io_scanu64(p, eol, &e->v[i])) == NULL)
+                break;
+        e->nfields = i;
+
+        io_count++;
+    }
+}
+
+static int
+io_match(struct io_entry *e, struct stream *st)
+{
+    return (e->major == st->parg.io.major && e->minor == st->parg.io.minor &&
+            strcmp(e->name, st->parg.io.name) == 0);
+}
+
+/*
+ * Find a device by major:minor and exact name, trying the slot it had last
+ * interval first. A name that shows up on another device number after
+ * hotplug is a new device; the stream follows it and its counters restart.
+ */
+static struct io_entry *
+io_lookup(struct stream *st)
+{
+    int i, slot = st->parg.io.slot;
+
+    if (slot >= 0 && slot < io_count && io_match(&io_entries[slot], st))
+        return &io_entries[slot];
+
+    for (i = 0; i < io_count; i++) {
+        if (io_match(&io_entries[i], st)) {
+            st->parg.io.slot = i;
+            return &io_entries[i];
+        }
+    }
+
+    for (i = 0; i < io_count; i++) {
+        if (strcmp(io_entries[i].name, st->parg.io.name) == 0) {
+            if (slot >= 0)
+                info("io(%.200s): %.200s is now device %u:%u", st->arg,
+                     st->parg.io.name, io_entries[i].major, io_entries[i].minor);
+            st->parg.io.major = io_entries[i].major;
+            st->parg.io.minor = io_entries[i].minor;
+            st->parg.io.slot = i;
+            return &io_entries[i];
+        }
+    }
+
+    return NULL;
+}
+
 void
 init_io(struct stream *st)
 {
     struct disknamectx c;
+    struct io_entry *e;
     size_t lead = sizeof("/dev/") - 1;
 
     if (io_buf == NULL) {
@@ -94,24 +229,36 @@ init_io(struct stream *st)
     if (st->arg == NULL)
         fatal("io: need a <device>|<devicename> argument");
 
-    if ((io_fd = open(io_filename, O_RDONLY)) < 0)
+    if (io_fd < 0 && (io_fd = open(io_filename, O_RDONLY)) < 0)
         warning("cannot access %.200s: %.200s", io_filename, strerror(errno));
 
-    /* Retrieve io stats to search for devicename */
-    gets_io();
+    /* Retrieve io stats to search for devicename; streams expanded from a
+     * wildcard were found in the current stats */
+    if (st->origin == NULL)
+        gets_io();
+
+    if (st->pattern) {
+        info("started module io(%.200s)", st->arg);
+        return;
+    }
 
-    initdisknamectx(&c, st->arg, st->parg.io, sizeof(st->parg.io));
+    st->parg.io.slot = -1;
+    initdisknamectx(&c, st->arg, st->parg.io.name, sizeof(st->parg.io.name));
 
     while (nextdiskname(&c) != NULL) {
         /* devices are named sdX, not /dev/sdX */
-        if (strncmp(st->parg.io, "/dev/", lead) == 0)
-            memmove(&st->parg.io[0], &st->parg.io[0] + lead, sizeof(st->parg.io) - lead);
+        if (strncmp(st->parg.io.name, "/dev/", lead) == 0)
+            memmove(&st->parg.io.name[0], &st->parg.io.name[0] + lead, sizeof(st->parg.io.name) - lead);
 
-        if (strstr(io_buf, st->parg.io)) {
-            if (strcmp(st->arg, st->parg.io) == 0)
-                info("started module io(%.200s)", st->parg.io);
+        if ((e = io_lookup(st)) != NULL) {
+            /* streams expanded from a wildcard are logged there */
+            if (st->origin != NULL)
+                return;
+            if (strcmp(st->arg, st->parg.io.name) == 0)
+                info("started module io(%.200s)", st->parg.io.name);
             else
-                info("started module io(%.200s = %.200s)", st->arg, st->parg.io);
+                info("started module io(%.200s = %.200s %u:%u)", st->arg, st->parg.io.name,
+                     e->major, e->minor);
             return;
         }
     }
@@ -122,21 +269,11 @@ init_io(struct stream *st)
 void
 gets_io(void)
 {
-    int len;
-    char *p;
-
-    if (lseek(io_fd, 0, SEEK_SET) != 0)
-        fatal("%s seek error: %.200s", io_filename, strerror(errno));
+    ssize_t len;
 
-    bzero(io_buf, io_maxsize);
-
-    len = 0;
-    p = io_buf;
     io_size = 0;
-    while ((len = read(io_fd, p, io_maxsize - io_size)) > 0) {
-      p += len;
-      io_size += len;
-    }
+    while ((len = pread(io_fd, (char *) io_buf + io_size, io_maxsize - io_size, io_size)) > 0)
+        io_size += len;
 
     if (io_size == io_maxsize) {
         /* buffer is too small to hold all interface data */
@@ -150,55 +287,62 @@ gets_io(void)
         return;
     }
 
-    if (io_size == -1) {
+    if (len == -1) {
         warning("could not read io statistics from %.200s: %.200s", io_filename, strerror(errno));
+        io_size = 0;
     }
+
+    io_index();
+}
+
+char *
+names_io(int i)
+{
+    return (i < io_count) ? io_entries[i].name : NULL;
 }
 
 int
 get_io(char *symon_buf, int maxlen, struct stream *st)
 {
-    char *line;
+    struct io_entry *e;
     struct io_device_stats stats;
 
     if (io_size <= 0) {
         return 0;
     }
 
-    if ((line = strstr(io_buf, st->parg.io)) == NULL) {
-        warning("could not find disk %.200s = %.200s", st->arg, st->parg.io);
+    if ((e = io_lookup(st)) == NULL) {
+        /* expanded streams can lose their object before the next expansion */
+        if (st->origin == NULL)
+            warning("could not find disk %.200s = %.200s", st->arg, st->parg.io.name);
         return 0;
     }
 
-    line += strlen(st->parg.io);
     bzero(&stats, sizeof(struct io_device_stats));
 
-    if (11 > sscanf(line, " %" SCNu64 " %" SCNu64
-                          " %" SCNu64 " %" SCNu64
-                          " %" SCNu64 " %" SCNu64
-                          " %" SCNu64 " %" SCNu64
-                          " %" SCNu64 " %" SCNu64
-                          " %" SCNu64 "\n",
-                    &stats.read_issued, &stats.read_merged,
-                    &stats.read_sectors, &stats.read_milliseconds,
-                    &stats.write_issued, &stats.write_merged,
-                    &stats.write_sectors, &stats.write_milliseconds,
-                    &stats.progress_ios, &stats.progress_milliseconds,
-                    &stats.progress_weight)) {
+    if (e->nfields == IO_FIELDS) {
+        stats.read_issued = e->v[0];
+        stats.read_merged = e->v[1];
+        stats.read_sectors = e->v[2];
+        stats.read_milliseconds = e->v[3];
+        stats.write_issued = e->v[4];
+        stats.write_merged = e->v[5];
+        stats.write_sectors = e->v[6];
+        stats.write_milliseconds = e->v[7];
+        stats.progress_ios = e->v[8];
+        stats.progress_milliseconds = e->v[9];
+        stats.progress_weight = e->v[10];
 #ifdef HAS_PROC_DISKSTATS
-        if (4 > sscanf(line, " %" SCNu64 " %" SCNu64
-                             " %" SCNu64 " %" SCNu64 "\n",
-                       &stats.read_issued, &stats.read_sectors,
-                       &stats.write_issued, &stats.write_sectors)) {
-            warning("could not parse disk statistics for %.200s", st->arg);
-            return 0;
-        }
-    }
-#else
+    } else if (e->nfields == 4) {
+        stats.read_issued = e->v[0];
+        stats.read_sectors = e->v[1];
+        stats.write_issued = e->v[2];
+        stats.write_sectors = e->v[3];
+#endif
+    } else {
         warning("could not parse disk statistics for %.200s", st->arg);
         return 0;
     }
-#endif
 
     return snpack(symon_buf, maxlen, st->arg, MT_IO2,
                   stats.read_issued,
@@ -218,6 +362,11 @@ gets_io(void)
 {
     fatal("io module not available");
 }
+char *
+names_io(int i)
+{
+    return NULL;
+}
 int
 get_io(char *symon_buf, int maxlen, struct stream *st)
 {
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get current network buffer statistics and return them in symon_buf in the
+ * layout of mbuf:
+ *
+ * totmbufs : mt_data : mt_oobdata : mt_control : mt_header : mt_ftable :
+ * mt_soname : mt_soopts : pgused : pgtotal : totmem : totpct : m_drops :
+ * m_wait : m_drain
+ *
+ * as
+ *
+ * sockets used : tcp inuse : tcp orphan : tcp tw : tcp alloc : udp inuse :
+ * raw inuse : frag inuse : tcp mem pages : tcp_mem max pages : socket and
+ * fragment memory bytes : tcp pressure percentage : softnet dropped :
+ * softnet time_squeeze : udp buffer errors
+ */
+
+#include "conf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+/* Globals for this module start with mb_ */
+#define MB_SOCKSTAT 0
+#define MB_SOFTNET  1
+#define MB_SNMP     2
+#define MB_TCPMEM   3
+#define MB_FILES    4
+static const char *mb_path[MB_FILES] = {
+    "/proc/net/sockstat", "/proc/net/softnet_stat", "/proc/net/snmp",
+    "/proc/sys/net/ipv4/tcp_mem"
+};
+static int mb_fd[MB_FILES] = { -1, -1, -1, -1 };
+static char *mb_buf = NULL;
+static int mb_maxsize = 0;
+static u_int64_t mb_pagesize = 0;
+
+int mb_read(int);
+u_int64_t mb_value(const char *, const char *);
+u_int64_t mb_snmp(const char *, const char *);
+
+/* Read a whole file into mb_buf; returns 0 on errors */
+int
+mb_read(int file)
+{
+    ssize_t r;
+
+    if (mb_fd[file] < 0)
+        return 0;
+
+    while ((r = pread(mb_fd[file], mb_buf, mb_maxsize - 1, 0)) == mb_maxsize - 1) {
+        if (mb_maxsize >= SYMON_MAX_OBJSIZE * SYMON_MAX_DOBJECTS)
+            fatal("%s:%d: dynamic object limit (%d) exceeded for mbuf data",
+                  __FILE__, __LINE__, SYMON_MAX_OBJSIZE * SYMON_MAX_DOBJECTS);
+        mb_maxsize += SYMON_MAX_OBJSIZE;
+        mb_buf = xrealloc(mb_buf, mb_maxsize);
+    }
+
+    if (r < 0) {
+        warning("mbuf: cannot read %.200s: %.200s", mb_path[file], strerror(errno));
+        return 0;
+    }
+
+    mb_buf[r] = '\0';
+    return 1;
+}
+
+/* Value after a key on the line with a prefix, as in "TCP: inuse 5" */
+u_int64_t
+mb_value(const char *prefix, const char *key)
+{
+    char *line, *p, *end;
+    size_t klen;
+
+    klen = strlen(key);
+    for (line = mb_buf; line != NULL; line = (p = strchr(line, '\n')) ? p + 1 : NULL) {
+        if (strncmp(line, prefix, strlen(prefix)) != 0)
+            continue;
+
+        end = strchr(line, '\n');
+        for (p = line; (p = strstr(p, key)) != NULL && (end == NULL || p < end); p += klen)
+            if (p[-1] == ' ' && p[klen] == ' ')
+                return strtoull(p + klen + 1, NULL, 10);
+        return 0;
+    }
+
+    return 0;
+}
+
+/* Value of a named column in the header and value lines of /proc/net/snmp */
+u_int64_t
+mb_snmp(const char *prefix, const char *name)
+{
+    char *line, *p;
+    size_t plen, nlen;
+    int col, i;
+
+    plen = strlen(prefix);
+    nlen = strlen(name);
+    col = -1;
+    for (line = mb_buf; line != NULL; line = (p = strchr(line, '\n')) ? p + 1 : NULL) {
+        if (strncmp(line, prefix, plen) != 0)
+            continue;
+
+        if (col < 0) {
+            /* header: find the column */
+            for (p = line + plen, i = 0; *p == ' '; i++) {
+                p++;
+                if (strncmp(p, name, nlen) == 0 && (p[nlen] == ' ' || p[nlen] == '\n')) {
+                    col = i;
+                    break;
+                }
+                p += strcspn(p, " \n");
+            }
+            if (col < 0)
+                return 0;
+        } else {
+            for (p = line + plen, i = 0; i < col && *p == ' '; i++)
+                p += 1 + strcspn(p + 1, " \n");
+            return (*p == ' ') ? strtoull(p + 1, NULL, 10) : 0;
+        }
+    }
+
+    return 0;
+}
+
+void
+init_mbuf(struct stream *st)
+{
+    int i;
+
+    if (mb_buf == NULL) {
+        mb_maxsize = SYMON_MAX_OBJSIZE;
+        mb_buf = xmalloc(mb_maxsize);
+        mb_pagesize = sysconf(_SC_PAGESIZE);
+    }
+
+    for (i = 0; i < MB_FILES; i++)
+        if (mb_fd[i] < 0 && (mb_fd[i] = open(mb_path[i], O_RDONLY | O_CLOEXEC)) < 0)
+            warning("cannot access %.200s: %.200s", mb_path[i], strerror(errno));
+
+    info("started module mbuf(%.200s)", st->arg);
+}
+
+int
+get_mbuf(char *symon_buf, int maxlen, struct stream *st)
+{
+    u_int64_t sockets, tcp_inuse, tcp_orphan, tcp_tw, tcp_alloc, tcp_mem,
+        udp_inuse, udp_mem, raw_inuse, frag_inuse, frag_memory;
+    u_int64_t tcp_max, totmem, totpct, dropped, squeezed, bufferrors;
+    char *p, *end;
+
+    if (!mb_read(MB_SOCKSTAT))
+        return 0;
+
+    sockets = mb_value("sockets:", "used");
+    tcp_inuse = mb_value("TCP:", "inuse");
+    tcp_orphan = mb_value("TCP:", "orphan");
+    tcp_tw = mb_value("TCP:", "tw");
+    tcp_alloc = mb_value("TCP:", "alloc");
+    tcp_mem = mb_value("TCP:", "mem");
+    udp_inuse = mb_value("UDP:", "inuse");
+    udp_mem = mb_value("UDP:", "mem");
+    raw_inuse = mb_value("RAW:", "inuse");
+    frag_inuse = mb_value("FRAG:", "inuse");
+    frag_memory = mb_value("FRAG:", "memory");
+
+    /* one line per cpu: processed, dropped, time_squeeze, ... in hex */
+    dropped = squeezed = 0;
+    if (mb_read(MB_SOFTNET)) {
+        for (p = mb_buf; *p != '\0'; p = (end = strchr(p, '\n')) ? end + 1 : p + strlen(p)) {
+            strtoul(p, &end, 16);
+            dropped += strtoul(end, &end, 16);
+            squeezed += strtoul(end, &end, 16);
+        }
+    }
+
+    bufferrors = 0;
+    if (mb_read(MB_SNMP))
+        bufferrors = mb_snmp("Udp:", "RcvbufErrors") + mb_snmp("Udp:", "SndbufErrors");
+
+    /* tcp_mem is min, pressure and max in pages */
+    tcp_max = 0;
+    if (mb_read(MB_TCPMEM)) {
+        strtoull(mb_buf, &end, 10);
+        strtoull(end, &end, 10);
+        tcp_max = strtoull(end, NULL, 10);
+    }
+
+    totmem = (tcp_mem + udp_mem) * mb_pagesize + frag_memory;
+    totpct = (tcp_max > 0) ? (tcp_mem * 100) / tcp_max : 0;
+
+    return snpack(symon_buf, maxlen, st->arg, MT_MBUF,
+                  (u_int32_t) sockets,
+                  (u_int32_t) tcp_inuse,
+                  (u_int32_t) tcp_orphan,
+                  (u_int32_t) tcp_tw,
+                  (u_int32_t) tcp_alloc,
+                  (u_int32_t) udp_inuse,
+                  (u_int32_t) raw_inuse,
+                  (u_int32_t) frag_inuse,
+                  (u_int32_t) tcp_mem,
+                  (u_int32_t) tcp_max,
+                  (u_int32_t) totmem,
+                  (u_int32_t) totpct,
+                  (u_int32_t) dropped,
+                  (u_int32_t) squeezed,
+                  (u_int32_t) bufferrors);
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get current conntrack statistics over ctnetlink and return them in
+ * symon_buf in the layout of pf:
+ *
+ *   bytes_v4_in : bytes_v4_out : bytes_v6_in : bytes_v6_out :
+ *   packets_v4_in_pass : packets_v4_in_drop : packets_v4_out_pass :
+ *   packets_v4_out_drop : packets_v6_in_pass : packets_v6_in_drop :
+ *   packets_v6_out_pass : packets_v6_out_drop : states_entries :
+ *   states_searches : states_inserts : states_removals : counters_match :
+ *   counters_badoffset : counters_fragment : counters_short :
+ *   counters_normalize : counters_memory
+ *
+ * Conntrack keeps no byte and packet totals, these are 0. The state counters
+ * map to entries : found : insert : - : found : error : - : invalid :
+ * insert_failed : drop + early_drop, summed over all cpus.
+ */
+
+#include "conf.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nfnetlink_conntrack.h>
+
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+/* Globals for this module start with pf_ */
+static int pf_nl = -1;
+static u_int32_t pf_seq = 0;
+static char *pf_buf = NULL;
+static int pf_bufsize = 0;
+static int pf_valid = 0;
+static int pf_warned = 0;
+static u_int64_t pf_stats[CTA_STATS_MAX + 1];
+static u_int64_t pf_entries;
+
+/* Receive one datagram into pf_buf, growing it to fit; returns length */
+static int
+pf_recv(void)
+{
+    int len;
+
+    if ((len = recv(pf_nl, pf_buf, pf_bufsize, MSG_PEEK | MSG_TRUNC)) < 0)
+        return -1;
+
+    if (len > pf_bufsize) {
+        pf_bufsize = len;
+        pf_buf = xrealloc(pf_buf, pf_bufsize);
+    }
+
+    return recv(pf_nl, pf_buf, pf_bufsize, 0);
+}
+
+/* Add the u32 attributes of a stats message to the totals */
+static void
+pf_message(struct nlmsghdr *nh, int global)
+{
+    struct nlattr *nla;
+    u_int32_t v;
+    int alen, type;
+
+    alen = nh->nlmsg_len - NLMSG_SPACE(sizeof(struct nfgenmsg));
+    nla = (struct nlattr *) ((char *) NLMSG_DATA(nh) + NLMSG_ALIGN(sizeof(struct nfgenmsg)));
+    while (alen >= NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN && nla->nla_len <= alen) {
+        type = nla->nla_type & NLA_TYPE_MASK;
+        if (nla->nla_len == NLA_HDRLEN + sizeof(u_int32_t)) {
+            memcpy(&v, (char *) nla + NLA_HDRLEN, sizeof(v));
+            if (global) {
+                if (type == CTA_STATS_GLOBAL_ENTRIES)
+                    pf_entries = ntohl(v);
+            } else if (type <= CTA_STATS_MAX) {
+                pf_stats[type] += ntohl(v);
+            }
+        }
+        alen -= NLA_ALIGN(nla->nla_len);
+        nla = (struct nlattr *) ((char *) nla + NLA_ALIGN(nla->nla_len));
+    }
+}
+
+/* Run one ctnetlink stats request; returns 0 on errors */
+static int
+pf_request(u_int16_t cmd, int dump)
+{
+    struct {
+        struct nlmsghdr nh;
+        struct nfgenmsg nfg;
+    } req;
+    struct nlmsghdr *nh;
+    struct nlmsgerr *err;
+    int len;
+
+    bzero(&req, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct nfgenmsg));
+    req.nh.nlmsg_type = (NFNL_SUBSYS_CTNETLINK << 8) | cmd;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | (dump ? NLM_F_DUMP : NLM_F_ACK);
+    req.nh.nlmsg_seq = ++pf_seq;
+    req.nfg.nfgen_family = AF_UNSPEC;
+    req.nfg.version = NFNETLINK_V0;
+
+    if (send(pf_nl, &req, req.nh.nlmsg_len, 0) < 0)
+        return 0;
+
+    while ((len = pf_recv()) > 0) {
+        for (nh = (struct nlmsghdr *) pf_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != pf_seq)
+                continue;
+
+            switch (nh->nlmsg_type) {
+            case NLMSG_DONE:
+                return 1;
+            case NLMSG_ERROR:
+                err = NLMSG_DATA(nh);
+                errno = -err->error;
+                return (err->error == 0);
+            default:
+                pf_message(nh, !dump);
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void
+privinit_pf(struct stream *st)
+{
+    if (pf_nl == -1 &&
+        (pf_nl = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_NETFILTER)) == -1)
+        warning("pf: could not open netfilter netlink, %.200s", strerror(errno));
+}
+
+void
+init_pf(struct stream *st)
+{
+    if (pf_nl == -1)
+        privinit_pf(st);
+
+    /* nfnetlink only answers to CAP_NET_ADMIN */
+    if (geteuid() != 0)
+        warning("pf() requires symon to run as the superuser, use -u");
+
+    if (pf_buf == NULL) {
+        pf_bufsize = SYMON_MAX_OBJSIZE;
+        pf_buf = xmalloc(pf_bufsize);
+    }
+
+    info("started module pf()");
+}
+
+void
+gets_pf(void)
+{
+    pf_valid = 0;
+
+    if (pf_nl == -1)
+        return;
+
+    bzero(pf_stats, sizeof(pf_stats));
+    pf_entries = 0;
+
+    /* one message per cpu, then the global entry count */
+    if (!pf_request(IPCTNL_MSG_CT_GET_STATS_CPU, 1) ||
+        !pf_request(IPCTNL_MSG_CT_GET_STATS, 0)) {
+        if (!pf_warned)
+            warning("pf: could not get conntrack stats, %.200s", strerror(errno));
+        pf_warned = 1;
+        return;
+    }
+
+    pf_warned = 0;
+    pf_valid = 1;
+}
+
+int
+get_pf(char *symon_buf, int maxlen, struct stream *st)
+{
+    if (!pf_valid)
+        return 0;
+
+    return snpack(symon_buf, maxlen, st->arg, MT_PF,
+                  (u_int64_t) 0, (u_int64_t) 0, (u_int64_t) 0, (u_int64_t) 0,
+                  (u_int64_t) 0, (u_int64_t) 0, (u_int64_t) 0, (u_int64_t) 0,
+                  (u_int64_t) 0, (u_int64_t) 0, (u_int64_t) 0, (u_int64_t) 0,
+                  pf_entries,
+                  pf_stats[CTA_STATS_FOUND],
+                  pf_stats[CTA_STATS_INSERT],
+                  (u_int64_t) 0,
+                  pf_stats[CTA_STATS_FOUND],
+                  pf_stats[CTA_STATS_ERROR],
+                  (u_int64_t) 0,
+                  pf_stats[CTA_STATS_INVALID],
+                  pf_stats[CTA_STATS_INSERT_FAILED],
+                  pf_stats[CTA_STATS_DROP] + pf_stats[CTA_STATS_EARLY_DROP]);
+}
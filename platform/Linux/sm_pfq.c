@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get current qdisc statistics over rtnetlink and return them in symon_buf as
+ *
+ * sent_bytes : sent_packets : drop_bytes : drop_packets
+ *
+ * for pfq(eth0), the root qdisc of an interface, or pfq(eth0/1:0), the qdisc
+ * with that handle. Qdiscs do not count dropped bytes; drop_bytes is 0.
+ */
+
+#include "conf.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <net/if.h>
+#include <linux/gen_stats.h>
+#include <linux/netlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+/* Globals for this module start with pfq_ */
+struct pfq_stats {
+    int ifindex;
+    u_int32_t handle;
+    u_int32_t parent;
+    u_int64_t sent_bytes;
+    u_int64_t sent_packets;
+    u_int64_t drop_packets;
+};
+static struct pfq_stats *pfq_stats = NULL;
+static int pfq_cur = 0;
+static int pfq_max = 0;
+static int pfq_nl = -1;
+static u_int32_t pfq_seq = 0;
+static char *pfq_buf = NULL;
+static int pfq_bufsize = 0;
+static int pfq_valid = 0;
+static int pfq_warned = 0;
+
+/* Receive one datagram into pfq_buf, growing it to fit; returns length */
+static int
+pfq_recv(void)
+{
+    int len;
+
+    if ((len = recv(pfq_nl, pfq_buf, pfq_bufsize, MSG_PEEK | MSG_TRUNC)) < 0)
+        return -1;
+
+    if (len > pfq_bufsize) {
+        pfq_bufsize = len;
+        pfq_buf = xrealloc(pfq_buf, pfq_bufsize);
+    }
+
+    return recv(pfq_nl, pfq_buf, pfq_bufsize, 0);
+}
+
+/* Read the nested TCA_STATS2 counters of a qdisc */
+static void
+pfq_stats2(struct pfq_stats *q, struct rtattr *stats)
+{
+    struct gnet_stats_basic basic;
+    struct gnet_stats_queue queue;
+    struct rtattr *rta;
+    int len;
+
+    len = RTA_PAYLOAD(stats);
+    for (rta = RTA_DATA(stats); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        switch (rta->rta_type) {
+        case TCA_STATS_BASIC:
+            if (RTA_PAYLOAD(rta) < sizeof(basic))
+                break;
+            memcpy(&basic, RTA_DATA(rta), sizeof(basic));
+            q->sent_bytes = basic.bytes;
+            /* a later TCA_STATS_PKT64 has the full packet count */
+            if (q->sent_packets < basic.packets)
+                q->sent_packets = basic.packets;
+            break;
+        case TCA_STATS_PKT64:
+            if (RTA_PAYLOAD(rta) >= sizeof(u_int64_t))
+                memcpy(&q->sent_packets, RTA_DATA(rta), sizeof(u_int64_t));
+            break;
+        case TCA_STATS_QUEUE:
+            if (RTA_PAYLOAD(rta) < sizeof(queue))
+                break;
+            memcpy(&queue, RTA_DATA(rta), sizeof(queue));
+            q->drop_packets = queue.drops;
+            break;
+        }
+    }
+}
+
+/* Dump all qdiscs of all interfaces; returns 0 on errors */
+static int
+pfq_dump(void)
+{
+    struct {
+        struct nlmsghdr nh;
+        struct tcmsg tc;
+    } req;
+    struct nlmsghdr *nh;
+    struct nlmsgerr *err;
+    struct tcmsg *tc;
+    struct rtattr *rta;
+    struct pfq_stats *q;
+    int len, alen;
+
+    bzero(&req, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+    req.nh.nlmsg_type = RTM_GETQDISC;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = ++pfq_seq;
+    req.tc.tcm_family = AF_UNSPEC;
+
+    pfq_cur = 0;
+
+    if (send(pfq_nl, &req, req.nh.nlmsg_len, 0) < 0)
+        return 0;
+
+    while ((len = pfq_recv()) > 0) {
+        for (nh = (struct nlmsghdr *) pfq_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != pfq_seq)
+                continue;
+
+            if (nh->nlmsg_type == NLMSG_DONE)
+                return 1;
+
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                err = NLMSG_DATA(nh);
+                errno = -err->error;
+                return 0;
+            }
+
+            if (nh->nlmsg_type != RTM_NEWQDISC)
+                continue;
+
+            if (pfq_cur == pfq_max) {
+                pfq_max = (pfq_max == 0) ? 16 : pfq_max * 2;
+                if (pfq_max > SYMON_MAX_DOBJECTS)
+                    fatal("%s:%d: dynamic object limit (%d) exceeded for qdisc structures",
+                          __FILE__, __LINE__, SYMON_MAX_DOBJECTS);
+                pfq_stats = xrealloc(pfq_stats, pfq_max * sizeof(struct pfq_stats));
+            }
+
+            tc = NLMSG_DATA(nh);
+            q = &pfq_stats[pfq_cur++];
+            bzero(q, sizeof(struct pfq_stats));
+            q->ifindex = tc->tcm_ifindex;
+            q->handle = tc->tcm_handle;
+            q->parent = tc->tcm_parent;
+
+            alen = nh->nlmsg_len - NLMSG_LENGTH(sizeof(struct tcmsg));
+            for (rta = TCA_RTA(tc); RTA_OK(rta, alen); rta = RTA_NEXT(rta, alen))
+                if (rta->rta_type == TCA_STATS2)
+                    pfq_stats2(q, rta);
+        }
+    }
+
+    return 0;
+}
+
+void
+privinit_pfq(struct stream *st)
+{
+    /* nothing to do; qdiscs can be dumped without privileges */
+}
+
+void
+init_pfq(struct stream *st)
+{
+    char ifname[IFNAMSIZ];
+    unsigned int major, minor;
+    char *p, *end;
+
+    snprintf(ifname, sizeof(ifname), "%s", st->arg);
+    st->parg.pfq.root = 1;
+    st->parg.pfq.handle = 0;
+
+    if ((p = strchr(ifname, '/')) != NULL) {
+        *p++ = '\0';
+        major = strtoul(p, &end, 16);
+        if (end == p || *end++ != ':')
+            fatal("pfq(%.200s): expected interface or interface/major:minor", st->arg);
+        minor = (*end == '\0') ? 0 : strtoul(end, &end, 16);
+        if (*end != '\0')
+            fatal("pfq(%.200s): expected interface or interface/major:minor", st->arg);
+        st->parg.pfq.root = 0;
+        st->parg.pfq.handle = TC_H_MAKE(major << 16, minor);
+    }
+
+    snprintf(st->parg.pfq.ifname, sizeof(st->parg.pfq.ifname), "%s", ifname);
+    st->parg.pfq.ifindex = if_nametoindex(ifname);
+
+    if (pfq_nl == -1) {
+        if ((pfq_nl = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE)) == -1)
+            fatal("pfq: could not open rtnetlink, %.200s", strerror(errno));
+        pfq_bufsize = SYMON_MAX_OBJSIZE;
+        pfq_buf = xmalloc(pfq_bufsize);
+    }
+
+    info("started module pfq(%.200s)", st->arg);
+}
+
+void
+gets_pfq(void)
+{
+    if ((pfq_valid = pfq_dump())) {
+        pfq_warned = 0;
+    } else if (!pfq_warned) {
+        warning("pfq: could not dump qdiscs, %.200s", strerror(errno));
+        pfq_warned = 1;
+    }
+}
+
+int
+get_pfq(char *symon_buf, int maxlen, struct stream *st)
+{
+    int i, retry;
+
+    if (!pfq_valid)
+        return 0;
+
+    for (retry = 0; retry < 2; retry++) {
+        for (i = 0; i < pfq_cur; i++) {
+            if (pfq_stats[i].ifindex != st->parg.pfq.ifindex)
+                continue;
+            if (st->parg.pfq.root ? pfq_stats[i].parent != TC_H_ROOT :
+                pfq_stats[i].handle != st->parg.pfq.handle)
+                continue;
+
+            return snpack(symon_buf, maxlen, st->arg, MT_PFQ,
+                          pfq_stats[i].sent_bytes,
+                          pfq_stats[i].sent_packets,
+                          (u_int64_t) 0,
+                          pfq_stats[i].drop_packets);
+        }
+
+        /* the interface may have been created again under a new index */
+        st->parg.pfq.ifindex = if_nametoindex(st->parg.pfq.ifname);
+    }
+
+    return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get pressure stall information from /proc/pressure and return it in
+ * symon_buf as
+ *
+ * some avg10 : some avg60 : some avg300 : some total : full avg10 :
+ * full avg60 : full avg300 : full total
+ *
+ * for pressure(cpu), pressure(memory), pressure(io) or pressure(irq). The
+ * averages are percentages, the totals microseconds stalled.
+ *
+ * pressure(memory:some:150:1000) also registers a trigger with the kernel
+ * for 150ms of some memory stall in a 1000ms window. The trigger fd is
+ * watched by the event loop, and a crossing sends the pressure streams
+ * right away instead of at the next measurement. Either way the stream is
+ * reported under its resource name; readconf allows one per resource in a
+ * mux.
+ */
+
+#include "conf.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+/* Globals for this module start with ps_ */
+#define PS_RESOURCES 4
+#define PS_TRIGGERS  16
+struct ps_entry {
+    char *name;
+    int fd;
+    int ok;                     /* values of the last read are valid */
+    int warned;
+    double some[3];
+    u_int64_t some_total;
+    double full[3];
+    u_int64_t full_total;
+};
+struct ps_trigger {
+    char arg[SYMON_PS_ARGLENV2];
+    int fd;                     /* -1 if the kernel refused it */
+    int watched;
+};
+static struct ps_entry ps_entries[PS_RESOURCES] = {
+    { "cpu", -1, 0, 0, { 0, 0, 0 }, 0, { 0, 0, 0 }, 0 },
+    { "memory", -1, 0, 0, { 0, 0, 0 }, 0, { 0, 0, 0 }, 0 },
+    { "io", -1, 0, 0, { 0, 0, 0 }, 0, { 0, 0, 0 }, 0 },
+    { "irq", -1, 0, 0, { 0, 0, 0 }, 0, { 0, 0, 0 }, 0 }
+};
+static struct ps_trigger ps_triggers[PS_TRIGGERS];
+static int ps_ntriggers = 0;
+
+int ps_resource(struct stream *, char **);
+void ps_event(int, void *);
+void ps_open(int);
+void ps_trigger(struct stream *, int, char *);
+
+/* Resource of a stream argument; *trigger points to the rest, if any */
+int
+ps_resource(struct stream *st, char **trigger)
+{
+    size_t len;
+    int i;
+
+    len = strcspn(st->arg, ":");
+    *trigger = (st->arg[len] == ':') ? st->arg + len + 1 : NULL;
+
+    for (i = 0; i < PS_RESOURCES; i++)
+        if (strlen(ps_entries[i].name) == len &&
+            strncmp(ps_entries[i].name, st->arg, len) == 0)
+            return i;
+
+    fatal("pressure(%.200s): expected cpu, memory, io or irq", st->arg);
+
+    /* NOT REACHED */
+    return 0;
+}
+void
+ps_open(int r)
+{
+    char path[MAX_PATH_LEN];
+
+    if (ps_entries[r].fd >= 0)
+        return;
+
+    snprintf(path, sizeof(path), "/proc/pressure/%s", ps_entries[r].name);
+    if ((ps_entries[r].fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        warning("cannot access %.200s: %.200s", path, strerror(errno));
+}
+/* Register "some|full:stall ms:window ms" with the kernel */
+void
+ps_trigger(struct stream *st, int r, char *spec)
+{
+    struct ps_trigger *t;
+    char path[MAX_PATH_LEN];
+    char kind[5];
+    char buf[64];
+    unsigned int stall, window;
+    int i, len;
+
+    for (i = 0; i < ps_ntriggers; i++)
+        if (strcmp(ps_triggers[i].arg, st->arg) == 0)
+            return;
+
+    if (sscanf(spec, "%4[a-z]:%u:%u", kind, &stall, &window) != 3 ||
+        (strcmp(kind, "some") != 0 && strcmp(kind, "full") != 0))
+        fatal("pressure(%.200s): expected resource:some|full:stall ms:window ms",
+              st->arg);
+
+    if (ps_ntriggers == PS_TRIGGERS)
+        fatal("pressure(%.200s): more than %d triggers", st->arg, PS_TRIGGERS);
+
+    t = &ps_triggers[ps_ntriggers++];
+    snprintf(t->arg, sizeof(t->arg), "%s", st->arg);
+    t->watched = 0;
+
+    snprintf(path, sizeof(path), "/proc/pressure/%s", ps_entries[r].name);
+    if ((t->fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC)) < 0) {
+        warning("pressure(%.200s): cannot open %.200s: %.200s",
+                st->arg, path, strerror(errno));
+        return;
+    }
+
+    /* the kernel wants the terminating nul */
+    len = snprintf(buf, sizeof(buf), "%s %u %u", kind, stall * 1000, window * 1000);
+    if (write(t->fd, buf, len + 1) < 0) {
+        /* without CAP_SYS_RESOURCE windows are multiples of 2s */
+        if (errno == EINVAL && (window % 2000) != 0)
+            warning("pressure(%.200s): cannot register trigger: %.200s; "
+                    "windows must be a multiple of 2000ms without CAP_SYS_RESOURCE",
+                    st->arg, strerror(errno));
+        else
+            warning("pressure(%.200s): cannot register trigger: %.200s",
+                    st->arg, strerror(errno));
+        close(t->fd);
+        t->fd = -1;
+    }
+}
+void
+ps_event(int fd, void *arg)
+{
+    debug("pressure(%.200s) crossed its threshold", ((struct ps_trigger *) arg)->arg);
+    stream_alert(MT_PRESSURE);
+}
+/* Triggers are registered before privileges are dropped */
+void
+privinit_pressure(struct stream *st)
+{
+    char *trigger;
+    int r;
+
+    r = ps_resource(st, &trigger);
+    ps_open(r);
+
+    if (trigger != NULL)
+        ps_trigger(st, r, trigger);
+}
+void
+init_pressure(struct stream *st)
+{
+    char *trigger;
+    int i;
+
+    st->parg.pressure = ps_resource(st, &trigger);
+    ps_open(st->parg.pressure);
+
+    if (trigger != NULL) {
+        ps_trigger(st, st->parg.pressure, trigger);
+
+        for (i = 0; i < ps_ntriggers; i++)
+            if (ps_triggers[i].fd >= 0 && !ps_triggers[i].watched) {
+                event_urgent(ps_triggers[i].fd, ps_event, &ps_triggers[i]);
+                ps_triggers[i].watched = 1;
+            }
+    }
+
+    info("started module pressure(%.200s)", st->arg);
+}
+void
+gets_pressure(void)
+{
+    struct ps_entry *e;
+    char buf[256];
+    char *full;
+    ssize_t n;
+    int r;
+
+    for (r = 0; r < PS_RESOURCES; r++) {
+        e = &ps_entries[r];
+        e->ok = 0;
+        if (e->fd < 0)
+            continue;
+
+        if ((n = pread(e->fd, buf, sizeof(buf) - 1, 0)) < 0) {
+            if (!e->warned)
+                warning("cannot read /proc/pressure/%.200s: %.200s",
+                        e->name, strerror(errno));
+            e->warned = 1;
+            continue;
+        }
+        buf[n] = '\0';
+
+        /* irq only has full; cpu has a full line of zeroes since 5.13 */
+        bzero(e->some, sizeof(e->some));
+        bzero(e->full, sizeof(e->full));
+        e->some_total = e->full_total = 0;
+        if (strncmp(buf, "some ", 5) == 0)
+            sscanf(buf, "some avg10=%lf avg60=%lf avg300=%lf total=%llu",
+                   &e->some[0], &e->some[1], &e->some[2],
+                   (unsigned long long *) &e->some_total);
+        if ((full = strstr(buf, "full ")) != NULL)
+            sscanf(full, "full avg10=%lf avg60=%lf avg300=%lf total=%llu",
+                   &e->full[0], &e->full[1], &e->full[2],
+                   (unsigned long long *) &e->full_total);
+
+        e->warned = 0;
+        e->ok = 1;
+    }
+}
+int
+get_pressure(char *symon_buf, int maxlen, struct stream *st)
+{
+    struct ps_entry *e;
+
+    e = &ps_entries[st->parg.pressure];
+    if (!e->ok)
+        return 0;
+
+    return snpack(symon_buf, maxlen, e->name, MT_PRESSURE,
+                  e->some[0], e->some[1], e->some[2], e->some_total,
+                  e->full[0], e->full[1], e->full[2], e->full_total);
+}
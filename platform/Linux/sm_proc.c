@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get process statistics from /proc and return them in symon_buf as
+ *
+ * number of processes : ticks_user : ticks_system : ticks_interrupt :
+ * cpuseconds : cpu percentage : procsizes : resident segment sizes
+ *
+ * for all processes whose name starts with the argument.
+ *
+ * The names of all pids are cached. Each measurement lists /proc and only
+ * reads the stat of new pids, of pids whose name matches a proc stream and of
+ * a small share of the others, to notice an exec or a reused pid. Resident
+ * sizes are proportional set sizes from smaps_rollup when it can be read, so
+ * shared pages are not counted twice.
+ */
+
+#include "conf.h"
+
+#include <sys/param.h>
+#include <sys/types.h>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+#define PR_COMMLEN  16          /* kernel TASK_COMM_LEN */
+#define PR_RECHECK  32          /* recheck 1 in this many names per measurement */
+
+/* Globals for this module start with pr_ */
+struct pr_task {
+    pid_t pid;
+    int wanted;                 /* name matches a proc stream */
+    int born;                   /* pr_gen of first sight */
+    int checked;                /* pr_gen of last stat read */
+    int nopss;                  /* smaps_rollup cannot be read */
+    u_int64_t utime;
+    u_int64_t stime;
+    u_int64_t vsize;
+    u_int64_t rss;              /* bytes; pss when available */
+    char name[PR_COMMLEN];
+};
+static struct pr_task *pr_tasks = NULL;
+static struct pr_task *pr_next = NULL;
+static int pr_ntasks = 0;
+static int pr_maxtasks = 0;
+static pid_t *pr_pids = NULL;
+static int pr_maxpids = 0;
+static char **pr_args = NULL;
+static int pr_nargs = 0;
+static int pr_rematch = 0;
+static int pr_dirfd = -1;
+static int pr_gen = 0;
+static long pr_hz = 100;
+static long pr_pagesize = 4096;
+
+int proc_cmp(const void *, const void *);
+int proc_match(char *);
+void proc_pss(struct pr_task *);
+int proc_stat(struct pr_task *);
+double proc_time(void);
+
+void
+privinit_proc(struct stream *st)
+{
+    /* EMPTY */
+}
+
+void
+init_proc(struct stream *st)
+{
+    char buf[SYMON_MAX_OBJSIZE];
+    int i;
+
+    if (pr_dirfd < 0) {
+        if ((pr_dirfd = open("/proc", O_RDONLY | O_DIRECTORY)) < 0)
+            fatal("cannot open /proc: %.200s", strerror(errno));
+        if ((pr_hz = sysconf(_SC_CLK_TCK)) <= 0)
+            pr_hz = 100;
+        pr_pagesize = sysconf(_SC_PAGESIZE);
+    }
+
+    for (i = 0; i < pr_nargs; i++)
+        if (strcmp(pr_args[i], st->arg) == 0)
+            break;
+    if (i == pr_nargs) {
+        pr_args = xrealloc(pr_args, (pr_nargs + 1) * sizeof(char *));
+        pr_args[pr_nargs++] = xstrdup(st->arg);
+        pr_rematch = 1;
+    }
+
+    gets_proc();
+    get_proc(buf, sizeof(buf), st);
+
+    info("started module proc(%.200s)", st->arg);
+}
+
+double
+proc_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+proc_cmp(const void *a, const void *b)
+{
+    pid_t pa = *(const pid_t *) a;
+    pid_t pb = *(const pid_t *) b;
+
+    return (pa > pb) - (pa < pb);
+}
+
+/* Names are truncated by the kernel; arguments match their leading chars */
+int
+proc_match(char *name)
+{
+    int i;
+
+    for (i = 0; i < pr_nargs; i++)
+        if (strncmp(pr_args[i], name, MIN(strlen(pr_args[i]), PR_COMMLEN - 1)) == 0)
+            return 1;
+
+    return 0;
+}
+
+/* Read /proc/pid/stat; returns 0 when the task is gone */
+int
+proc_stat(struct pr_task *t)
+{
+    char path[32];
+    char buf[1024];
+    u_int64_t v[4];
+    char *p, *end;
+    int fd, len, field, f;
+
+    snprintf(path, sizeof(path), "%d/stat", (int) t->pid);
+    if ((fd = openat(pr_dirfd, path, O_RDONLY)) < 0)
+        return 0;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+
+    /* pid (comm) state ...; comm may contain anything, even ')' */
+    if ((p = strchr(buf, '(')) == NULL || (end = strrchr(buf, ')')) == NULL || end < p)
+        return 0;
+    snprintf(t->name, sizeof(t->name), "%.*s", (int) (end - p - 1), p + 1);
+
+    /* fields 14 utime, 15 stime, 23 vsize, 24 rss */
+    bzero(v, sizeof(v));
+    p = end + 1;
+    for (field = 3, f = 0; *p != '\0' && field <= 24; field++) {
+        while (*p == ' ')
+            p++;
+        if (field == 14 || field == 15 || field >= 23) {
+            for (v[f] = 0; isdigit((unsigned char) *p); p++)
+                v[f] = v[f] * 10 + (*p - '0');
+            f++;
+        }
+        while (*p != ' ' && *p != '\0')
+            p++;
+    }
+
+    if (f < 4)
+        return 0;
+
+    t->utime = v[0];
+    t->stime = v[1];
+    t->vsize = v[2];
+    t->rss = v[3] * pr_pagesize;
+    t->checked = pr_gen;
+
+    return 1;
+}
+
+/* Replace rss by pss; smaps_rollup walks the page tables of the task */
+void
+proc_pss(struct pr_task *t)
+{
+    char path[32];
+    char buf[2048];
+    u_int64_t pss;
+    char *p;
+    int fd, len;
+
+    if (t->nopss)
+        return;
+
+    snprintf(path, sizeof(path), "%d/smaps_rollup", (int) t->pid);
+    if ((fd = openat(pr_dirfd, path, O_RDONLY)) < 0) {
+        t->nopss = 1;
+        return;
+    }
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+
+    /* kernel threads have an empty rollup */
+    if (len <= 0 || (p = strstr((buf[len] = '\0', buf), "\nPss:")) == NULL) {
+        t->nopss = 1;
+        return;
+    }
+
+    for (p += 5; *p == ' '; p++)
+        ;
+    for (pss = 0; isdigit((unsigned char) *p); p++)
+        pss = pss * 10 + (*p - '0');
+
+    t->rss = pss * 1024;
+}
+
+void
+gets_proc(void)
+{
+    struct pr_task *t, *swap;
+    struct dirent *dp;
+    DIR *d;
+    int fd, npids, i, j;
+    char *p;
+    long pid;
+
+    pr_gen++;
+
+    if ((fd = dup(pr_dirfd)) < 0 || (d = fdopendir(fd)) == NULL) {
+        warning("cannot list /proc: %.200s", strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+    rewinddir(d);
+
+    npids = 0;
+    while ((dp = readdir(d)) != NULL) {
+        if (!isdigit((unsigned char) dp->d_name[0]))
+            continue;
+        pid = strtol(dp->d_name, &p, 10);
+        if (*p != '\0')
+            continue;
+        if (npids == pr_maxpids) {
+            pr_maxpids = (pr_maxpids == 0) ? 1024 : pr_maxpids * 2;
+            pr_pids = xrealloc(pr_pids, pr_maxpids * sizeof(pid_t));
+        }
+        pr_pids[npids++] = (pid_t) pid;
+    }
+    closedir(d);
+
+    qsort(pr_pids, npids, sizeof(pid_t), proc_cmp);
+
+    if (npids > pr_maxtasks) {
+        pr_maxtasks = npids + npids / 4;
+        pr_tasks = xrealloc(pr_tasks, pr_maxtasks * sizeof(struct pr_task));
+        pr_next = xrealloc(pr_next, pr_maxtasks * sizeof(struct pr_task));
+    }
+
+    /* merge the sorted listing with the cached tasks */
+    for (i = j = 0; i < npids; i++) {
+        while (j < pr_ntasks && pr_tasks[j].pid < pr_pids[i])
+            j++;
+
+        t = &pr_next[i];
+        if (j < pr_ntasks && pr_tasks[j].pid == pr_pids[i]) {
+            *t = pr_tasks[j];
+            if (pr_rematch)
+                t->wanted = proc_match(t->name);
+            /*
+             * Processes that exec keep their pid and pids are reused; check
+             * names once more after the first sight and then now and again
+             */
+            if (!t->wanted && t->born != pr_gen - 1 &&
+                (t->pid % PR_RECHECK) != (pr_gen % PR_RECHECK))
+                continue;
+        } else {
+            bzero(t, sizeof(struct pr_task));
+            t->pid = pr_pids[i];
+            t->born = pr_gen;
+        }
+
+        if (proc_stat(t)) {
+            t->wanted = proc_match(t->name);
+            if (t->wanted)
+                proc_pss(t);
+        } else {
+            t->wanted = 0;
+        }
+    }
+
+    swap = pr_tasks;
+    pr_tasks = pr_next;
+    pr_next = swap;
+    pr_ntasks = npids;
+    pr_rematch = 0;
+}
+
+int
+get_proc(char *symon_buf, int maxlen, struct stream *st)
+{
+    struct pr_task *t;
+    u_int64_t cpu_uticks = 0;
+    u_int64_t cpu_sticks = 0;
+    u_int64_t mem_procsize = 0;
+    u_int64_t mem_rss = 0;
+    u_int64_t ticks;
+    double when, cpu_pct = 0;
+    int n = 0;
+    int i, len;
+
+    len = MIN(strlen(st->arg), PR_COMMLEN - 1);
+    for (i = 0; i < pr_ntasks; i++) {
+        t = &pr_tasks[i];
+        if (t->wanted && t->checked == pr_gen && strncmp(st->arg, t->name, len) == 0) {
+            cpu_uticks += t->utime;
+            cpu_sticks += t->stime;
+            mem_procsize += t->vsize;
+            mem_rss += t->rss;
+            n++;
+        }
+    }
+
+    /* cpu percentage since the previous measurement of this stream */
+    ticks = cpu_uticks + cpu_sticks;
+    when = proc_time();
+    if (st->parg.pr.when > 0 && when > st->parg.pr.when && (int64_t) ticks > st->parg.pr.ticks)
+        cpu_pct = (ticks - st->parg.pr.ticks) * 100.0 / pr_hz / (when - st->parg.pr.when);
+    st->parg.pr.ticks = ticks;
+    st->parg.pr.when = when;
+
+    return snpack(symon_buf, maxlen, st->arg, MT_PROC,
+                  n,
+                  cpu_uticks, cpu_sticks, (u_int64_t) 0,
+                  (u_int32_t) (ticks / pr_hz), MIN(cpu_pct, 100.0),
+                  (u_int32_t) MIN(mem_procsize, 0xffffffffULL),
+                  (u_int32_t) MIN(mem_rss, 0xffffffffULL));
+}
@@ -33,6 +33,9 @@
  *
  * num : value
  *
+ * Sensor files are opened once and read with pread. gets_sensor reads all
+ * sensors that were measured in its previous round in one pass; others are
+ * read when they are measured.
  */
 
 #include "conf.h"
@@ -41,112 +44,330 @@
 #include <sys/stat.h>
 
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
-#include <inttypes.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "error.h"
 #include "symon.h"
 #include "xmalloc.h"
 
+#define SN_HWMON "/sys/class/hwmon"
+
+/* Globals for this module all start with sn_ */
+struct sn_entry {
+    char path[MAX_PATH_LEN];
+    int fd;
+    int read;                   /* sn_gen of last read */
+    int got;                    /* sn_gen of last get */
+    int ok;                     /* last read gave a value */
+    int warned;
+    double value;
+};
+static struct sn_entry *sn_entries = NULL;
+static int sn_nentries = 0;
+static int sn_maxentries = 0;
+static int sn_gen = 0;
+
+int sensor_chip(char *, char *, char *, char *);
+int sensor_entry(char *);
+int sensor_exists(char *, char *, char *);
+int sensor_find(char *, char *);
+int sensor_line(char *, char *, int);
+void sensor_read(struct sn_entry *);
+int sensor_type(char *);
+
 void
 privinit_sensor(struct stream *st)
 {
     /* EMPTY */
 }
+/* Read the first line of a small sysfs file */
+int
+sensor_line(char *path, char *buf, int maxlen)
+{
+    int fd, len;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return 0;
+    len = read(fd, buf, maxlen - 1);
+    close(fd);
+
+    if (len <= 0)
+        return 0;
+
+    buf[len] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    return 1;
+}
+/* Does dir/name_input exist? A path that does not fit is not a match */
+int
+sensor_exists(char *path, char *dir, char *name)
+{
+    struct stat pathinfo;
+
+    if (snprintf(path, MAX_PATH_LEN, "%s/%s_input", dir, name) >= MAX_PATH_LEN)
+        return 0;
+    return (stat(path, &pathinfo) == 0);
+}
+/* Sensor on chip with a name or label */
+int
+sensor_chip(char *path, char *dir, char *chip, char *label)
+{
+    char buf[_POSIX2_LINE_MAX];
+    char base[MAX_PATH_LEN];
+    struct dirent *dp;
+    DIR *d;
+    int len, found;
+
+    if (snprintf(path, MAX_PATH_LEN, "%s/name", dir) >= MAX_PATH_LEN ||
+        !sensor_line(path, buf, sizeof(buf)) || strcmp(buf, chip) != 0)
+        return 0;
+
+    if (sensor_type(label) >= 0 && sensor_exists(path, dir, label))
+        return 1;
+
+    if ((d = opendir(dir)) == NULL)
+        return 0;
+
+    found = 0;
+    while (!found && (dp = readdir(d)) != NULL) {
+        len = strlen(dp->d_name);
+        if (len < 7 || strcmp(dp->d_name + len - 6, "_label") != 0)
+            continue;
+
+        if (snprintf(path, MAX_PATH_LEN, "%s/%s", dir, dp->d_name) >= MAX_PATH_LEN ||
+            !sensor_line(path, buf, sizeof(buf)) || strcmp(buf, label) != 0)
+            continue;
+
+        snprintf(base, sizeof(base), "%.*s", len - 6, dp->d_name);
+        found = sensor_exists(path, dir, base);
+    }
+    closedir(d);
+
+    return found;
+}
+/*
+ * Find the _input file of a sensor argument. Sensors can be identified as
+ *
+ * - chip:label; the sensor in any /sys/class/hwmon/hwmon* whose name is chip
+ *   and whose label, or name, is label: coretemp:Core 0 or nct6775:fan2
+ *
+ * - a relative path; /sys/class/hwmon/hwmon*[/device]/${arg}_input is
+ *   then assumed, hwmon0 first: fan1, or hwmon1/fan1
+ *
+ * - the full path, e.g. /sys/class/hwmon/hwmon0/fan1 or
+ *   /sys/class/hwmon/hwmon0/device/fan1
+ *
+ * - the full path outside of sysfs, this may be necessary for hwmon probes
+ *   that need to some calculation before returning usable results,
+ *   e.g. /symon/fan1
+ *
+ * Note that _input is always appended to the sensor argument.
+ */
+int
+sensor_find(char *arg, char *path)
+{
+    char dir[MAX_PATH_LEN];
+    char chip[_POSIX2_LINE_MAX];
+    struct stat pathinfo;
+    struct dirent *dp;
+    char *label;
+    DIR *d;
+    int found;
 
+    if (arg[0] == '/') {
+        if (snprintf(path, MAX_PATH_LEN, "%s_input", arg) >= MAX_PATH_LEN)
+            return 0;
+        return (stat(path, &pathinfo) == 0);
+    }
+
+    if ((label = strchr(arg, ':')) != NULL) {
+        snprintf(chip, sizeof(chip), "%.*s", (int) (label - arg), arg);
+        label++;
+    } else {
+        snprintf(dir, sizeof(dir), SN_HWMON "/hwmon0");
+        if (sensor_exists(path, SN_HWMON, arg) ||
+            sensor_exists(path, dir, arg))
+            return 1;
+        snprintf(dir, sizeof(dir), SN_HWMON "/hwmon0/device");
+        if (sensor_exists(path, dir, arg))
+            return 1;
+    }
+
+    if ((d = opendir(SN_HWMON)) == NULL)
+        return 0;
+
+    found = 0;
+    while (!found && (dp = readdir(d)) != NULL) {
+        if (strncmp(dp->d_name, "hwmon", 5) != 0)
+            continue;
+
+        snprintf(dir, sizeof(dir), SN_HWMON "/%s", dp->d_name);
+        if (label != NULL) {
+            found = sensor_chip(path, dir, chip, label);
+            if (!found) {
+                snprintf(dir, sizeof(dir), SN_HWMON "/%s/device", dp->d_name);
+                found = sensor_chip(path, dir, chip, label);
+            }
+        } else {
+            found = sensor_exists(path, dir, arg);
+            if (!found) {
+                snprintf(dir, sizeof(dir), SN_HWMON "/%s/device", dp->d_name);
+                found = sensor_exists(path, dir, arg);
+            }
+        }
+    }
+    closedir(d);
+
+    return found;
+}
+/* Sensor type from the name of its input: fan1_input, in0_input, ... */
+int
+sensor_type(char *name)
+{
+    char *p;
+
+    if ((p = strrchr(name, '/')) != NULL)
+        name = p + 1;
+
+    if (strncmp(name, "fan", 3) == 0 && isdigit((unsigned char) name[3]))
+        return SENSOR_FAN;
+    if (strncmp(name, "in", 2) == 0 && isdigit((unsigned char) name[2]))
+        return SENSOR_IN;
+    if (strncmp(name, "temp", 4) == 0 && isdigit((unsigned char) name[4]))
+        return SENSOR_TEMP;
+
+    return -1;
+}
+/* Entry of a sensor file, opened once */
+int
+sensor_entry(char *path)
+{
+    struct sn_entry *e;
+    int i;
+
+    for (i = 0; i < sn_nentries; i++)
+        if (strcmp(sn_entries[i].path, path) == 0)
+            return i;
+
+    if (sn_nentries == sn_maxentries) {
+        sn_maxentries = (sn_maxentries == 0) ? 8 : sn_maxentries * 2;
+        sn_entries = xrealloc(sn_entries, sn_maxentries * sizeof(struct sn_entry));
+    }
+
+    e = &sn_entries[sn_nentries];
+    bzero(e, sizeof(struct sn_entry));
+    snprintf(e->path, sizeof(e->path), "%s", path);
+    e->read = e->got = -1;
+    if ((e->fd = open(e->path, O_RDONLY)) < 0)
+        fatal("sensor: cannot access %.200s: %.200s", e->path, strerror(errno));
+
+    return sn_nentries++;
+}
 void
 init_sensor(struct stream *st)
 {
     char buf[SYMON_MAX_OBJSIZE];
-    struct stat pathinfo;
-    char *name, *p;
-    int32_t n;
-
-    /* sensors can be identified as using
-     *
-     * - a relative path; /sys/class/hwmon[/hwmon0][/device]/${arg}_input is
-     *   then assumed: hwmon0/fan1 or fan1
-     *
-     * - the full path, e.g. /sys/class/hwmon/hwmon0/fan1 or
-     *   /sys/class/hwmon/hwmon0/device/fan1
-     *
-     * - the full path outside of sysfs, this may be necessary for hwmon probes
-     *   that need to some calculation before returning usable results,
-     *   e.g. /symon/fan1
-     *
-     * Note that _input is always appended to the sensor argument.
-     */
+    char *p = &st->parg.sn.path[0];
 
     if (strlen(st->arg) < 1)
         fatal("sensor(): no valid argument");
 
-    /* Determine the sensor type */
-    if ((name = strrchr(st->arg, '/')))
-        name += 1;
-    else
-        name = st->arg;
-
-    if (sscanf(name, "fan%" SCNd32, &n) == 1)
-        st->parg.sn.type = SENSOR_FAN;
-    else if (sscanf(name, "in%" SCNd32, &n) == 1)
-        st->parg.sn.type = SENSOR_IN;
-    else if (sscanf(name, "temp%" SCNd32, &n) == 1)
-        st->parg.sn.type = SENSOR_TEMP;
-    else
-        fatal("sensor(%.200s): '%s' is a unknown sensor type; expected fan/in/temp",
-              st->arg, name);
-
-    /* Find the sensor in sysfs */
-    p = &st->parg.sn.path[0];
-    if (st->arg[0] == '/') {
-        snprintf(p, MAX_PATH_LEN - 1, "%s_input", st->arg);
-        p[MAX_PATH_LEN - 1] = '\0';
-
-        if (stat(p, &pathinfo) < 0)
-            fatal("sensor(%.200s): could not find sensor at '%.200s'",
-                  st->arg, p);
-    } else {
-        snprintf(p, MAX_PATH_LEN - 1, "/sys/class/hwmon/hwmon0/%s_input", st->arg);
-        p[MAX_PATH_LEN - 1] = '\0';
+    if (!sensor_find(st->arg, p))
+        fatal("sensor(%.200s): could not be found in " SN_HWMON "/hwmon*[/device]",
+              st->arg);
 
-        if (stat(p, &pathinfo) < 0) {
-            snprintf(p, MAX_PATH_LEN - 1, "/sys/class/hwmon/hwmon0/device/%s_input", st->arg);
-            p[MAX_PATH_LEN - 1] = '\0';
+    if ((st->parg.sn.type = sensor_type(p)) < 0)
+        fatal("sensor(%.200s): '%.200s' is a unknown sensor type; expected fan/in/temp",
+              st->arg, p);
 
-            if (stat(p, &pathinfo) < 0)
-                fatal("sensor(%.200s): could not be found in /sys/class/hwmon/hwmon0[/device]/%s_input",
-                      st->arg, st->arg);
-        }
-    }
+    st->parg.sn.slot = sensor_entry(p);
 
     get_sensor(buf, sizeof(buf), st);
 
     info("started module sensor(%.200s)", st->arg);
 }
+/* sysfs values are integers; files outside sysfs may hold reals */
+void
+sensor_read(struct sn_entry *e)
+{
+    char buf[64];
+    char *p;
+    int64_t v;
+    int len, neg;
+
+    e->read = sn_gen;
+    e->ok = 0;
+
+    len = pread(e->fd, buf, sizeof(buf) - 1, 0);
+    if (len < 0) {
+        /* the driver may have been reloaded */
+        close(e->fd);
+        if ((e->fd = open(e->path, O_RDONLY)) >= 0)
+            len = pread(e->fd, buf, sizeof(buf) - 1, 0);
+    }
+    if (len <= 0) {
+        if (!e->warned)
+            warning("sensor: cannot read %.200s: %.200s", e->path,
+                    (len < 0) ? strerror(errno) : "no data");
+        e->warned = 1;
+        return;
+    }
+    buf[len] = '\0';
+
+    p = buf;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if ((neg = (*p == '-')) || *p == '+')
+        p++;
+    if (!isdigit((unsigned char) *p)) {
+        if (!e->warned)
+            warning("sensor: cannot parse %.200s", e->path);
+        e->warned = 1;
+        return;
+    }
+
+    for (v = 0; isdigit((unsigned char) *p); p++)
+        v = v * 10 + (*p - '0');
+
+    if (*p == '.' || *p == 'e' || *p == 'E')
+        e->value = strtod(buf, NULL);
+    else
+        e->value = (double) (neg ? -v : v);
+
+    e->ok = 1;
+    e->warned = 0;
+}
+void
+gets_sensor(void)
+{
+    int i, last;
+
+    last = sn_gen++;
+    for (i = 0; i < sn_nentries; i++)
+        if (sn_entries[i].got == last)
+            sensor_read(&sn_entries[i]);
+}
 
 int
 get_sensor(char *symon_buf, int maxlen, struct stream *st)
 {
-    FILE *f;
+    struct sn_entry *e = &sn_entries[st->parg.sn.slot];
     double t;
 
-    if ((f = fopen(st->parg.sn.path, "r")) == NULL)
-        fatal("sensor(%s): cannot access %.200s: %.200s",
-              st->arg, st->parg.sn.path, strerror(errno));
+    if (e->read != sn_gen)
+        sensor_read(e);
+    e->got = sn_gen;
 
-    if (fscanf(f, "%lf", &t) < 0) {
-        warning("sensor(%s): cannot read sensor value",
-                st->arg);
+    if (!e->ok)
         return 0;
-    }
-
-    if (fclose(f) < 0)
-        warning("sensor(%s): cannot close '%.200s'",
-                st->arg, st->parg.sn.path);
 
+    t = e->value;
     switch (st->parg.sn.type) {
     case SENSOR_TEMP:
     case SENSOR_IN:
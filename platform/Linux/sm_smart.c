@@ -28,18 +28,41 @@
  *
  */
 
+/*
+ * Get smart values of ata and nvme drives. Ata drives are asked through
+ * SG_IO ata pass-through, which also reaches drives behind scsi and sas
+ * hbas, or through the legacy HDIO_DRIVE_CMD. Nvme drives return their
+ * smart/health log page, which is mapped onto the ata attributes:
+ *
+ * read_error_rate = 100 - percentage used, reallocated_sectors = available
+ * spare, temperature = composite temperature in degrees celsius,
+ * current_pending = critical warning bits, uncorrectables = media errors.
+ *
+ * Smart commands are slow and can stall a drive; a drive is asked at most
+ * once per SMART_REFRESH seconds and get_smart returns the cached values.
+ */
+
 #include "conf.h"
 
 #include <sys/ioctl.h>
+#include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/hdreg.h>
+#ifdef HAS_NVME_IOCTL
+#include <linux/nvme_ioctl.h>
+#endif
+#ifdef HAS_SG_IO
+#include <scsi/sg.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "data.h"
 #include "diskname.h"
@@ -58,6 +81,13 @@ struct hd_drive_cmd_hdr {
 };
 #endif
 
+#define SMART_HDIO    0
+#define SMART_SGIO    1
+#define SMART_NVME    2
+
+#define SMART_REFRESH 300       /* s between smart commands to a drive */
+#define SMART_RETRY   30        /* s before retrying a failed drive; doubles */
+
 /* Ata command register set for requesting smart values */
 static struct hd_drive_cmd_hdr smart_cmd = {
     WIN_SMART,         /* command code */
@@ -66,24 +96,208 @@ static struct hd_drive_cmd_hdr smart_cmd = {
     1                  /* sector count */
 };
 
-/* Per drive storage structure; the ata cmd is followed by the data buffer
- * that is filled by the ioctl. There can be no room between the two; hence
- * the pragma for byte alignment.
+/* HDIO_DRIVE_CMD wants the ata cmd followed by the data buffer that is
+ * filled by the ioctl. There can be no room between the two; hence the
+ * pragma for byte alignment.
  */
 #pragma pack(1)
-struct smart_device {
+struct smart_hdio {
     struct hd_drive_cmd_hdr cmd;
     struct smart_values data;
+};
+
+/* Start of the nvme smart/health information log page */
+struct smart_nvme {
+    u_int8_t critical_warning;
+    u_int8_t temperature[2];    /* kelvin, little endian */
+    u_int8_t avail_spare;
+    u_int8_t spare_thresh;
+    u_int8_t percent_used;
+    u_int8_t res1[154];
+    u_int8_t media_errors[16];  /* little endian */
+    u_int8_t res2[336];
+};
+#pragma pack()
+
+/* Per drive storage structure */
+struct smart_device {
     char name[MAX_PATH_LEN];
     int fd;
     int type;
-    int failed;
+    int failed;                 /* consecutive failed commands */
+    int valid;                  /* report holds values of the last command */
+    time_t next;                /* monotonic time of the next command */
+    struct smart_report report;
 };
-#pragma pack()
 
 static struct smart_device *smart_devs = NULL;
 static int smart_cur = 0;
 
+int smart_hdio(struct smart_device *);
+int smart_nvme(struct smart_device *);
+void smart_refresh(struct smart_device *, time_t);
+int smart_sgio(struct smart_device *);
+time_t smart_time(void);
+
+time_t
+smart_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+int
+smart_hdio(struct smart_device *sd)
+{
+    struct smart_hdio hd;
+
+    bzero(&hd, sizeof(hd));
+    memcpy(&hd.cmd, &smart_cmd, sizeof(struct hd_drive_cmd_hdr));
+    if (ioctl(sd->fd, HDIO_DRIVE_CMD, &hd) != 0)
+        return 0;
+
+    /* Linux does not allow checking the smart return code using the
+     * HDIO_DRIVE_CMD */
+
+    /* Some drives do not calculate the smart checksum correctly;
+     * additional code that identifies these drives would increase our
+     * footprint and the amount of datajuggling we need to do; we would
+     * rather ignore the checksums.
+     */
+    smart_parse(&hd.data, &sd->report);
+    return 1;
+}
+
+int
+smart_sgio(struct smart_device *sd)
+{
+#ifdef HAS_SG_IO
+    struct smart_values data;
+    unsigned char cdb[16];
+    unsigned char sense[32];
+    struct sg_io_hdr io;
+
+    /* ata pass-through (16), pio data-in of one block */
+    bzero(cdb, sizeof(cdb));
+    cdb[0] = 0x85;
+    cdb[1] = 4 << 1;
+    cdb[2] = 0x0e;              /* from device, length in sector count */
+    cdb[4] = ATA_SMART_READ_VALUES;
+    cdb[6] = 1;
+    cdb[10] = SMART_CYLINDER & 0xff;
+    cdb[12] = SMART_CYLINDER >> 8;
+    cdb[14] = WIN_SMART;
+
+    bzero(&io, sizeof(io));
+    bzero(&data, sizeof(data));
+    io.interface_id = 'S';
+    io.dxfer_direction = SG_DXFER_FROM_DEV;
+    io.cmd_len = sizeof(cdb);
+    io.cmdp = cdb;
+    io.mx_sb_len = sizeof(sense);
+    io.sbp = sense;
+    io.dxfer_len = sizeof(data);
+    io.dxferp = &data;
+    io.timeout = SMART_TIMEOUT;
+
+    if (ioctl(sd->fd, SG_IO, &io) != 0)
+        return 0;
+
+    if ((io.info & SG_INFO_OK_MASK) != SG_INFO_OK) {
+        errno = EIO;
+        return 0;
+    }
+
+    smart_parse(&data, &sd->report);
+    return 1;
+#else
+    errno = ENOTSUP;
+    return 0;
+#endif
+}
+
+int
+smart_nvme(struct smart_device *sd)
+{
+#ifdef HAS_NVME_IOCTL
+    struct nvme_admin_cmd cmd;
+    struct smart_nvme log;
+    u_int64_t errors;
+    int i, status;
+
+    bzero(&cmd, sizeof(cmd));
+    bzero(&log, sizeof(log));
+    cmd.opcode = 0x02;          /* get log page */
+    cmd.nsid = 0xffffffff;
+    cmd.addr = (u_int64_t) (unsigned long) &log;
+    cmd.data_len = sizeof(log);
+    cmd.cdw10 = 0x02 | ((sizeof(log) / 4 - 1) << 16);   /* smart/health */
+    cmd.timeout_ms = SMART_TIMEOUT;
+
+    if ((status = ioctl(sd->fd, NVME_IOCTL_ADMIN_CMD, &cmd)) != 0) {
+        if (status > 0)
+            errno = EIO;
+        return 0;
+    }
+
+    /* counters are 128 bits; anything above 255 does not fit anyway */
+    for (errors = 0, i = 7; i >= 0; i--)
+        errors = (errors << 8) | log.media_errors[i];
+    for (i = 8; i < 16; i++)
+        if (log.media_errors[i])
+            errors = UINT64_MAX;
+
+    bzero(&sd->report, sizeof(struct smart_report));
+    sd->report.read_error_rate = 100 - MIN(log.percent_used, 100);
+    sd->report.reallocated_sectors = log.avail_spare;
+    sd->report.temperature =
+        MAX(0, (log.temperature[0] | (log.temperature[1] << 8)) - 273);
+    sd->report.current_pending = log.critical_warning;
+    sd->report.uncorrectables = MIN(errors, 255);
+    return 1;
+#else
+    errno = ENOTSUP;
+    return 0;
+#endif
+}
+
+/* Run the smart command of a drive; failed drives are retried with backoff */
+void
+smart_refresh(struct smart_device *sd, time_t now)
+{
+    int ok;
+
+    switch (sd->type) {
+    case SMART_NVME:
+        ok = smart_nvme(sd);
+        break;
+    case SMART_SGIO:
+        ok = smart_sgio(sd);
+        break;
+    default:
+        ok = smart_hdio(sd);
+        break;
+    }
+
+    if (ok) {
+        if (sd->failed)
+            info("smart: drive '%.200s' answers again", sd->name);
+        sd->failed = 0;
+        sd->valid = 1;
+        sd->next = now + SMART_REFRESH;
+        return;
+    }
+
+    if (sd->failed == 0)
+        warning("smart: command for drive '%.200s' failed: %.200s",
+                sd->name, strerror(errno));
+    sd->failed++;
+    sd->valid = 0;
+    sd->next = now + MIN(SMART_RETRY << MIN(sd->failed - 1, 4), SMART_REFRESH);
+}
+
 void
 privinit_smart(struct stream *st)
 {
@@ -93,11 +307,13 @@ void
 init_smart(struct stream *st)
 {
     struct disknamectx c;
+    struct smart_device *sd;
     int fd;
     int i;
     char drivename[MAX_PATH_LEN];
 
-    if (sizeof(struct smart_values) != DISK_BLOCK_LEN) {
+    if (sizeof(struct smart_values) != DISK_BLOCK_LEN ||
+        sizeof(struct smart_nvme) != DISK_BLOCK_LEN) {
         fatal("smart: internal error: smart values structure is broken");
     }
 
@@ -117,12 +333,13 @@ init_smart(struct stream *st)
     /* look for drive in our global table */
     for (i = 0; i < smart_cur; i++) {
         if (strncmp(smart_devs[i].name, drivename, sizeof(drivename)) == 0) {
+            close(fd);
             st->parg.smart = i;
             return;
         }
     }
 
-    /* this is a new drive; allocate the command and data block */
+    /* this is a new drive */
     if (smart_cur > SYMON_MAX_DOBJECTS) {
         fatal("%s:%d: dynamic object limit (%d) exceeded for smart data",
               __FILE__,
@@ -133,81 +350,81 @@ init_smart(struct stream *st)
     smart_devs
         = xrealloc(smart_devs, (smart_cur + 1) * sizeof(struct smart_device));
 
-    bzero(&smart_devs[smart_cur], sizeof(struct smart_device));
+    sd = &smart_devs[smart_cur];
+    bzero(sd, sizeof(struct smart_device));
 
     /* store drivename in new block */
-    snprintf(smart_devs[smart_cur].name,
-             sizeof(smart_devs[0].name),
-             "%s",
-             drivename);
+    snprintf(sd->name, sizeof(sd->name), "%s", drivename);
 
     /* store filedescriptor to device */
-    smart_devs[smart_cur].fd = fd;
+    sd->fd = fd;
+
+    /* nvme, else ata pass-through if the drive answers to it, else hdio */
+#ifdef HAS_NVME_IOCTL
+    if (strstr(drivename, "nvme") != NULL || ioctl(fd, NVME_IOCTL_ID) >= 0)
+        sd->type = SMART_NVME;
+#endif
+#ifdef HAS_SG_IO
+    if (sd->type == SMART_HDIO && ioctl(fd, SG_GET_VERSION_NUM, &i) == 0 &&
+        i >= 30000) {
+        sd->type = SMART_SGIO;
+        if (smart_sgio(sd)) {
+            sd->valid = 1;
+            sd->next = smart_time() + SMART_REFRESH;
+        } else {
+            sd->type = SMART_HDIO;
+        }
+    }
+#endif
+    if (!sd->valid)
+        smart_refresh(sd, smart_time());
 
     /* store smart dev entry in stream to facilitate quick get */
     st->parg.smart = smart_cur;
 
     smart_cur++;
 
-    info("started module smart(%.200s = %.200s)",
-         st->arg,
-         smart_devs[st->parg.smart].name);
+    info("started module smart(%.200s = %.200s, %s)",
+         st->arg, sd->name,
+         (sd->type == SMART_NVME) ? "nvme" :
+         (sd->type == SMART_SGIO) ? "sg_io" : "hdio");
 }
 
 void
 gets_smart(void)
 {
+    time_t now = smart_time();
     int i;
 
-    for (i = 0; i < smart_cur; i++) {
-        /* populate ata command header */
-        memcpy(&smart_devs[i].cmd,
-               (void *)&smart_cmd,
-               sizeof(struct hd_drive_cmd_hdr));
-        if (ioctl(smart_devs[i].fd, HDIO_DRIVE_CMD, &smart_devs[i].cmd)) {
-            warning("smart: ioctl for drive '%.200s' failed: %.200s",
-                    &smart_devs[i].name,
-                    strerror(errno));
-            smart_devs[i].failed = 1;
-        }
-
-        /* Linux does not allow checking the smart return code using the
-         * HDIO_DRIVE_CMD */
-
-        /* Some drives do not calculate the smart checksum correctly;
-         * additional code that identifies these drives would increase our
-         * footprint and the amount of datajuggling we need to do; we would
-         * rather ignore the checksums.
-         */
-        smart_devs[i].failed = 0;
-    }
-    return;
+    for (i = 0; i < smart_cur; i++)
+        if (now >= smart_devs[i].next)
+            smart_refresh(&smart_devs[i], now);
 }
 
 int
 get_smart(char *symon_buf, int maxlen, struct stream *st)
 {
-    struct smart_report sr;
+    struct smart_report *sr;
 
     if ((st->parg.smart < smart_cur)
-        && (!smart_devs[st->parg.smart].failed)) {
-        smart_parse(&smart_devs[st->parg.smart].data, &sr);
+        && (smart_devs[st->parg.smart].valid)) {
+        sr = &smart_devs[st->parg.smart].report;
         return snpack(symon_buf,
                       maxlen,
                       st->arg,
                       MT_SMART,
-                      sr.read_error_rate,
-                      sr.reallocated_sectors,
-                      sr.spin_retries,
-                      sr.air_flow_temp,
-                      sr.temperature,
-                      sr.reallocations,
-                      sr.current_pending,
-                      sr.uncorrectables,
-                      sr.soft_read_error_rate,
-                      sr.g_sense_error_rate,
-                      sr.temperature2,
-                      sr.free_fall_protection);
+                      sr->read_error_rate,
+                      sr->reallocated_sectors,
+                      sr->spin_retries,
+                      sr->air_flow_temp,
+                      sr->temperature,
+                      sr->reallocations,
+                      sr->current_pending,
+                      sr->uncorrectables,
+                      sr->soft_read_error_rate,
+                      sr->g_sense_error_rate,
+                      sr->temperature2,
+                      sr->free_fall_protection);
     }
 
     return 0;
@@ -0,0 +1,453 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get wireguard peer statistics from the kernel over generic netlink and
+ * return them in symon_buf as
+ *
+ * total bytes received : total bytes transmitted : last handshake
+ *
+ * for the peer with a public key on an interface: wg(wg0:<base64 key>) or
+ * wg(wg0-<base64 key>). Each interface with streams is dumped once per
+ * measurement; the peers of the dump are sorted by key, so that all streams
+ * are served from it by a binary search.
+ */
+
+#include "conf.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAS_WIREGUARD
+#include <net/if.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/wireguard.h>
+#endif
+
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+#ifdef HAS_WIREGUARD
+/* Globals for this module start with wg_ */
+struct wg_peer {
+    u_int8_t key[WG_KEY_LEN];
+    u_int64_t rxbytes;
+    u_int64_t txbytes;
+    int64_t handshake;
+};
+struct wg_iface {
+    char name[IFNAMSIZ];
+    struct wg_peer *peers;      /* sorted by key after a dump */
+    int npeers;
+    int maxpeers;
+    int ok;                     /* last dump succeeded */
+    int warned;
+};
+static struct wg_iface *wg_ifaces = NULL;
+static int wg_nifaces = 0;
+static int wg_maxifaces = 0;
+static int wg_nl = -1;
+static int wg_family = 0;
+static u_int32_t wg_seq = 0;
+static char *wg_buf = NULL;
+static int wg_bufsize = 0;
+static int wg_warned = 0;
+
+int wg_base64(const char *, u_int8_t *);
+int wg_cmp(const void *, const void *);
+int wg_dump(struct wg_iface *);
+int wg_find_family(void);
+void wg_message(struct wg_iface *, struct nlmsghdr *);
+void wg_peer(struct wg_iface *, struct nlattr *);
+int wg_recv(void);
+int wg_request(u_int16_t, u_int16_t, u_int8_t, u_int16_t, const char *);
+
+/* Decode a base64 wireguard key; returns 0 if it is not one */
+int
+wg_base64(const char *s, u_int8_t *key)
+{
+    static const char *alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    u_int32_t acc;
+    char *p;
+    int i, n, bits;
+
+    if (strlen(s) != 44 || s[43] != '=')
+        return 0;
+
+    acc = 0;
+    bits = n = 0;
+    for (i = 0; i < 43; i++) {
+        if ((p = strchr(alphabet, s[i])) == NULL || *p == '\0')
+            return 0;
+        acc = (acc << 6) | (p - alphabet);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            key[n++] = (acc >> bits) & 0xff;
+        }
+    }
+
+    return (n == WG_KEY_LEN);
+}
+int
+wg_cmp(const void *a, const void *b)
+{
+    return memcmp(a, b, WG_KEY_LEN);
+}
+/* Receive one datagram into wg_buf, growing it to fit; returns length */
+int
+wg_recv(void)
+{
+    int len;
+
+    if ((len = recv(wg_nl, wg_buf, wg_bufsize, MSG_PEEK | MSG_TRUNC)) < 0)
+        return -1;
+
+    if (len > wg_bufsize) {
+        wg_bufsize = len;
+        wg_buf = xrealloc(wg_buf, wg_bufsize);
+    }
+
+    return recv(wg_nl, wg_buf, wg_bufsize, 0);
+}
+/* Send a generic netlink request with one string attribute */
+int
+wg_request(u_int16_t family, u_int16_t flags, u_int8_t cmd, u_int16_t type,
+           const char *value)
+{
+    struct {
+        struct nlmsghdr nh;
+        struct genlmsghdr gh;
+        char attr[NLA_HDRLEN + NLA_ALIGN(GENL_NAMSIZ)];
+    } req;
+    struct nlattr *nla;
+
+    bzero(&req, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    req.nh.nlmsg_type = family;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | flags;
+    req.nh.nlmsg_seq = ++wg_seq;
+    req.gh.cmd = cmd;
+    req.gh.version = (family == GENL_ID_CTRL) ? 1 : WG_GENL_VERSION;
+
+    nla = (struct nlattr *) ((char *) &req + NLMSG_ALIGN(req.nh.nlmsg_len));
+    nla->nla_type = type;
+    nla->nla_len = NLA_HDRLEN + strlen(value) + 1;
+    snprintf((char *) nla + NLA_HDRLEN, GENL_NAMSIZ, "%s", value);
+    req.nh.nlmsg_len = NLMSG_ALIGN(req.nh.nlmsg_len) + NLA_ALIGN(nla->nla_len);
+
+    return send(wg_nl, &req, req.nh.nlmsg_len, 0);
+}
+/* Look up the id of the wireguard family; 0 if it is not there */
+int
+wg_find_family(void)
+{
+    struct nlmsghdr *nh;
+    struct nlmsgerr *err;
+    struct nlattr *nla;
+    int len, alen;
+
+    if (wg_request(GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+                   WG_GENL_NAME) < 0)
+        return 0;
+
+    while ((len = wg_recv()) > 0) {
+        for (nh = (struct nlmsghdr *) wg_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != wg_seq)
+                continue;
+
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                err = NLMSG_DATA(nh);
+                errno = -err->error;
+                return 0;
+            }
+
+            alen = nh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+            nla = (struct nlattr *) ((char *) NLMSG_DATA(nh) + GENL_HDRLEN);
+            while (alen >= NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN &&
+                   nla->nla_len <= alen) {
+                if ((nla->nla_type & NLA_TYPE_MASK) == CTRL_ATTR_FAMILY_ID)
+                    return *(u_int16_t *) ((char *) nla + NLA_HDRLEN);
+                alen -= NLA_ALIGN(nla->nla_len);
+                nla = (struct nlattr *) ((char *) nla + NLA_ALIGN(nla->nla_len));
+            }
+            return 0;
+        }
+    }
+
+    return 0;
+}
+/* Add a nested peer to the dump of an interface */
+void
+wg_peer(struct wg_iface *w, struct nlattr *peer)
+{
+    struct wg_peer *p;
+    struct nlattr *nla;
+    char *data;
+    int alen, key;
+
+    if (w->npeers == w->maxpeers) {
+        w->maxpeers = (w->maxpeers == 0) ? 16 : w->maxpeers * 2;
+        w->peers = xrealloc(w->peers, w->maxpeers * sizeof(struct wg_peer));
+    }
+    p = &w->peers[w->npeers];
+    bzero(p, sizeof(struct wg_peer));
+
+    key = 0;
+    alen = peer->nla_len - NLA_HDRLEN;
+    nla = (struct nlattr *) ((char *) peer + NLA_HDRLEN);
+    while (alen >= NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN && nla->nla_len <= alen) {
+        data = (char *) nla + NLA_HDRLEN;
+        switch (nla->nla_type & NLA_TYPE_MASK) {
+        case WGPEER_A_PUBLIC_KEY:
+            if (nla->nla_len == NLA_HDRLEN + WG_KEY_LEN) {
+                memcpy(p->key, data, WG_KEY_LEN);
+                key = 1;
+            }
+            break;
+        case WGPEER_A_RX_BYTES:
+            memcpy(&p->rxbytes, data, sizeof(u_int64_t));
+            break;
+        case WGPEER_A_TX_BYTES:
+            memcpy(&p->txbytes, data, sizeof(u_int64_t));
+            break;
+        case WGPEER_A_LAST_HANDSHAKE_TIME:
+            memcpy(&p->handshake, data, sizeof(int64_t));
+            break;
+        }
+        alen -= NLA_ALIGN(nla->nla_len);
+        nla = (struct nlattr *) ((char *) nla + NLA_ALIGN(nla->nla_len));
+    }
+
+    /* peers that continue in a next message only repeat their key */
+    if (!key)
+        return;
+    if (w->npeers > 0 && memcmp(w->peers[w->npeers - 1].key, p->key, WG_KEY_LEN) == 0)
+        return;
+
+    w->npeers++;
+}
+/* One message of a device dump; large devices take several */
+void
+wg_message(struct wg_iface *w, struct nlmsghdr *nh)
+{
+    struct nlattr *nla, *peer;
+    int alen, plen;
+
+    alen = nh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+    nla = (struct nlattr *) ((char *) NLMSG_DATA(nh) + GENL_HDRLEN);
+    while (alen >= NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN && nla->nla_len <= alen) {
+        if ((nla->nla_type & NLA_TYPE_MASK) == WGDEVICE_A_PEERS) {
+            plen = nla->nla_len - NLA_HDRLEN;
+            peer = (struct nlattr *) ((char *) nla + NLA_HDRLEN);
+            while (plen >= NLA_HDRLEN && peer->nla_len >= NLA_HDRLEN &&
+                   peer->nla_len <= plen) {
+                wg_peer(w, peer);
+                plen -= NLA_ALIGN(peer->nla_len);
+                peer = (struct nlattr *) ((char *) peer + NLA_ALIGN(peer->nla_len));
+            }
+        }
+        alen -= NLA_ALIGN(nla->nla_len);
+        nla = (struct nlattr *) ((char *) nla + NLA_ALIGN(nla->nla_len));
+    }
+}
+/* Dump all peers of an interface; returns 0 on errors */
+int
+wg_dump(struct wg_iface *w)
+{
+    struct nlmsghdr *nh;
+    struct nlmsgerr *err;
+    int len;
+
+    w->npeers = 0;
+
+    if (wg_request(wg_family, NLM_F_DUMP, WG_CMD_GET_DEVICE, WGDEVICE_A_IFNAME,
+                   w->name) < 0)
+        return 0;
+
+    while ((len = wg_recv()) > 0) {
+        for (nh = (struct nlmsghdr *) wg_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != wg_seq)
+                continue;
+
+            switch (nh->nlmsg_type) {
+            case NLMSG_DONE:
+                qsort(w->peers, w->npeers, sizeof(struct wg_peer), wg_cmp);
+                return 1;
+            case NLMSG_ERROR:
+                err = NLMSG_DATA(nh);
+                errno = -err->error;
+                return 0;
+            default:
+                wg_message(w, nh);
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+void
+init_wg(struct stream *st)
+{
+    char name[IFNAMSIZ];
+    char *p;
+    int i;
+
+    st->parg.wg.iface = -1;
+
+    /* interface:key, or else interface-key */
+    if ((p = strchr(st->arg, ':')) == NULL && (p = strrchr(st->arg, '-')) == NULL)
+        fatal("wg(%.200s): expected interface:key", st->arg);
+
+    if (p == st->arg || p - st->arg >= IFNAMSIZ)
+        fatal("wg(%.200s): bad interface name", st->arg);
+    snprintf(name, sizeof(name), "%.*s", (int) (p - st->arg), st->arg);
+
+    if (!wg_base64(p + 1, st->parg.wg.key))
+        fatal("wg(%.200s): '%.200s' is not a base64 public key", st->arg, p + 1);
+
+    /* the kernel only shows peers to CAP_NET_ADMIN */
+    if (geteuid() != 0) {
+        warning("wg(%.200s) requires symon to run as the superuser, use -u",
+                st->arg);
+        return;
+    }
+
+    if (wg_nl < 0) {
+        if ((wg_nl = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC)) < 0)
+            fatal("wg: cannot open generic netlink: %.200s", strerror(errno));
+        wg_bufsize = SYMON_MAX_OBJSIZE;
+        wg_buf = xmalloc(wg_bufsize);
+    }
+
+    for (i = 0; i < wg_nifaces; i++)
+        if (strcmp(wg_ifaces[i].name, name) == 0)
+            break;
+
+    if (i == wg_nifaces) {
+        if (wg_nifaces == wg_maxifaces) {
+            wg_maxifaces = (wg_maxifaces == 0) ? 2 : wg_maxifaces * 2;
+            wg_ifaces = xrealloc(wg_ifaces, wg_maxifaces * sizeof(struct wg_iface));
+        }
+        bzero(&wg_ifaces[i], sizeof(struct wg_iface));
+        snprintf(wg_ifaces[i].name, sizeof(wg_ifaces[i].name), "%s", name);
+        wg_nifaces++;
+    }
+    st->parg.wg.iface = i;
+
+    info("started module wg(%.200s)", st->arg);
+}
+void
+gets_wg(void)
+{
+    struct wg_iface *w;
+    int i;
+
+    if (wg_nifaces == 0)
+        return;
+
+    /* the family comes with the wireguard module */
+    if (wg_family == 0 && (wg_family = wg_find_family()) == 0) {
+        if (!wg_warned)
+            warning("wg: no wireguard generic netlink family: %.200s",
+                    strerror(errno));
+        wg_warned = 1;
+        for (i = 0; i < wg_nifaces; i++)
+            wg_ifaces[i].ok = 0;
+        return;
+    }
+    wg_warned = 0;
+
+    for (i = 0; i < wg_nifaces; i++) {
+        w = &wg_ifaces[i];
+        if ((w->ok = wg_dump(w)))
+            w->warned = 0;
+        else if (!w->warned) {
+            warning("wg: cannot get device %.200s: %.200s", w->name, strerror(errno));
+            w->warned = 1;
+        }
+
+        /* the module may have been reloaded */
+        if (!w->ok && errno == EOPNOTSUPP)
+            wg_family = 0;
+    }
+}
+int
+get_wg(char *symon_buf, int maxlen, struct stream *st)
+{
+    struct wg_iface *w;
+    struct wg_peer *p;
+
+    if (st->parg.wg.iface < 0)
+        return 0;
+
+    w = &wg_ifaces[st->parg.wg.iface];
+    if (!w->ok)
+        return 0;
+
+    if ((p = bsearch(st->parg.wg.key, w->peers, w->npeers,
+                     sizeof(struct wg_peer), wg_cmp)) == NULL) {
+        debug("wg(%.200s): no such peer on %.200s", st->arg, w->name);
+        return 0;
+    }
+
+    return snpack(symon_buf, maxlen, st->arg, MT_WG,
+                  p->rxbytes, p->txbytes, (u_int32_t) p->handshake);
+}
+#else
+void
+init_wg(struct stream *st)
+{
+    fatal("wg module not available");
+}
+void
+gets_wg(void)
+{
+    fatal("wg module not available");
+}
+int
+get_wg(char *symon_buf, int maxlen, struct stream *st)
+{
+    fatal("wg module not available");
+
+    /* NOT REACHED */
+    return 0;
+}
+#endif
@@ -13,3 +13,8 @@ if grep -q HW_IOSTATS /usr/include/sys/sysctl.h; then
 else
     echo "#undef HAS_HW_IOSTATS"
 fi
+if grep -q "sendmmsg" /usr/include/sys/socket.h; then
+    echo "#define HAS_SENDMMSG	1"
+else
+    echo "#undef HAS_SENDMMSG"
+fi
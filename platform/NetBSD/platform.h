@@ -34,6 +34,14 @@ union stream_parg {
     struct ifdatareq ifr;
     int sn;
     int smart;
+    struct {
+        int slot;                     /* loaded plugin */
+        void *state;                  /* of the plugin for this stream */
+    } pl;
+    struct {
+        int slot;                     /* collector of the stream */
+        int seq;                      /* last sample sent */
+    } exec;
 };
 
 #endif
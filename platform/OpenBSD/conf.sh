@@ -1,2 +1,7 @@
 echo "#define HAS_UNVEIL	1"
 echo "#define HAS_PLEDGE	1"
+if grep -q "sendmmsg" /usr/include/sys/socket.h; then
+    echo "#define HAS_SENDMMSG	1"
+else
+    echo "#undef HAS_SENDMMSG"
+fi
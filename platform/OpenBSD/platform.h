@@ -39,6 +39,14 @@ union stream_parg {
         int mib[5];
     } sn;
     int smart;
+    struct {
+        int slot;                     /* loaded plugin */
+        void *state;                  /* of the plugin for this stream */
+    } pl;
+    struct {
+        int slot;                     /* collector of the stream */
+        int seq;                      /* last sample sent */
+    } exec;
     struct {
 	char full[IFNAMSIZ + 1 + SYMON_WGPEERDESC];
 	char *peerdesc;
@@ -140,6 +140,12 @@ init_sensor(struct stream *st)
     info("started module sensor(%.200s)", st->arg);
 }
 
+void
+gets_sensor(void)
+{
+    /* EMPTY */
+}
+
 int
 get_sensor(char *symon_buf, int maxlen, struct stream *st)
 {
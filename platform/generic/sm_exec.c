@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get measurements from a long-lived external collector and return them in
+ * symon_buf as
+ *
+ * value0 : ... : value7
+ *
+ * The argument is the command line of the collector. It is started once, as
+ * the symon user, and restarted when it exits. Its stdout is watched by the
+ * event loop; each measurement sends the last sample that arrived since the
+ * previous one. A sample is either a text line of up to 8 numbers separated
+ * by white space, or a binary frame of a NUL byte, a count byte of up to 8
+ * and that many big endian IEEE 754 doubles.
+ *
+ * symon is chrooted after its privileged init, so collectors are run by a
+ * small supervisor process that is forked before that.
+ */
+
+#include "conf.h"
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+#define EXEC_MAXVALUES 8
+#define EXEC_MAXARGS   16
+#define EXEC_BUFSIZE   4096
+#define EXEC_MAXDELAY  60       /* seconds between restarts of a failing collector */
+
+/* Globals for this module start with ex_ */
+struct ex_collector {
+    char *cmd;
+    int watched;
+    int fd;                     /* stdout of the collector */
+    int ctl;                    /* closed when symon exits */
+    int warned;
+    int seq;                    /* samples received */
+    int nvalues;
+    double value[EXEC_MAXVALUES];
+    int len;
+    char buf[EXEC_BUFSIZE];
+};
+static struct ex_collector *ex_collectors = NULL;
+static int ex_ncollectors = 0;
+static int ex_maxcollectors = 0;
+
+/* the event loop reads while probes get */
+static pthread_mutex_t ex_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void exec_event(int, void *);
+int exec_frame(struct ex_collector *, char *, int);
+void exec_line(struct ex_collector *, char *);
+void exec_parse(struct ex_collector *);
+void exec_run(char *, int, int);
+
+/* Supervise a collector until symon goes away; never returns */
+void
+exec_run(char *cmd, int out, int ctl)
+{
+    char *argv[EXEC_MAXARGS + 1];
+    struct pollfd pfd;
+    struct passwd *pw;
+    sigset_t none;
+    time_t started;
+    pid_t pid;
+    int argc, delay, status;
+    char *p;
+
+    /* run as the symon user, without its chroot */
+    if (!flag_unsecure) {
+        if ((pw = getpwnam(SYMON_USER)) == NULL)
+            fatal("exec(%.200s): no user '%.200s'", cmd, SYMON_USER);
+        if (setgroups(1, &pw->pw_gid) || setgid(pw->pw_gid) ||
+            setuid(pw->pw_uid))
+            fatal("exec(%.200s): can't drop privileges: %.200s",
+                  cmd, strerror(errno));
+    }
+
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    signal(SIGPIPE, SIG_DFL);
+
+    argc = 0;
+    for (p = strtok(cmd, " \t"); p != NULL && argc < EXEC_MAXARGS;
+         p = strtok(NULL, " \t"))
+        argv[argc++] = p;
+    argv[argc] = NULL;
+
+    delay = 1;
+    for (;;) {
+        started = time(NULL);
+        if ((pid = fork()) < 0)
+            fatal("exec(%.200s): cannot fork: %.200s", argv[0], strerror(errno));
+
+        if (pid == 0) {
+            close(ctl);
+            if (dup2(out, STDOUT_FILENO) < 0)
+                _exit(127);
+            close(out);
+            execv(argv[0], argv);
+            _exit(127);
+        }
+
+        /* symon closing ctl ends us and the collector */
+        pfd.fd = ctl;
+        pfd.events = POLLIN;
+        for (;;) {
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 1000) > 0) {
+                kill(pid, SIGTERM);
+                waitpid(pid, NULL, 0);
+                _exit(0);
+            }
+            if (waitpid(pid, &status, WNOHANG) == pid)
+                break;
+        }
+
+        if (time(NULL) - started > EXEC_MAXDELAY)
+            delay = 1;
+        warning("exec(%.200s): collector exited with status %d; restarting in %d s",
+                argv[0], WIFEXITED(status) ? WEXITSTATUS(status) : -1, delay);
+
+        pfd.revents = 0;
+        if (poll(&pfd, 1, delay * 1000) > 0)
+            _exit(0);
+        delay = MIN(delay * 2, EXEC_MAXDELAY);
+    }
+}
+/* Start the supervisor of a collector while we can still reach it */
+void
+privinit_exec(struct stream *st)
+{
+    struct ex_collector *c;
+    int out[2], ctl[2];
+    pid_t pid;
+    int i;
+
+    if (st->arg == NULL || st->arg[0] != '/')
+        fatal("exec(%.200s): needs the absolute path of a collector", st->arg);
+
+    for (i = 0; i < ex_ncollectors; i++)
+        if (strcmp(ex_collectors[i].cmd, st->arg) == 0)
+            return;
+
+    if (ex_ncollectors == ex_maxcollectors) {
+        ex_maxcollectors = (ex_maxcollectors == 0) ? 4 : ex_maxcollectors * 2;
+        ex_collectors = xrealloc(ex_collectors,
+                                 ex_maxcollectors * sizeof(struct ex_collector));
+    }
+    c = &ex_collectors[ex_ncollectors];
+    bzero(c, sizeof(struct ex_collector));
+    c->cmd = xstrdup(st->arg);
+
+    if (pipe(out) < 0 || pipe(ctl) < 0)
+        fatal("exec(%.200s): cannot create pipe: %.200s", st->arg, strerror(errno));
+
+    if ((pid = fork()) < 0)
+        fatal("exec(%.200s): cannot fork: %.200s", st->arg, strerror(errno));
+
+    if (pid == 0) {
+        close(out[0]);
+        close(ctl[1]);
+        exec_run(xstrdup(st->arg), out[1], ctl[0]);
+    }
+
+    close(out[1]);
+    close(ctl[0]);
+    c->fd = out[0];
+    c->ctl = ctl[1];
+    fcntl(c->fd, F_SETFL, O_NONBLOCK);
+    fcntl(c->fd, F_SETFD, FD_CLOEXEC);
+    fcntl(c->ctl, F_SETFD, FD_CLOEXEC);
+
+    ex_ncollectors++;
+}
+void
+init_exec(struct stream *st)
+{
+    int i;
+
+    for (i = 0; i < ex_ncollectors; i++)
+        if (strcmp(ex_collectors[i].cmd, st->arg) == 0)
+            break;
+
+    /* collectors of a new configuration need a restart of symon */
+    if (i == ex_ncollectors) {
+        warning("exec(%.200s): collector not started; restart symon", st->arg);
+        st->parg.exec.slot = -1;
+        return;
+    }
+
+    if (!ex_collectors[i].watched) {
+        event_watch(ex_collectors[i].fd, exec_event, &ex_collectors[i]);
+        ex_collectors[i].watched = 1;
+    }
+    st->parg.exec.slot = i;
+    st->parg.exec.seq = ex_collectors[i].seq;
+
+    info("started module exec(%.200s)", st->arg);
+}
+/* A text line of numbers */
+void
+exec_line(struct ex_collector *c, char *line)
+{
+    double value[EXEC_MAXVALUES];
+    char *p, *end;
+    int n;
+
+    for (n = 0, p = line; n < EXEC_MAXVALUES; n++, p = end) {
+        value[n] = strtod(p, &end);
+        if (end == p)
+            break;
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+        p++;
+
+    if (n == 0 || *p != '\0') {
+        if (!c->warned)
+            warning("exec(%.200s): cannot parse '%.200s'", c->cmd, line);
+        c->warned = 1;
+        return;
+    }
+
+    bcopy(value, c->value, n * sizeof(double));
+    c->nvalues = n;
+    c->seq++;
+}
+/* A binary frame at buf; returns its length, or 0 when incomplete */
+int
+exec_frame(struct ex_collector *c, char *buf, int len)
+{
+    u_int64_t q;
+    int i, n;
+
+    if (len < 2)
+        return 0;
+
+    n = (unsigned char) buf[1];
+    if (n == 0 || n > EXEC_MAXVALUES) {
+        if (!c->warned)
+            warning("exec(%.200s): bad frame of %d values", c->cmd, n);
+        c->warned = 1;
+        return len;             /* resynchronisation is not possible */
+    }
+    if (len < 2 + n * 8)
+        return 0;
+
+    for (i = 0; i < n; i++) {
+        bcopy(buf + 2 + i * 8, &q, sizeof(q));
+        q = ntohq(q);
+        bcopy(&q, &c->value[i], sizeof(double));
+    }
+    c->nvalues = n;
+    c->seq++;
+
+    return 2 + n * 8;
+}
+/* Take all complete samples from the buffer */
+void
+exec_parse(struct ex_collector *c)
+{
+    char *nl;
+    int p, n;
+
+    p = 0;
+    while (p < c->len) {
+        if (c->buf[p] == '\0') {
+            if ((n = exec_frame(c, c->buf + p, c->len - p)) == 0)
+                break;
+            p += n;
+        } else {
+            if ((nl = memchr(c->buf + p, '\n', c->len - p)) == NULL)
+                break;
+            *nl = '\0';
+            exec_line(c, c->buf + p);
+            p = nl - c->buf + 1;
+        }
+    }
+
+    if (p < c->len)
+        bcopy(c->buf + p, c->buf, c->len - p);
+    c->len -= p;
+
+    /* a full buffer without a sample in it is noise */
+    if (c->len == EXEC_BUFSIZE)
+        c->len = 0;
+}
+void
+exec_event(int fd, void *arg)
+{
+    struct ex_collector *c = arg;
+    int len;
+
+    pthread_mutex_lock(&ex_lock);
+    while ((len = read(fd, c->buf + c->len, EXEC_BUFSIZE - c->len)) > 0) {
+        c->len += len;
+        exec_parse(c);
+    }
+    pthread_mutex_unlock(&ex_lock);
+
+    /* the supervisor is gone */
+    if (len == 0 || (errno != EAGAIN && errno != EINTR)) {
+        warning("exec(%.200s): collector supervisor went away", c->cmd);
+        event_unwatch(fd);
+    }
+}
+int
+get_exec(char *symon_buf, int maxlen, struct stream *st)
+{
+    double v[EXEC_MAXVALUES];
+    struct ex_collector *c;
+
+    if (st->parg.exec.slot < 0)
+        return 0;
+    c = &ex_collectors[st->parg.exec.slot];
+
+    /* only samples that arrived since the previous measurement */
+    pthread_mutex_lock(&ex_lock);
+    if (c->seq == st->parg.exec.seq) {
+        pthread_mutex_unlock(&ex_lock);
+        return 0;
+    }
+    bzero(v, sizeof(v));
+    bcopy(c->value, v, c->nvalues * sizeof(double));
+    st->parg.exec.seq = c->seq;
+    pthread_mutex_unlock(&ex_lock);
+
+    return snpack(symon_buf, maxlen, st->arg, MT_EXEC,
+                  v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+}
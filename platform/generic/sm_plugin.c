@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Get measurements from probe plugins, shared objects that are loaded from
+ * the plugin directory, and return them in symon_buf as
+ *
+ * counter0 : ... : counter7 : gauge0 : ... : gauge7
+ *
+ * The counters and gauges of the format of the plugin fill these in order;
+ * the rest is zero. See symon_plugin.h for the interface.
+ */
+
+#include "conf.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "symon.h"
+#include "symon_plugin.h"
+#include "xmalloc.h"
+
+#define PL_NAMELEN 32
+
+/* Globals for this module start with pl_ */
+struct pl_module {
+    char name[PL_NAMELEN];
+    void *handle;
+    struct symon_plugin *plugin;
+};
+static struct pl_module *pl_modules = NULL;
+static int pl_nmodules = 0;
+static int pl_maxmodules = 0;
+
+int plugin_load(char *);
+char *plugin_name(struct stream *, char *);
+void plugin_trusted(char *);
+
+/* Split the argument into plugin name and argument for the plugin */
+char *
+plugin_name(struct stream *st, char *name)
+{
+    char *arg;
+    int len;
+
+    if ((arg = strchr(st->arg, ':')) != NULL)
+        len = arg++ - st->arg;
+    else {
+        len = strlen(st->arg);
+        arg = "";
+    }
+
+    if (len == 0 || len >= PL_NAMELEN ||
+        strspn(st->arg, "abcdefghijklmnopqrstuvwxyz"
+               "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-") < (size_t) len)
+        fatal("plugin(%.200s): expected a plugin name of letters, digits, _ and -",
+              st->arg);
+
+    snprintf(name, PL_NAMELEN, "%.*s", len, st->arg);
+
+    return arg;
+}
+/* Plugins run as root until privileges are dropped; only root may change them */
+void
+plugin_trusted(char *path)
+{
+    struct stat sb;
+
+    if (stat(path, &sb) < 0)
+        fatal("plugin: cannot access %.200s: %.200s", path, strerror(errno));
+
+    if ((sb.st_uid != 0 && sb.st_uid != getuid()) || (sb.st_mode & (S_IWGRP | S_IWOTH)))
+        fatal("plugin: %.200s can be changed by others than root", path);
+}
+int
+plugin_load(char *name)
+{
+    char path[MAX_PATH_LEN];
+    struct pl_module *m;
+    struct symon_plugin *p;
+    const char *f;
+    int i, nl, nd;
+
+    for (i = 0; i < pl_nmodules; i++)
+        if (strcmp(pl_modules[i].name, name) == 0)
+            return i;
+
+    plugin_trusted(symon_plugindir);
+    snprintf(path, sizeof(path), "%.900s/%s.so", symon_plugindir, name);
+    plugin_trusted(path);
+
+    if (pl_nmodules == pl_maxmodules) {
+        pl_maxmodules = (pl_maxmodules == 0) ? 4 : pl_maxmodules * 2;
+        pl_modules = xrealloc(pl_modules, pl_maxmodules * sizeof(struct pl_module));
+    }
+    m = &pl_modules[pl_nmodules];
+    snprintf(m->name, sizeof(m->name), "%s", name);
+
+    if ((m->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)) == NULL)
+        fatal("plugin(%.200s): %.200s", name, dlerror());
+
+    if ((p = m->plugin = dlsym(m->handle, "symon_plugin")) == NULL)
+        fatal("plugin(%.200s): no symon_plugin in %.200s", name, path);
+
+    if (p->abi != SYMON_PLUGIN_ABI)
+        fatal("plugin(%.200s): interface version %d, expected %d",
+              name, p->abi, SYMON_PLUGIN_ABI);
+
+    if (p->format == NULL || p->init == NULL || p->get == NULL)
+        fatal("plugin(%.200s): needs a format, init and get", name);
+
+    nl = nd = 0;
+    for (f = p->format; *f != '\0'; f++) {
+        if (*f == 'L')
+            nl++;
+        else if (*f == 'D')
+            nd++;
+        else
+            fatal("plugin(%.200s): unknown format letter '%c'; expected L or D",
+                  name, *f);
+    }
+    if (nl > SYMON_PLUGIN_MAXL || nd > SYMON_PLUGIN_MAXD)
+        fatal("plugin(%.200s): format '%.200s' has more than %d counters or %d gauges",
+              name, p->format, SYMON_PLUGIN_MAXL, SYMON_PLUGIN_MAXD);
+
+    info("loaded plugin %.200s", path);
+
+    return pl_nmodules++;
+}
+/* Load the shared object while it can still be reached */
+void
+privinit_plugin(struct stream *st)
+{
+    char name[PL_NAMELEN];
+
+    plugin_name(st, name);
+    plugin_load(name);
+}
+void
+init_plugin(struct stream *st)
+{
+    char name[PL_NAMELEN];
+    char *arg;
+
+    arg = plugin_name(st, name);
+    st->parg.pl.slot = plugin_load(name);
+    st->parg.pl.state = NULL;
+
+    if ((pl_modules[st->parg.pl.slot].plugin->init) (arg, &st->parg.pl.state) != 0)
+        fatal("plugin(%.200s): init failed", st->arg);
+
+    info("started module plugin(%.200s)", st->arg);
+}
+void
+gets_plugin(void)
+{
+    int i;
+
+    for (i = 0; i < pl_nmodules; i++)
+        if (pl_modules[i].plugin->gets != NULL)
+            (pl_modules[i].plugin->gets) ();
+}
+int
+get_plugin(char *symon_buf, int maxlen, struct stream *st)
+{
+    union symon_value values[SYMON_PLUGIN_MAXL + SYMON_PLUGIN_MAXD];
+    u_int64_t l[SYMON_PLUGIN_MAXL];
+    double d[SYMON_PLUGIN_MAXD];
+    struct symon_plugin *p;
+    int i, nl, nd;
+
+    p = pl_modules[st->parg.pl.slot].plugin;
+
+    bzero(values, sizeof(values));
+    if (!(p->get) (st->parg.pl.state, values))
+        return 0;
+
+    bzero(l, sizeof(l));
+    bzero(d, sizeof(d));
+    for (i = nl = nd = 0; p->format[i] != '\0'; i++) {
+        if (p->format[i] == 'L')
+            l[nl++] = values[i].l;
+        else
+            d[nd++] = values[i].d;
+    }
+
+    return snpack(symon_buf, maxlen, st->arg, MT_PLUGIN,
+                  l[0], l[1], l[2], l[3], l[4], l[5], l[6], l[7],
+                  d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7]);
+}
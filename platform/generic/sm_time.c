@@ -25,7 +25,9 @@
 
 #include <sys/types.h>
 
+#ifndef _XOPEN_SOURCE
 #define _XOPEN_SOURCE 600
+#endif
 #include <errno.h>
 #include <string.h>
 #include <time.h>
@@ -0,0 +1,19 @@
+#include <stdlib.h>
+
+#include "sylimits.h"
+#include "data.h"
+#include "error.h"
+
+void
+init_cpuhist(struct stream *st)
+{
+    fatal("cpuhist module not available");
+}
+int
+get_cpuhist(char *symon_buf, int maxlen, struct stream *st)
+{
+    fatal("cpuhist module not available");
+
+    /* NOT REACHED */
+    return 0;
+}
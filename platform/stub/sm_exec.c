@@ -0,0 +1,24 @@
+#include <stdlib.h>
+
+#include "sylimits.h"
+#include "data.h"
+#include "error.h"
+
+void
+privinit_exec(struct stream *st)
+{
+    fatal("exec module not available");
+}
+void
+init_exec(struct stream *st)
+{
+    fatal("exec module not available");
+}
+int
+get_exec(char *symon_buf, int maxlen, struct stream *st)
+{
+    fatal("exec module not available");
+
+    /* NOT REACHED */
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdlib.h>
+
+#include "sylimits.h"
+#include "data.h"
+#include "error.h"
+
+void
+privinit_plugin(struct stream *st)
+{
+    fatal("plugin module not available");
+}
+void
+init_plugin(struct stream *st)
+{
+    fatal("plugin module not available");
+}
+void
+gets_plugin(void)
+{
+    fatal("plugin module not available");
+}
+int
+get_plugin(char *symon_buf, int maxlen, struct stream *st)
+{
+    fatal("plugin module not available");
+
+    /* NOT REACHED */
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include <stdlib.h>
+
+#include "sylimits.h"
+#include "data.h"
+#include "error.h"
+
+void
+privinit_pressure(struct stream *st)
+{
+    fatal("pressure module not available");
+}
+void
+init_pressure(struct stream *st)
+{
+    fatal("pressure module not available");
+}
+void
+gets_pressure(void)
+{
+    fatal("pressure module not available");
+}
+int
+get_pressure(char *symon_buf, int maxlen, struct stream *st)
+{
+    fatal("pressure module not available");
+
+    /* NOT REACHED */
+    return 0;
+}
@@ -14,6 +14,11 @@ init_sensor(struct stream *st)
 {
     fatal("sensor module not available");
 }
+void
+gets_sensor(void)
+{
+    fatal("sensor module not available");
+}
 
 int
 get_sensor(char *symon_buf, int maxlen, struct stream *st)
@@ -0,0 +1,45 @@
+/* Regression test for the cgroup statistics parser
+ *
+ * Feed io.stat, cpu.stat and memory.stat contents through cgroup_keys and
+ * check that every value ends up in its slot.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "../../platform/Linux/sm_cgroup.c"
+
+/* symon.c */
+time_t now;
+
+int main(int argc, char **argv)
+{
+    static char *io_keys[] = { "rbytes", "wbytes", "rios", "wios" };
+    static char *mem_keys[] = { "anon", "file" };
+    static char *cpu_keys[] = { "usage_usec", "user_usec", "system_usec" };
+    char io[] =
+        "8:0 rbytes=1000 wbytes=2000 rios=11 wios=22 dbytes=0 dios=0\n"
+        "8:16 rbytes=100 wbytes=200 rios=22 wios=22 dbytes=5 dios=1\n";
+    char mem[] = "anon 4096\nfile 8192\nkernel 12\nanon_thp 0\nfile_mapped 7\n";
+    char cpu[] = "usage_usec 300\nuser_usec 200\nsystem_usec 100\nnr_periods 0\n";
+    u_int64_t v[4];
+
+    bzero(v, sizeof(v));
+    cgroup_keys(io, io_keys, v, 4);
+    assert(v[0] == 1100);
+    assert(v[1] == 2200);
+    assert(v[2] == 33);
+    assert(v[3] == 44);
+
+    bzero(v, sizeof(v));
+    cgroup_keys(mem, mem_keys, v, 2);
+    assert(v[0] == 4096);
+    assert(v[1] == 8192);
+
+    bzero(v, sizeof(v));
+    cgroup_keys(cpu, cpu_keys, v, 3);
+    assert(v[0] == 300);
+    assert(v[1] == 200);
+    assert(v[2] == 100);
+
+    return 0;
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Aggregated streams sample a cpu, interface or disk several times per
+ * interval through the regular probe of that resource. The rates seen between
+ * samples are kept until the end of the interval, when min, max, average and
+ * 99th percentile are sent. Bursts that are shorter than the interval thus
+ * remain visible without sending more packets.
+ */
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "conf.h"
+#include "data.h"
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+int aggregate_cmp(const void *, const void *);
+int aggregate_fields(int);
+void aggregate_push(struct aggregate *, int, double *);
+void aggregate_stats(struct aggregate *, int, double *);
+
+/* Stream type that is sampled for an aggregated stream */
+int
+aggregate_base(int type)
+{
+    switch (type) {
+    case MT_CPUAGG:
+        return MT_CPU;
+    case MT_IFAGG:
+        return MT_IF2;
+    case MT_IOAGG:
+        return MT_IO2;
+    default:
+        fatal("%s:%d: internal error: type (%d) is not aggregated",
+              __FILE__, __LINE__, type);
+    }
+
+    return MT_EOT;                /* NOTREACHED */
+}
+int
+aggregate_fields(int type)
+{
+    return (type == MT_CPUAGG) ? 1 : SYMON_AGGFIELDS;
+}
+int
+aggregate_cmp(const void *a, const void *b)
+{
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+
+    return (da > db) - (da < db);
+}
+void
+aggregate_push(struct aggregate * agg, int nfields, double *v)
+{
+    int i;
+
+    if (agg->count == agg->size) {
+        agg->size = (agg->size == 0) ? 16 : agg->size * 2;
+        for (i = 0; i < nfields; i++)
+            agg->samples[i] = xrealloc(agg->samples[i], agg->size * sizeof(double));
+    }
+
+    for (i = 0; i < nfields; i++)
+        agg->samples[i][agg->count] = v[i];
+    agg->count++;
+}
+/* min, max, avg and p99 of a field; sorts the samples of that field */
+void
+aggregate_stats(struct aggregate * agg, int field, double *stats)
+{
+    double *s = agg->samples[field];
+    double sum;
+    int i, n;
+
+    n = agg->count;
+    qsort(s, n, sizeof(double), aggregate_cmp);
+
+    sum = 0;
+    for (i = 0; i < n; i++)
+        sum += s[i];
+
+    stats[0] = s[0];
+    stats[1] = s[n - 1];
+    stats[2] = sum / n;
+    stats[3] = s[(99 * n + 99) / 100 - 1];
+}
+void
+init_aggregate(struct stream * st)
+{
+    int base = aggregate_base(st->type);
+
+    (streamfunc[base].init) (st);
+
+    st->agg->count = 0;
+    st->agg->primed = 0;
+
+    info("started module %.200s(%.200s) at %d ms resolution",
+         type2str(st->type), st->arg, st->agg->resolution);
+}
+/* Take one sample of the base stream; the caller has done its gets */
+void
+sample_aggregate(struct stream * st)
+{
+    struct aggregate *agg = st->agg;
+    char buf[sizeof(struct packedstream)];
+    struct packedstream ps;
+    struct timeval tv, dt;
+    u_int64_t c[SYMON_AGGFIELDS];
+    double v[SYMON_AGGFIELDS];
+    double secs;
+    int base, i;
+
+    /* snpack relies on a zeroed buffer to terminate the argument */
+    bzero(buf, sizeof(buf));
+
+    base = aggregate_base(st->type);
+    if ((streamfunc[base].get) (buf, sizeof(buf), st) == 0)
+        return;
+
+    if (sunpack2(buf, &ps) <= 0)
+        return;
+
+    gettimeofday(&tv, NULL);
+
+    /* cpu percentages already cover the time since the previous sample */
+    switch (ps.type) {
+    case MT_CPU:
+        v[0] = 100.0 - ps.data.ps_cpu.midle / 100.0;
+        aggregate_push(agg, 1, v);
+        return;
+    case MT_CPUIOW:
+        v[0] = 100.0 - ps.data.ps_cpuiow.midle / 100.0;
+        aggregate_push(agg, 1, v);
+        return;
+    case MT_IF1:
+        c[0] = ps.data.ps_if1.mibytes;
+        c[1] = ps.data.ps_if1.mobytes;
+        c[2] = ps.data.ps_if1.mipackets;
+        c[3] = ps.data.ps_if1.mopackets;
+        break;
+    case MT_IF2:
+        c[0] = ps.data.ps_if2.mibytes;
+        c[1] = ps.data.ps_if2.mobytes;
+        c[2] = ps.data.ps_if2.mipackets;
+        c[3] = ps.data.ps_if2.mopackets;
+        break;
+    case MT_IO1:
+        c[0] = ps.data.ps_io1.mtotal_bytes;
+        c[1] = 0;
+        c[2] = ps.data.ps_io1.mtotal_transfers;
+        c[3] = 0;
+        break;
+    case MT_IO2:
+        c[0] = ps.data.ps_io2.mtotal_rbytes;
+        c[1] = ps.data.ps_io2.mtotal_wbytes;
+        c[2] = ps.data.ps_io2.mtotal_rtransfers;
+        c[3] = ps.data.ps_io2.mtotal_wtransfers;
+        break;
+    default:
+        warning("%.200s(%.200s): cannot aggregate stream type %d",
+                type2str(st->type), st->arg, ps.type);
+        return;
+    }
+
+    /* counters are turned into rates per second */
+    if (agg->primed) {
+        timersub(&tv, &agg->prevtime, &dt);
+        secs = dt.tv_sec + dt.tv_usec / 1000000.0;
+
+        for (i = 0; i < SYMON_AGGFIELDS; i++)
+            if (c[i] < agg->prev[i])
+                break;
+
+        /* skip samples across counter resets */
+        if (secs > 0 && i == SYMON_AGGFIELDS) {
+            for (i = 0; i < SYMON_AGGFIELDS; i++)
+                v[i] = (c[i] - agg->prev[i]) / secs;
+            aggregate_push(agg, SYMON_AGGFIELDS, v);
+        }
+    }
+
+    bcopy(c, agg->prev, sizeof(agg->prev));
+    agg->prevtime = tv;
+    agg->primed = 1;
+}
+/* Report the samples of the interval and start a new one */
+int
+get_aggregate(char *symon_buf, int maxlen, struct stream * st)
+{
+    struct aggregate *agg = st->agg;
+    double s[SYMON_AGGFIELDS][4];
+    int i;
+
+    if (agg->count == 0)
+        return 0;
+
+    for (i = 0; i < aggregate_fields(st->type); i++)
+        aggregate_stats(agg, i, s[i]);
+    agg->count = 0;
+
+    if (st->type == MT_CPUAGG)
+        return snpack(symon_buf, maxlen, st->arg, MT_CPUAGG,
+                      s[0][0], s[0][1], s[0][2], s[0][3]);
+
+    return snpack(symon_buf, maxlen, st->arg, st->type,
+                  (u_int64_t) s[0][0], (u_int64_t) s[0][1],
+                  (u_int64_t) s[0][2], (u_int64_t) s[0][3],
+                  (u_int64_t) s[1][0], (u_int64_t) s[1][1],
+                  (u_int64_t) s[1][2], (u_int64_t) s[1][3],
+                  (u_int64_t) s[2][0], (u_int64_t) s[2][1],
+                  (u_int64_t) s[2][2], (u_int64_t) s[2][3],
+                  (u_int64_t) s[3][0], (u_int64_t) s[3][1],
+                  (u_int64_t) s[3][2], (u_int64_t) s[3][3]);
+}
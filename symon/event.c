@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Event loop of the main thread. It waits for the deadline of the next
+ * measurement while handling signals and streaming inputs: modules that are
+ * fed by a device rather than asked, like a serial meter, watch their fd and
+ * consume data as it arrives. Callbacks and signal handlers run on the main
+ * thread, outside of signal context.
+ *
+ * Linux uses epoll with a timerfd for the deadline and a signalfd for
+ * signals; other platforms use poll and plain signal handlers.
+ */
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "conf.h"
+
+#ifdef HAS_EPOLL
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#include "data.h"
+#include "error.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+#define EV_MAXEVENTS 16
+#define EV_MAXSIGNALS 32
+
+struct ev_watch {
+    int fd;
+    int urgent;                 /* wait for POLLPRI instead of POLLIN */
+    void (*cb) (int, void *);   /* NULL once unwatched */
+    void *arg;
+};
+
+struct ev_watch *ev_add(int, int, void (*) (int, void *), void *);
+void ev_collect(void);
+void ev_end(struct timespec *, struct timeval *);
+
+static struct ev_watch **ev_watches = NULL;
+static int ev_nwatches = 0;
+static int ev_maxwatches = 0;
+static int ev_done = 0;
+
+#ifdef HAS_EPOLL
+void ev_epoll_add(int, int, void (*) (int, void *), void *);
+void ev_signal(int, void *);
+void ev_timer(int, void *);
+
+static void (*ev_handlers[EV_MAXSIGNALS]) (int);
+static int ev_fd = -1;
+static struct ev_watch ev_timerwatch = { -1, 0, ev_timer, NULL };
+static struct ev_watch ev_signalwatch = { -1, 0, ev_signal, NULL };
+static sigset_t ev_sigset;
+#endif
+
+/* Monotonic time at which the wall clock deadline passes */
+void
+ev_end(struct timespec *ts, struct timeval *deadline)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    if (timercmp(&tv, deadline, <))
+        timersub(deadline, &tv, &tv);
+    else
+        timerclear(&tv);
+
+    if (clock_gettime(CLOCK_MONOTONIC, ts) != 0)
+        fatal("cannot read monotonic clock: %.200s", strerror(errno));
+
+    ts->tv_sec += tv.tv_sec;
+    ts->tv_nsec += tv.tv_usec * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+struct ev_watch *
+ev_add(int fd, int urgent, void (*cb) (int, void *), void *arg)
+{
+    struct ev_watch *w;
+
+    if (ev_nwatches == ev_maxwatches) {
+        ev_maxwatches = (ev_maxwatches == 0) ? 4 : ev_maxwatches * 2;
+        ev_watches = xrealloc(ev_watches, ev_maxwatches * sizeof(struct ev_watch *));
+    }
+
+    w = xmalloc(sizeof(struct ev_watch));
+    w->fd = fd;
+    w->urgent = urgent;
+    w->cb = cb;
+    w->arg = arg;
+    ev_watches[ev_nwatches++] = w;
+
+    return w;
+}
+/* Free watches that were dropped; callbacks may unwatch while dispatching */
+void
+ev_collect(void)
+{
+    int i, j;
+
+    for (i = j = 0; i < ev_nwatches; i++) {
+        if (ev_watches[i]->cb == NULL)
+            xfree(ev_watches[i]);
+        else
+            ev_watches[j++] = ev_watches[i];
+    }
+    ev_nwatches = j;
+}
+/* End the current wait once the callback that calls this returns */
+void
+event_wake(void)
+{
+    ev_done = 1;
+}
+#ifdef HAS_EPOLL
+void
+ev_timer(int fd, void *arg)
+{
+    u_int64_t expirations;
+
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        fatal("cannot read timerfd: %.200s", strerror(errno));
+    ev_done = 1;
+}
+void
+ev_signal(int fd, void *arg)
+{
+    struct signalfd_siginfo si;
+
+    while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+        if (si.ssi_signo < EV_MAXSIGNALS && ev_handlers[si.ssi_signo] != NULL)
+            (ev_handlers[si.ssi_signo]) (si.ssi_signo);
+        ev_done = 1;
+    }
+}
+void
+event_init(void)
+{
+    struct epoll_event ev;
+
+    if (ev_fd >= 0)
+        return;
+
+    if ((ev_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        fatal("cannot create epoll instance: %.200s", strerror(errno));
+
+    if ((ev_timerwatch.fd = timerfd_create(CLOCK_MONOTONIC,
+                                           TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+        fatal("cannot create timerfd: %.200s", strerror(errno));
+
+    sigemptyset(&ev_sigset);
+    if ((ev_signalwatch.fd = signalfd(-1, &ev_sigset,
+                                      SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+        fatal("cannot create signalfd: %.200s", strerror(errno));
+
+    bzero(&ev, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = &ev_timerwatch;
+    if (epoll_ctl(ev_fd, EPOLL_CTL_ADD, ev_timerwatch.fd, &ev) < 0)
+        fatal("cannot watch timerfd: %.200s", strerror(errno));
+    ev.data.ptr = &ev_signalwatch;
+    if (epoll_ctl(ev_fd, EPOLL_CTL_ADD, ev_signalwatch.fd, &ev) < 0)
+        fatal("cannot watch signalfd: %.200s", strerror(errno));
+}
+/*
+ * Handle a signal in the event loop. The signal is blocked, so threads that
+ * are started later inherit the mask and leave it to the signalfd.
+ */
+void
+event_signal(int sig, void (*handler) (int))
+{
+    if (sig >= EV_MAXSIGNALS)
+        fatal("internal error: signal %d out of range", sig);
+
+    ev_handlers[sig] = handler;
+    sigaddset(&ev_sigset, sig);
+    if (sigprocmask(SIG_BLOCK, &ev_sigset, NULL) < 0)
+        fatal("cannot block signal %d: %.200s", sig, strerror(errno));
+    if (signalfd(ev_signalwatch.fd, &ev_sigset, 0) < 0)
+        fatal("cannot update signalfd: %.200s", strerror(errno));
+}
+void
+ev_epoll_add(int fd, int urgent, void (*cb) (int, void *), void *arg)
+{
+    struct epoll_event ev;
+    struct ev_watch *w;
+
+    w = ev_add(fd, urgent, cb, arg);
+
+    bzero(&ev, sizeof(ev));
+    ev.events = urgent ? EPOLLPRI : EPOLLIN;
+    ev.data.ptr = w;
+    if (epoll_ctl(ev_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        fatal("cannot watch fd %d: %.200s", fd, strerror(errno));
+}
+void
+event_watch(int fd, void (*cb) (int, void *), void *arg)
+{
+    ev_epoll_add(fd, 0, cb, arg);
+}
+/* Watch for urgent data only, like the events of pressure stall triggers */
+void
+event_urgent(int fd, void (*cb) (int, void *), void *arg)
+{
+    ev_epoll_add(fd, 1, cb, arg);
+}
+void
+event_unwatch(int fd)
+{
+    int i;
+
+    for (i = 0; i < ev_nwatches; i++)
+        if (ev_watches[i]->fd == fd && ev_watches[i]->cb != NULL) {
+            epoll_ctl(ev_fd, EPOLL_CTL_DEL, fd, NULL);
+            ev_watches[i]->cb = NULL;
+        }
+}
+/*
+ * Dispatch events until the wall clock deadline passes, a signal was
+ * handled or a callback woke the loop. The deadline is converted to an
+ * absolute monotonic one, so that setting the clock back cannot stretch the
+ * wait; callers recheck the wall clock on return.
+ */
+void
+event_wait(struct timeval *deadline)
+{
+    struct epoll_event events[EV_MAXEVENTS];
+    struct itimerspec its;
+    struct ev_watch *w;
+    int i, n;
+
+    ev_collect();
+
+    bzero(&its, sizeof(its));
+    ev_end(&its.it_value, deadline);
+    if (timerfd_settime(ev_timerwatch.fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        fatal("cannot set timerfd: %.200s", strerror(errno));
+
+    ev_done = 0;
+    while (!ev_done) {
+        if ((n = epoll_wait(ev_fd, events, EV_MAXEVENTS, -1)) < 0) {
+            if (errno == EINTR)
+                continue;
+            fatal("epoll_wait failed: %.200s", strerror(errno));
+        }
+
+        for (i = 0; i < n; i++) {
+            w = events[i].data.ptr;
+            if (w->cb != NULL)
+                (w->cb) (w->fd, w->arg);
+        }
+    }
+}
+#else
+void
+event_init(void)
+{
+    /* EMPTY */
+}
+void
+event_signal(int sig, void (*handler) (int))
+{
+    signal(sig, handler);
+}
+void
+event_watch(int fd, void (*cb) (int, void *), void *arg)
+{
+    ev_add(fd, 0, cb, arg);
+}
+void
+event_urgent(int fd, void (*cb) (int, void *), void *arg)
+{
+    ev_add(fd, 1, cb, arg);
+}
+void
+event_unwatch(int fd)
+{
+    int i;
+
+    for (i = 0; i < ev_nwatches; i++)
+        if (ev_watches[i]->fd == fd)
+            ev_watches[i]->cb = NULL;
+}
+/*
+ * Dispatch events until the wall clock deadline passes, a signal
+ * interrupts the wait or a callback woke the loop. Callers recheck the wall
+ * clock on return.
+ */
+void
+event_wait(struct timeval *deadline)
+{
+    struct pollfd pfd[EV_MAXEVENTS];
+    struct timespec end, ts;
+    int i, n, timeout;
+
+    ev_end(&end, deadline);
+
+    ev_done = 0;
+    while (!ev_done) {
+        ev_collect();
+
+        n = MIN(ev_nwatches, EV_MAXEVENTS);
+        for (i = 0; i < n; i++) {
+            pfd[i].fd = ev_watches[i]->fd;
+            pfd[i].events = ev_watches[i]->urgent ? POLLPRI : POLLIN;
+            pfd[i].revents = 0;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if (ts.tv_sec > end.tv_sec ||
+            (ts.tv_sec == end.tv_sec && ts.tv_nsec >= end.tv_nsec))
+            break;
+        timeout = (end.tv_sec - ts.tv_sec) * 1000 +
+            (end.tv_nsec - ts.tv_nsec + 999999) / 1000000;
+
+        if ((n = poll(pfd, n, timeout)) < 0) {
+            if (errno == EINTR)
+                break;
+            fatal("poll failed: %.200s", strerror(errno));
+        }
+
+        for (i = 0; n > 0 && i < MIN(ev_nwatches, EV_MAXEVENTS); i++)
+            if (pfd[i].revents && ev_watches[i]->cb != NULL)
+                (ev_watches[i]->cb) (pfd[i].fd, ev_watches[i]->arg);
+    }
+}
+#endif
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Worker pool for probes. The main thread adds the streams that are due to
+ * the probe of their module, runs all probes and waits until they are done
+ * or the deadline passes. Workers only touch the probe they have taken from
+ * the queue and the streams in it; the main thread leaves probes alone until
+ * they are done.
+ */
+#include <sys/param.h>
+#include <sys/time.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+
+#include "conf.h"
+#include "data.h"
+#include "error.h"
+#include "probe.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+int probe_match(struct probe *, int);
+int probe_uses(struct probe *, struct stream *);
+struct probe *probe_find(int);
+void *probe_worker(void *);
+void probe_spawn(void);
+
+static pthread_mutex_t probe_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t probe_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t probe_done = PTHREAD_COND_INITIALIZER;
+static struct probelist probes = SLIST_HEAD_INITIALIZER(probes);
+static struct probe *probe_queue = NULL;
+static int probe_workers = 0;
+static int probe_round = 0;
+
+/*
+ * Probes are per module. Modules are known by their gets, which streams of
+ * several types can share, or by their get if they have none.
+ */
+int
+probe_match(struct probe *p, int type)
+{
+    if (streamfunc[type].gets != NULL)
+        return (p->gets == streamfunc[type].gets);
+
+    return (p->gets == NULL && p->get == streamfunc[type].get);
+}
+/* Find or create the probe for the module of a stream type */
+struct probe *
+probe_find(int type)
+{
+    struct probe *p;
+
+    SLIST_FOREACH(p, &probes, probes)
+        if (probe_match(p, type))
+            return p;
+
+    p = xmalloc(sizeof(struct probe));
+    bzero(p, sizeof(struct probe));
+    p->get = streamfunc[type].get;
+    p->gets = streamfunc[type].gets;
+    p->type = type;
+    SLIST_INSERT_HEAD(&probes, p, probes);
+
+    return p;
+}
+void *
+probe_worker(void *arg)
+{
+    struct stream *stream;
+    struct probe *p;
+    int i;
+
+    pthread_mutex_lock(&probe_lock);
+    for (;;) {
+        while (probe_queue == NULL)
+            pthread_cond_wait(&probe_work, &probe_lock);
+
+        p = probe_queue;
+        probe_queue = p->queue;
+        p->state = PROBE_RUNNING;
+        pthread_mutex_unlock(&probe_lock);
+
+        if (p->gets != NULL)
+            (p->gets) ();
+
+        for (i = 0; i < p->nstreams; i++) {
+            stream = p->streams[i];
+            /* wildcards only need the gets to see new objects */
+            if (stream->pattern)
+                continue;
+            /* snpack relies on a zeroed buffer to terminate the argument */
+            bzero(stream->sample, sizeof(struct packedstream));
+            stream->samplelen = (streamfunc[stream->type].get)
+                (stream->sample, sizeof(struct packedstream), stream);
+        }
+
+        pthread_mutex_lock(&probe_lock);
+        p->state = PROBE_DONE;
+        pthread_cond_broadcast(&probe_done);
+    }
+
+    return NULL;                /* NOTREACHED */
+}
+/* Add a worker; signals stay with the main thread */
+void
+probe_spawn(void)
+{
+    sigset_t all, old;
+    pthread_t tid;
+    int error;
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    error = pthread_create(&tid, NULL, probe_worker, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (error != 0)
+        fatal("cannot start probe worker: %.200s", strerror(error));
+
+    pthread_detach(tid);
+    probe_workers++;
+}
+void
+probe_start(void)
+{
+    while (probe_workers < SYMON_WORKERS)
+        probe_spawn();
+}
+/* Start a new round of measurements */
+void
+probe_begin(void)
+{
+    probe_round++;
+}
+/* Schedule a stream for this round, unless its probe is stuck or quarantined */
+void
+probe_add(struct stream *stream)
+{
+    struct probe *p;
+    int backoff, busy;
+
+    p = probe_find(stream->type);
+    stream->probe = p;
+
+    pthread_mutex_lock(&probe_lock);
+    busy = (p->state == PROBE_QUEUED || p->state == PROBE_RUNNING);
+    pthread_mutex_unlock(&probe_lock);
+
+    if (busy)
+        return;
+
+    /* streams of a reload that waited for this probe */
+    if (stream->uninit) {
+        stream->uninit = 0;
+        (streamfunc[stream->type].init) (stream);
+    }
+
+    if (p->late) {
+        /* finished after all; stay away for a while */
+        p->late = 0;
+        backoff = symon_interval << MIN(p->failures, SYMON_MAXBACKOFF);
+        p->quarantine = now + backoff;
+        warning("%.200s probe finished late; skipping it for %d s",
+                type2str(p->type), backoff);
+    }
+
+    if (now < p->quarantine)
+        return;
+
+    if (p->round != probe_round) {
+        p->round = probe_round;
+        p->state = PROBE_IDLE;
+        p->nstreams = 0;
+    }
+
+    if (p->nstreams == p->maxstreams) {
+        p->maxstreams = (p->maxstreams == 0) ? 4 : p->maxstreams * 2;
+        p->streams = xrealloc(p->streams, p->maxstreams * sizeof(struct stream *));
+    }
+
+    if (stream->sample == NULL)
+        stream->sample = xmalloc(sizeof(struct packedstream));
+
+    p->streams[p->nstreams++] = stream;
+}
+/* Run the probes of this round and wait for them until deadline */
+void
+probe_run(struct timeval *deadline)
+{
+    struct timespec ts;
+    struct probe *p;
+    int pending, stuck;
+
+    ts.tv_sec = deadline->tv_sec;
+    ts.tv_nsec = deadline->tv_usec * 1000;
+
+    pthread_mutex_lock(&probe_lock);
+
+    /* streams of an old configuration are no longer needed once done */
+    SLIST_FOREACH(p, &probes, probes) {
+        if (p->state == PROBE_QUEUED || p->state == PROBE_RUNNING)
+            continue;
+        free_streamlist(&p->detached);
+        SLIST_INIT(&p->detached);
+    }
+
+    /* stuck probes keep their worker; keep enough workers for the rest */
+    stuck = 0;
+    SLIST_FOREACH(p, &probes, probes)
+        if (p->state == PROBE_RUNNING)
+            stuck++;
+    while (probe_workers - stuck < SYMON_WORKERS &&
+           probe_workers < SYMON_MAXWORKERS)
+        probe_spawn();
+
+    pending = 0;
+    SLIST_FOREACH(p, &probes, probes) {
+        if (p->round == probe_round && p->state == PROBE_IDLE) {
+            p->state = PROBE_QUEUED;
+            p->queue = probe_queue;
+            probe_queue = p;
+            pending++;
+        }
+    }
+    pthread_cond_broadcast(&probe_work);
+
+    while (pending) {
+        pending = 0;
+        SLIST_FOREACH(p, &probes, probes)
+            if (p->round == probe_round && p->state != PROBE_DONE)
+                pending++;
+
+        if (pending &&
+            pthread_cond_timedwait(&probe_done, &probe_lock, &ts) == ETIMEDOUT)
+            break;
+    }
+
+    SLIST_FOREACH(p, &probes, probes) {
+        if (p->round != probe_round)
+            continue;
+
+        if (p->state == PROBE_DONE) {
+            p->failures = 0;
+        } else {
+            p->late = 1;
+            p->failures++;
+            warning("%.200s probe missed its deadline; its streams are not sent",
+                    type2str(p->type));
+        }
+    }
+
+    pthread_mutex_unlock(&probe_lock);
+}
+/* Copy the result of a stream measured in this round */
+int
+probe_sample(struct stream *stream, char *buf, int maxlen)
+{
+    struct probe *p = stream->probe;
+    int len;
+
+    if (p == NULL)
+        return 0;
+
+    pthread_mutex_lock(&probe_lock);
+    len = 0;
+    if (p->round == probe_round && p->state == PROBE_DONE && !p->late)
+        len = stream->samplelen;
+    pthread_mutex_unlock(&probe_lock);
+
+    if (len <= 0 || len > maxlen)
+        return 0;
+
+    bcopy(stream->sample, buf, len);
+    return len;
+}
+/* Is the module of type still being probed? */
+int
+probe_busy(int type)
+{
+    struct probe *p;
+    int busy = 0;
+
+    pthread_mutex_lock(&probe_lock);
+    SLIST_FOREACH(p, &probes, probes)
+        if (probe_match(p, type))
+            busy = (p->state == PROBE_QUEUED || p->state == PROBE_RUNNING);
+    pthread_mutex_unlock(&probe_lock);
+
+    return busy;
+}
+/* Is stream one of the streams that p measures in its round? */
+int
+probe_uses(struct probe *p, struct stream *stream)
+{
+    int i;
+
+    for (i = 0; i < p->nstreams; i++)
+        if (p->streams[i] == stream)
+            return 1;
+
+    return 0;
+}
+/*
+ * Take the streams that a busy probe is still measuring out of sl, before sl
+ * is freed for a new configuration. The probe frees them when it is done.
+ */
+void
+probe_detach(struct streamlist *sl)
+{
+    struct stream *stream, *prev, *next;
+    struct probe *p;
+
+    pthread_mutex_lock(&probe_lock);
+    prev = NULL;
+    for (stream = SLIST_FIRST(sl); stream != NULL; stream = next) {
+        next = SLIST_NEXT(stream, streams);
+        p = stream->probe;
+        if (p == NULL ||
+            (p->state != PROBE_QUEUED && p->state != PROBE_RUNNING) ||
+            !probe_uses(p, stream)) {
+            prev = stream;
+            continue;
+        }
+
+        if (SLIST_EMPTY(&p->detached))
+            info("%.200s probe is still running; its streams are reloaded "
+                 "when it is done", type2str(p->type));
+
+        if (prev == NULL)
+            SLIST_FIRST(sl) = next;
+        else
+            SLIST_NEXT(prev, streams) = next;
+        SLIST_INSERT_HEAD(&p->detached, stream, streams);
+    }
+    pthread_mutex_unlock(&probe_lock);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Probes run the gets and get calls of one module for all streams of that
+ * module that are due, whatever their type. Probes of different modules run
+ * concurrently on a small pool of worker threads and have a deadline; a probe
+ * that misses it is left to finish in the background, its streams are missing
+ * for that interval and it is quarantined for an increasing number of
+ * intervals.
+ */
+#ifndef _SYMON_PROBE_H
+#define _SYMON_PROBE_H
+
+#include "data.h"
+
+#define PROBE_IDLE    0
+#define PROBE_QUEUED  1
+#define PROBE_RUNNING 2
+#define PROBE_DONE    3
+
+struct probe {
+    int (*get) (char *, int, struct stream *);  /* module without gets */
+    void (*gets) (void);        /* identifies the module */
+    int type;                   /* type of the first stream, for messages */
+    struct stream **streams;    /* streams to get in this round */
+    int nstreams;
+    int maxstreams;
+    int state;
+    int round;                  /* last round the probe was part of */
+    int late;                   /* missed the deadline of its round */
+    int failures;               /* consecutive missed deadlines */
+    time_t quarantine;          /* skip until */
+    struct probe *queue;        /* next probe waiting for a worker */
+    struct streamlist detached; /* streams of an old configuration that the
+                                 * probe still measures */
+    SLIST_ENTRY(probe) probes;
+};
+SLIST_HEAD(probelist, probe);
+
+/* prototypes */
+int probe_busy(int);
+int probe_sample(struct stream *, char *, int);
+void probe_add(struct stream *);
+void probe_detach(struct streamlist *);
+void probe_begin(void);
+void probe_run(struct timeval *);
+void probe_start(void);
+#endif                          /* _SYMON_PROBE_H */
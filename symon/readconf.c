@@ -28,9 +28,11 @@
  *
  */
 
+#include <sys/param.h>
 #include <sys/types.h>
 
 #include <string.h>
+#include <unistd.h>
 
 #include "conf.h"
 #include "data.h"
@@ -41,12 +43,20 @@
 #include "xmalloc.h"
 
 int read_host_port(struct muxlist *, struct mux *, struct lex *);
+int read_phase(struct mux *, struct lex *);
+int read_resolution(struct stream *, struct lex *);
+int read_interval(struct lex *, int *);
+int read_spool(struct mux *, struct lex *);
+int auto_phase(struct mux *);
+int same_streams(struct mux *, struct mux *);
 int read_symon_args(struct mux *, struct lex *);
+struct stream *find_pressure_stream(struct mux *, char *);
 int read_monitor(struct muxlist *, struct lex *);
+int read_plugindir(struct lex *);
 
 const char *default_symux_port = SYMUX_PORT;
 
-/* parse "(ip4addr | ip6addr | hostname) [['port' | ',' ] portnumber]" */
+/* parse "(ip4addr | ip6addr | hostname) [['port' | ',' ] portnumber] ['udp' | 'tcp']" */
 int
 read_host_port(struct muxlist * mul, struct mux * mux, struct lex * l)
 {
@@ -76,6 +86,16 @@ read_host_port(struct muxlist * mul, struct mux * mux, struct lex * l)
         }
     }
 
+    /* check for transport */
+    if (lex_nexttoken(l)) {
+        if (l->op == LXT_TCP)
+            mux->socktype = SOCK_STREAM;
+        else if (l->op == LXT_UDP)
+            mux->socktype = SOCK_DGRAM;
+        else
+            lex_ungettoken(l);
+    }
+
     bzero(&muxname, sizeof(muxname));
     snprintf(&muxname[0], sizeof(muxname), "%s %s (%ds)", mux->addr, mux->port, mux->interval);
     if (rename_mux(mul, mux, muxname) == NULL) {
@@ -86,12 +106,154 @@ read_host_port(struct muxlist * mul, struct mux * mux, struct lex * l)
 
     return 1;
 }
-/* parse "resource version ['(' argument ')']", end condition == '}' */
+/* parse "['phase' ('auto' | milliseconds)]" */
+int
+read_phase(struct mux * mux, struct lex * l)
+{
+    if (!lex_nexttoken(l))
+        return 1;
+
+    if (l->op != LXT_PHASE) {
+        lex_ungettoken(l);
+        return 1;
+    }
+
+    lex_nexttoken(l);
+    if (l->op == LXT_AUTO) {
+        mux->phase = SYMON_PHASE_AUTO;
+    } else if (l->type == LXY_NUMBER) {
+        mux->phase = l->value;
+        if (mux->phase >= mux->interval * 1000) {
+            warning("%.200s:%d: phase %d ms is not shorter than the interval of mux '%.200s'",
+                    l->filename, l->cline, mux->phase, mux->name);
+            return 0;
+        }
+    } else {
+        parse_error(l, "{auto|<milliseconds>}");
+        return 0;
+    }
+
+    return 1;
+}
+/* parse "['spool' filename [kilobytes]]" */
+int
+read_spool(struct mux * mux, struct lex * l)
+{
+    if (!lex_nexttoken(l))
+        return 1;
+
+    if (l->op != LXT_SPOOL) {
+        lex_ungettoken(l);
+        return 1;
+    }
+
+    if (mux->socktype != SOCK_STREAM) {
+        warning("%.200s:%d: spool needs tcp transport to mux '%.200s'",
+                l->filename, l->cline, mux->name);
+        return 0;
+    }
+
+    lex_nexttoken(l);
+    if (l->token[0] != '/') {
+        warning("%.200s:%d: spool path '%.200s' is not absolute",
+                l->filename, l->cline, l->token);
+        return 0;
+    }
+    mux->spoolfile = xstrdup(l->token);
+    mux->spoolsize = SYMON_DEFAULT_SPOOLSIZE;
+
+    if (lex_nexttoken(l)) {
+        if (l->type == LXY_NUMBER)
+            mux->spoolsize = l->value;
+        else
+            lex_ungettoken(l);
+    }
+
+    if (mux->spoolsize == 0) {
+        warning("%.200s:%d: spool size cannot be 0", l->filename, l->cline);
+        return 0;
+    }
+    mux->spoolsize *= 1024;
+
+    return 1;
+}
+/* parse "('second' | number ('second' | 'seconds'))" after 'every' */
+int
+read_interval(struct lex * l, int *interval)
+{
+    lex_nexttoken(l);
+
+    if (l->op == LXT_SECOND) {
+        *interval = 1;
+    } else if (l->type == LXY_NUMBER && l->value > 0) {
+        *interval = l->value;
+        lex_nexttoken(l);
+        if (l->op != LXT_SECONDS && l->op != LXT_SECOND) {
+            parse_error(l, "seconds");
+            return 0;
+        }
+    } else {
+        parse_error(l, "<number> ");
+        return 0;
+    }
+
+    return 1;
+}
+/* parse "['resolution' milliseconds]" of an aggregated stream */
+int
+read_resolution(struct stream * stream, struct lex * l)
+{
+    stream->agg = xmalloc(sizeof(struct aggregate));
+    bzero(stream->agg, sizeof(struct aggregate));
+    stream->agg->resolution = SYMON_DEFAULT_RESOLUTION;
+
+    if (!lex_nexttoken(l))
+        return 1;
+
+    if (l->op != LXT_RESOLUTION) {
+        lex_ungettoken(l);
+        return 1;
+    }
+
+    lex_nexttoken(l);
+    if (l->type != LXY_NUMBER) {
+        parse_error(l, "<milliseconds>");
+        return 0;
+    }
+
+    /* samples need to line up with whole seconds */
+    if (l->value < 100 || l->value > 1000 || (1000 % l->value) != 0) {
+        warning("%.200s:%d: resolution %ld ms is not a fraction of a second of at least 100 ms",
+                l->filename, l->cline, l->value);
+        return 0;
+    }
+    stream->agg->resolution = l->value;
+
+    return 1;
+}
+/* Pressure streams are sent under their resource; find one for that of arg */
+struct stream *
+find_pressure_stream(struct mux * mux, char *arg)
+{
+    struct stream *stream;
+    size_t len;
+
+    len = strcspn(arg, ":");
+    SLIST_FOREACH(stream, &mux->sl, streams)
+        if (stream->type == MT_PRESSURE && strcspn(stream->arg, ":") == len &&
+            strncmp(stream->arg, arg, len) == 0)
+            return stream;
+
+    return NULL;
+}
+/* parse "resource version ['(' argument ')'] [resolution] [every]", end
+ * condition == '}' */
 int
 read_symon_args(struct mux * mux, struct lex * l)
 {
     char sn[_POSIX2_LINE_MAX];
     char sa[_POSIX2_LINE_MAX];
+    struct stream *stream;
     int st;
 
     EXPECT(l, LXT_BEGIN)
@@ -117,6 +279,14 @@ read_symon_args(struct mux * mux, struct lex * l)
         case LXT_FLUKSO:
         case LXT_TIME:
         case LXT_WG:
+        case LXT_CPUAGG:
+        case LXT_IFAGG:
+        case LXT_IOAGG:
+        case LXT_CPUHIST:
+        case LXT_CGROUP:
+        case LXT_PLUGIN:
+        case LXT_EXEC:
+        case LXT_PRESSURE:
             st = token2type(l->op);
             strncpy(&sn[0], l->token, (_POSIX2_LINE_MAX - 1));
 
@@ -145,17 +315,47 @@ read_symon_args(struct mux * mux, struct lex * l)
                         l->filename, l->cline, sa);
             }
 
-            if ((add_mux_stream(mux, st, sa)) == NULL) {
+            if (is_wildcard(sa) && !wildcard_type(st)) {
+                warning("%.200s:%d: stream %.200s(%.200s) cannot have a wildcard argument",
+                        l->filename, l->cline, sn, sa);
+                return 0;
+            }
+
+            if (st == MT_PRESSURE &&
+                (stream = find_pressure_stream(mux, sa)) != NULL) {
+                warning("%.200s:%d: stream %.200s(%.200s) measures the same "
+                        "resource as %.200s(%.200s); a mux can have one per resource",
+                        l->filename, l->cline, sn, sa, sn, stream->arg);
+                return 0;
+            }
+
+            if ((stream = add_mux_stream(mux, st, sa)) == NULL) {
                 warning("%.200s:%d: stream %.200s(%.200s) redefined",
                         l->filename, l->cline, sn, sa);
                 return 0;
             }
+            stream->pattern = is_wildcard(sa);
+
+            if (st == MT_CPUAGG || st == MT_IFAGG || st == MT_IOAGG) {
+                if (!read_resolution(stream, l))
+                    return 0;
+            }
+
+            /* parse [every x seconds]? */
+            if (lex_nexttoken(l)) {
+                if (l->op == LXT_EVERY) {
+                    if (!read_interval(l, &stream->interval))
+                        return 0;
+                } else {
+                    lex_ungettoken(l);
+                }
+            }
 
             break;
         case LXT_COMMA:
             break;
         default:
-            parse_error(l, "{cpu|cpuiow|df|if|if1|io|io1|load|mem|mem1|pf|pfq|mbuf|debug|proc|sensor|smart|load|flukso|wg|time}");
+            parse_error(l, "{cpu|cpuiow|df|if|if1|io|io1|load|mem|mem1|pf|pfq|mbuf|debug|proc|sensor|smart|load|flukso|wg|time|cpuagg|ifagg|ioagg|cpuhist|cgroup|plugin|exec|pressure}");
             return 0;
             break;
         }
@@ -165,10 +365,11 @@ read_symon_args(struct mux * mux, struct lex * l)
 }
 
 /* parse "'monitor' '{' resources '}' ['every' time ] 'stream' ['from' host]
- * ['to'] host [port]" */
+ * ['to'] host [port] [transport] [phase] [spool]" */
 int
 read_monitor(struct muxlist * mul, struct lex * l)
 {
+    struct stream *stream;
     struct mux *mux;
 
     mux = add_mux(mul, SYMON_UNKMUX);
@@ -181,25 +382,25 @@ read_monitor(struct muxlist * mul, struct lex * l)
 
     /* parse [every x seconds]? */
     if (l->op == LXT_EVERY) {
-        lex_nexttoken(l);
-
-        if (l->op == LXT_SECOND) {
-            mux->interval = 1;
-        } else if (l->type == LXY_NUMBER) {
-            mux->interval = l->value;
-            lex_nexttoken(l);
-            if (l->op != LXT_SECONDS) {
-                parse_error(l, "seconds");
-            }
-        } else {
-            parse_error(l, "<number> ");
+        if (!read_interval(l, &mux->interval))
             return 0;
-        }
 
         lex_nexttoken(l);
     } else
         mux->interval = SYMON_DEFAULT_INTERVAL;
 
+    /* streams can only be measured less often than their mux */
+    SLIST_FOREACH(stream, &mux->sl, streams) {
+        if (stream->interval % mux->interval) {
+            warning("%.200s:%d: stream %.200s(%.200s) interval %d s is not a multiple of %d s",
+                    l->filename, l->cline, type2str(stream->type), stream->arg,
+                    stream->interval, mux->interval);
+            return 0;
+        }
+        if (stream->interval == mux->interval)
+            stream->interval = 0;
+    }
+
     /* parse [stream [from <host>] to] */
     if (l->op != LXT_STREAM) {
         parse_error(l, "stream");
@@ -223,16 +424,86 @@ read_monitor(struct muxlist * mul, struct lex * l)
     if (l->op != LXT_TO)
         lex_ungettoken(l);
 
-    /* parse [host [port]?] */
-    return read_host_port(mul, mux, l);
+    /* parse [host [port]? [transport]?] */
+    if (!read_host_port(mul, mux, l))
+        return 0;
+
+    if (!read_phase(mux, l))
+        return 0;
+
+    return read_spool(mux, l);
+}
+
+/* Derive a stable phase from hostname and mux, so that hosts that sample at
+ * the same moment spread their transmissions over the interval */
+int
+auto_phase(struct mux *mux)
+{
+    char host[MAXHOSTNAMELEN];
+    u_int32_t hash;
+    char *p;
+
+    if (gethostname(host, sizeof(host)) != 0)
+        host[0] = '\0';
+    host[sizeof(host) - 1] = '\0';
+
+    /* fnv-1a */
+    hash = 2166136261U;
+    for (p = host; *p; p++)
+        hash = (hash ^ (u_char) *p) * 16777619U;
+    for (p = mux->name; *p; p++)
+        hash = (hash ^ (u_char) *p) * 16777619U;
+
+    return hash % (mux->interval * 1000);
 }
+/* Check whether two muxes get the same measurements at the same time and
+ * send them at the same time */
+int
+same_streams(struct mux * a, struct mux * b)
+{
+    struct stream *stream, *other;
+    int na, nb;
+
+    if (a->interval != b->interval || a->phase != b->phase)
+        return 0;
+
+    na = nb = 0;
+    SLIST_FOREACH(stream, &a->sl, streams) {
+        if ((other = find_mux_stream(b, stream->type, stream->arg)) == NULL)
+            return 0;
+        if (stream->interval != other->interval)
+            return 0;
+        if (stream->agg != NULL &&
+            stream->agg->resolution != other->agg->resolution)
+            return 0;
+        na++;
+    }
+    SLIST_FOREACH(stream, &b->sl, streams)
+        nb++;
+
+    return (na == nb);
+}
+/* parse "'plugindir' path" */
+int
+read_plugindir(struct lex * l)
+{
+    lex_nexttoken(l);
+    if (l->token[0] != '/') {
+        warning("%.200s:%d: plugindir path '%.200s' is not absolute",
+                l->filename, l->cline, l->token);
+        return 0;
+    }
+
+    symon_plugindir = xstrdup(l->token);
 
+    return 1;
+}
 /* Read symon.conf */
 int
 read_config_file(struct muxlist *muxlist, char *filename)
 {
     struct lex *l;
-    struct mux *mux;
+    struct mux *mux, *omux;
 
     SLIST_INIT(muxlist);
 
@@ -245,8 +516,12 @@ read_config_file(struct muxlist *muxlist, char *filename)
             if (!read_monitor(muxlist, l))
                 return 0;
             break;
+        case LXT_PLUGINDIR:
+            if (!read_plugindir(l))
+                return 0;
+            break;
         default:
-            parse_error(l, "monitor");
+            parse_error(l, "monitor|plugindir");
             return 0;
             break;
         }
@@ -266,6 +541,33 @@ read_config_file(struct muxlist *muxlist, char *filename)
         if (mux->interval < SYMON_DEFAULT_INTERVAL) {
             warning("%.200s: monitoring set to every %d s", l->filename, mux->interval);
         }
+        /* before muxes are grouped, so that only equal phases share */
+        if (mux->phase == SYMON_PHASE_AUTO)
+            mux->phase = auto_phase(mux);
+        if (mux->spoolfile != NULL) {
+            SLIST_FOREACH(omux, muxlist, muxes) {
+                if (omux != mux && omux->spoolfile != NULL &&
+                    strcmp(omux->spoolfile, mux->spoolfile) == 0) {
+                    warning("%.200s: spool '%.200s' used for more than one mux",
+                            l->filename, mux->spoolfile);
+                    return 0;
+                }
+            }
+        }
+    }
+
+    /* muxes that want the same data share the packet of a leader */
+    SLIST_FOREACH(mux, muxlist, muxes) {
+        SLIST_FOREACH(omux, muxlist, muxes) {
+            if (omux == mux)
+                break;
+            if (omux->leader == NULL && same_streams(omux, mux)) {
+                mux->leader = omux;
+                debug("mux '%.200s' shares packets of mux '%.200s'",
+                      mux->name, omux->name);
+                break;
+            }
+        }
     }
 
     close_lex(l);
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Packet spool for tcp muxes. Finished packets are appended to a memory
+ * mapped ring file and only removed once symux acknowledges them, so that
+ * measurements survive a mux that is down and symon restarts. The ring drops
+ * its oldest packets when it fills up.
+ */
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "conf.h"
+#include "data.h"
+#include "error.h"
+#include "spool.h"
+#include "xmalloc.h"
+
+int spool_valid(struct spool *);
+u_int32_t spool_framelen(struct spool *, u_int32_t);
+u_int32_t spool_wrap(struct spool *, u_int32_t);
+void spool_pop(struct spool *);
+void spool_reset(struct spool *);
+
+/* Length of the packet in the frame at off; 0 = wrap marker */
+u_int32_t
+spool_framelen(struct spool * spool, u_int32_t off)
+{
+    u_int16_t len;
+
+    bcopy(spool->ring + off, &len, sizeof(len));
+
+    return ntohs(len);
+}
+/* Return the offset of the frame at off, taking wrap markers into account */
+u_int32_t
+spool_wrap(struct spool * spool, u_int32_t off)
+{
+    if ((spool->header->size - off) < SYMON_FRAMEHDR ||
+        spool_framelen(spool, off) == 0)
+        return 0;
+
+    return off;
+}
+/* Empty the spool */
+void
+spool_reset(struct spool * spool)
+{
+    spool->header->magic = SYMON_SPOOLMAGIC;
+    spool->header->head = 0;
+    spool->header->tail = 0;
+    spool->header->count = 0;
+    spool_rewind(spool);
+}
+/* Check that a spool found on disk can be used */
+int
+spool_valid(struct spool * spool)
+{
+    struct spoolheader *h = spool->header;
+    u_int32_t i, len, off;
+
+    if (h->magic != SYMON_SPOOLMAGIC ||
+        (sizeof(struct spoolheader) + h->size) != spool->maplen ||
+        h->head > h->size || h->tail > h->size ||
+        h->count > (h->size / (SYMON_FRAMEHDR + 1)))
+        return 0;
+
+    off = h->head;
+    for (i = 0; i < h->count; i++) {
+        off = spool_wrap(spool, off);
+        len = spool_framelen(spool, off);
+        if (off + SYMON_FRAMEHDR + len > h->size)
+            return 0;
+        off += SYMON_FRAMEHDR + len;
+    }
+
+    return (h->count == 0 || off == h->tail);
+}
+/* Open or create the spool file of a mux. Called before privileges are
+ * dropped. */
+void
+spool_open(struct mux * mux)
+{
+    struct spool *spool;
+    struct stat sb;
+    void *map;
+
+    spool = xmalloc(sizeof(struct spool));
+    bzero(spool, sizeof(struct spool));
+    spool->maplen = sizeof(struct spoolheader) + mux->spoolsize;
+
+    if ((spool->fd = open(mux->spoolfile, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR)) == -1)
+        fatal("could not open spool %.200s: %.200s", mux->spoolfile, strerror(errno));
+
+    if (fstat(spool->fd, &sb) == -1)
+        fatal("could not stat spool %.200s: %.200s", mux->spoolfile, strerror(errno));
+
+    if ((size_t) sb.st_size != spool->maplen &&
+        ftruncate(spool->fd, spool->maplen) == -1)
+        fatal("could not size spool %.200s: %.200s", mux->spoolfile, strerror(errno));
+
+    map = mmap(NULL, spool->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, spool->fd, 0);
+    if (map == MAP_FAILED)
+        fatal("could not map spool %.200s: %.200s", mux->spoolfile, strerror(errno));
+
+    spool->header = (struct spoolheader *) map;
+    spool->ring = (char *) map + sizeof(struct spoolheader);
+
+    if (!spool_valid(spool)) {
+        if (sb.st_size != 0)
+            warning("spool %.200s is damaged or was resized; starting empty",
+                    mux->spoolfile);
+        spool->header->size = mux->spoolsize;
+        spool_reset(spool);
+    }
+
+    spool_rewind(spool);
+    mux->spool = spool;
+
+    info("spool %.200s holds %u packets", mux->spoolfile, spool->header->count);
+}
+/* Close the spool of a mux; spooled packets stay on disk */
+void
+spool_close(struct mux * mux)
+{
+    if (mux->spool == NULL)
+        return;
+
+    munmap((void *) mux->spool->header, mux->spool->maplen);
+    close(mux->spool->fd);
+    xfree(mux->spool);
+    mux->spool = NULL;
+}
+/* Remove the oldest frame */
+void
+spool_pop(struct spool * spool)
+{
+    struct spoolheader *h = spool->header;
+
+    h->head = spool_wrap(spool, h->head);
+    h->head += SYMON_FRAMEHDR + spool_framelen(spool, h->head);
+    h->count--;
+
+    if (spool->inflight > 0)
+        spool->inflight--;
+    else
+        spool->next = h->head;
+
+    if (h->count == 0) {
+        h->head = h->tail = 0;
+        spool->next = 0;
+    }
+}
+/* Append a packet, making room by dropping the oldest frames. Returns the
+ * number of packets lost. */
+int
+spool_push(struct spool * spool, char *packet, u_int16_t len)
+{
+    struct spoolheader *h = spool->header;
+    u_int32_t need, off;
+    u_int16_t nlen;
+    int dropped;
+
+    need = SYMON_FRAMEHDR + len;
+    if (need > h->size)
+        return 1;
+
+    for (dropped = 0;; dropped++) {
+        if (h->count == 0) {
+            h->head = h->tail = 0;
+            spool->next = 0;
+        }
+
+        if (h->count == 0 || h->tail > h->head) {
+            if ((h->size - h->tail) >= need) {
+                off = h->tail;
+                break;
+            }
+            if (h->head >= need) {
+                /* mark the end of the ring and continue at the start */
+                if ((h->size - h->tail) >= SYMON_FRAMEHDR)
+                    bzero(spool->ring + h->tail, SYMON_FRAMEHDR);
+                off = 0;
+                break;
+            }
+        } else if ((h->head - h->tail) >= need) {
+            off = h->tail;
+            break;
+        }
+
+        spool_pop(spool);
+    }
+
+    nlen = htons(len);
+    bcopy(&nlen, spool->ring + off, SYMON_FRAMEHDR);
+    bcopy(packet, spool->ring + off + SYMON_FRAMEHDR, len);
+    h->tail = off + need;
+    h->count++;
+
+    return dropped;
+}
+/* Return the first frame that has not been sent yet, or NULL */
+char *
+spool_next(struct spool * spool)
+{
+    if (spool->inflight >= spool->header->count)
+        return NULL;
+
+    spool->next = spool_wrap(spool, spool->next);
+
+    return spool->ring + spool->next;
+}
+/* Mark the frame returned by spool_next as sent */
+void
+spool_sent(struct spool * spool)
+{
+    spool->next += SYMON_FRAMEHDR + spool_framelen(spool, spool->next);
+    spool->inflight++;
+}
+/* Forget what has been sent; everything will be sent again */
+void
+spool_rewind(struct spool * spool)
+{
+    spool->next = spool->header->head;
+    spool->inflight = 0;
+    spool->acklen = 0;
+}
+/*
+ * Process acknowledgements read from the mux. An acknowledgement is the crc of
+ * a packet that symux has dealt with. Acknowledgements arrive in order; one
+ * for a later frame also acknowledges the frames before it.
+ */
+void
+spool_ack(struct spool * spool, char *buf, int len)
+{
+    u_int32_t i, j, off;
+    int n;
+
+    while (len > 0) {
+        n = sizeof(spool->ack) - spool->acklen;
+        n = (n < len) ? n : len;
+        bcopy(buf, spool->ack + spool->acklen, n);
+        spool->acklen += n;
+        buf += n;
+        len -= n;
+
+        if (spool->acklen < (int) sizeof(spool->ack))
+            break;
+
+        spool->acklen = 0;
+
+        off = spool->header->head;
+        for (i = 0; i < spool->inflight; i++) {
+            off = spool_wrap(spool, off);
+            if (bcmp(spool->ring + off + SYMON_FRAMEHDR, spool->ack, sizeof(spool->ack)) == 0)
+                break;
+            off += SYMON_FRAMEHDR + spool_framelen(spool, off);
+        }
+
+        /* not found = frame was dropped from the spool while in flight */
+        if (i < spool->inflight)
+            for (j = 0; j <= i; j++)
+                spool_pop(spool);
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * A spool keeps finished packets on disk until symux has acknowledged
+ * them. It is a ring of frames in a memory mapped file:
+ *
+ * spoolheader:frame*
+ * frame = length:packet, length is a network order u_int16; a zero length
+ * marks that the ring wraps to the start.
+ */
+#ifndef _SYMON_SPOOL_H
+#define _SYMON_SPOOL_H
+
+#include "data.h"
+
+#define SYMON_SPOOLMAGIC 0x73706f31     /* "spo1" */
+
+struct spoolheader {
+    u_int32_t magic;
+    u_int32_t size;             /* bytes in ring */
+    u_int32_t head;             /* offset of oldest frame */
+    u_int32_t tail;             /* offset after newest frame */
+    u_int32_t count;            /* frames in ring */
+};
+
+struct spool {
+    int fd;
+    size_t maplen;
+    struct spoolheader *header;
+    char *ring;
+    u_int32_t next;             /* offset of first frame not yet sent */
+    u_int32_t inflight;         /* frames sent but not acknowledged */
+    u_int8_t ack[sizeof(u_int32_t)];
+    int acklen;
+};
+
+/* prototypes */
+char *spool_next(struct spool *);
+int spool_push(struct spool *, char *, u_int16_t);
+void spool_ack(struct spool *, char *, int);
+void spool_close(struct mux *);
+void spool_open(struct mux *);
+void spool_rewind(struct spool *);
+void spool_sent(struct spool *);
+#endif                          /* _SYMON_SPOOL_H */
@@ -48,56 +48,92 @@
 #include "data.h"
 #include "error.h"
 #include "net.h"
+#include "probe.h"
 #include "readconf.h"
+#include "spool.h"
 #include "symon.h"
 #include "symonnet.h"
 #include "xmalloc.h"
 
-void alarmhandler(int);
 void exithandler(int);
 void huphandler(int);
 void init_streams(struct muxlist *mul);
+void align_subsample(struct timeval *);
+int stream_due(struct stream *, time_t);
+void sample_streams(struct muxlist *, int);
+void wait_for_deadline(struct muxlist *);
+void send_phased(struct muxlist *);
+void send_alerts(struct muxlist *);
 void drop_privileges(int unsecure);
 
 int flag_unsecure = 0;
 int flag_hup = 0;
+int flag_alert = 0;
 int flag_testconf = 0;
 int symon_interval = 0;
+int symon_resolution = 0;
+char *symon_plugindir = SYMON_PLUGIN_DIR;
+
+/* wall clock time of the next measurement */
+time_t next_sample;
+
+/* wall clock time of the next sample of aggregated streams */
+struct timeval next_subsample;
 
 /* program wide time_t indicating start of measurement time */
 time_t now;
 
+/* stream types that asked for a packet before the next measurement */
+static int alerted[MT_EOT];
+static time_t last_alert = 0;
+
+/* wildcard arguments are expanded on platforms whose modules list objects */
+#ifdef HAS_STREAM_NAMES
+#define STREAM_NAMES(f) f
+#else
+#define STREAM_NAMES(f) NULL
+#endif
+
 /* map stream types to inits and getters */
 struct funcmap streamfunc[] = {
-    {MT_IO1, 0, NULL, init_io, gets_io, get_io},
-    {MT_CPU, 0, NULL, init_cpu, gets_cpu, get_cpu},
-    {MT_MEM1, 0, NULL, init_mem, gets_mem, get_mem},
-    {MT_IF1, 0, NULL, init_if, gets_if, get_if},
-    {MT_PF, 0, privinit_pf, init_pf, gets_pf, get_pf},
-    {MT_DEBUG, 0, NULL, init_debug, NULL, get_debug},
-    {MT_PROC, 0, privinit_proc, init_proc, gets_proc, get_proc},
-    {MT_MBUF, 0, NULL, init_mbuf, NULL, get_mbuf},
-    {MT_SENSOR, 0, privinit_sensor, init_sensor, NULL, get_sensor},
-    {MT_IO2, 0, NULL, init_io, gets_io, get_io},
-    {MT_PFQ, 0, privinit_pfq, init_pfq, gets_pfq, get_pfq},
-    {MT_DF, 0, NULL, init_df, gets_df, get_df},
-    {MT_MEM2, 0, NULL, init_mem, gets_mem, get_mem},
-    {MT_IF2, 0, NULL, init_if, gets_if, get_if},
-    {MT_CPUIOW, 0, NULL, init_cpuiow, gets_cpuiow, get_cpuiow},
-    {MT_SMART, 0, privinit_smart, init_smart, gets_smart, get_smart},
-    {MT_LOAD, 0, NULL, init_load, gets_load, get_load},
-    {MT_FLUKSO, 0, NULL, init_flukso, gets_flukso, get_flukso},
-    {MT_WG, 0, NULL, init_wg, gets_wg, get_wg},
-    {MT_TIME, 0, NULL, init_time, NULL, get_time},
-    {MT_EOT, 0, NULL, NULL, NULL, NULL}
+    {MT_IO1, 0, NULL, init_io, gets_io, get_io, STREAM_NAMES(names_io)},
+    {MT_CPU, 0, NULL, init_cpu, gets_cpu, get_cpu, STREAM_NAMES(names_cpu)},
+    {MT_MEM1, 0, NULL, init_mem, gets_mem, get_mem, NULL},
+    {MT_IF1, 0, NULL, init_if, gets_if, get_if, STREAM_NAMES(names_if)},
+    {MT_PF, 0, privinit_pf, init_pf, gets_pf, get_pf, NULL},
+    {MT_DEBUG, 0, NULL, init_debug, NULL, get_debug, NULL},
+    {MT_PROC, 0, privinit_proc, init_proc, gets_proc, get_proc, NULL},
+    {MT_MBUF, 0, NULL, init_mbuf, NULL, get_mbuf, NULL},
+    {MT_SENSOR, 0, privinit_sensor, init_sensor, gets_sensor, get_sensor, NULL},
+    {MT_IO2, 0, NULL, init_io, gets_io, get_io, STREAM_NAMES(names_io)},
+    {MT_PFQ, 0, privinit_pfq, init_pfq, gets_pfq, get_pfq, NULL},
+    {MT_DF, 0, NULL, init_df, gets_df, get_df, STREAM_NAMES(names_df)},
+    {MT_MEM2, 0, NULL, init_mem, gets_mem, get_mem, NULL},
+    {MT_IF2, 0, NULL, init_if, gets_if, get_if, STREAM_NAMES(names_if)},
+    {MT_CPUIOW, 0, NULL, init_cpuiow, gets_cpuiow, get_cpuiow, NULL},
+    {MT_SMART, 0, privinit_smart, init_smart, gets_smart, get_smart, NULL},
+    {MT_LOAD, 0, NULL, init_load, gets_load, get_load, NULL},
+    {MT_FLUKSO, 0, NULL, init_flukso, gets_flukso, get_flukso, NULL},
+    {MT_WG, 0, NULL, init_wg, gets_wg, get_wg, NULL},
+    {MT_TIME, 0, NULL, init_time, NULL, get_time, NULL},
+    {MT_CPUAGG, 0, NULL, init_aggregate, NULL, get_aggregate, NULL},
+    {MT_IFAGG, 0, NULL, init_aggregate, NULL, get_aggregate, NULL},
+    {MT_IOAGG, 0, NULL, init_aggregate, NULL, get_aggregate, NULL},
+    {MT_CPUHIST, 0, NULL, init_cpuhist, gets_cpu, get_cpuhist, NULL},
+    {MT_CGROUP, 0, NULL, init_cgroup, gets_cgroup, get_cgroup, STREAM_NAMES(names_cgroup)},
+    {MT_PLUGIN, 0, privinit_plugin, init_plugin, gets_plugin, get_plugin, NULL},
+    {MT_EXEC, 0, privinit_exec, init_exec, NULL, get_exec, NULL},
+    {MT_PRESSURE, 0, privinit_pressure, init_pressure, gets_pressure, get_pressure, NULL},
+    {MT_EOT, 0, NULL, NULL, NULL, NULL, NULL}
 };
 
 void
 init_streams(struct muxlist *mul)
 {
-    struct itimerval alarminterval;
     struct stream *stream;
+    struct timeval tv;
     struct mux *mux;
+    int base;
 
     mux = NULL;
 
@@ -105,6 +141,7 @@ init_streams(struct muxlist *mul)
         fatal("empty mux list");
 
     symon_interval = mux->interval;
+    symon_resolution = 0;
 
     SLIST_FOREACH(mux, mul, muxes) {
         /* determine gcd of alarm times */
@@ -114,21 +151,195 @@ init_streams(struct muxlist *mul)
         init_symon_packet(mux);
         connect2mux(mux);
 
-        /* init modules */
+        if (mux->phase && mux->leader == NULL)
+            debug("mux '%.200s' sends %d ms after sampling", mux->name, mux->phase);
+
+        /* init modules; followers never measure themselves. Modules that
+         * a probe is still busy with are inited when it is done. */
+        if (mux->leader == NULL)
+            SLIST_FOREACH(stream, &mux->sl, streams) {
+                base = (stream->agg != NULL) ?
+                    aggregate_base(stream->type) : stream->type;
+                if (probe_busy(base))
+                    stream->uninit = 1;
+                else
+                    (streamfunc[stream->type].init) (stream);
+
+                /* determine gcd of sample times */
+                if (stream->agg != NULL)
+                    symon_resolution = symon_resolution ?
+                        gcd(symon_resolution, stream->agg->resolution) :
+                        stream->agg->resolution;
+            }
+    }
+
+    /* wildcard streams were inited with a first look at their module */
+    expand_streams(mul);
+
+    /* measure on multiples of the interval in wall clock time */
+    gettimeofday(&tv, NULL);
+    next_sample = tv.tv_sec - (tv.tv_sec % symon_interval) + symon_interval;
+    align_subsample(&tv);
+}
+/* streams with an interval of their own are measured on multiples of it */
+int
+stream_due(struct stream *stream, time_t t)
+{
+    return (stream->interval == 0 || (t % stream->interval) == 0);
+}
+/* first sample time of aggregated streams after tv, on a multiple of the
+ * resolution */
+void
+align_subsample(struct timeval *tv)
+{
+    long ms;
+
+    if (symon_resolution == 0)
+        return;
+
+    ms = tv->tv_usec / 1000;
+    ms = ms - (ms % symon_resolution) + symon_resolution;
+
+    next_subsample.tv_sec = tv->tv_sec + ms / 1000;
+    next_subsample.tv_usec = (ms % 1000) * 1000;
+}
+/* sample aggregated streams that are due at ms into the second */
+void
+sample_streams(struct muxlist *mul, int ms)
+{
+    struct stream *stream;
+    struct mux *mux;
+    int fetched[MT_EOT];
+    int base;
+
+    bzero(fetched, sizeof(fetched));
+
+    SLIST_FOREACH(mux, mul, muxes) {
+        if (mux->leader != NULL)
+            continue;
+
         SLIST_FOREACH(stream, &mux->sl, streams) {
-            (streamfunc[stream->type].init) (stream);
+            if (stream->agg == NULL || (ms % stream->agg->resolution) != 0)
+                continue;
+
+            /* leave modules alone that a probe is still busy with */
+            base = aggregate_base(stream->type);
+            if (fetched[base] == 0) {
+                fetched[base] = probe_busy(base) ? -1 : 1;
+                if (fetched[base] == 1 && streamfunc[base].gets != NULL)
+                    (streamfunc[base].gets) ();
+            }
+
+            if (fetched[base] != 1)
+                continue;
+
+            if (stream->uninit) {
+                stream->uninit = 0;
+                (streamfunc[stream->type].init) (stream);
+            }
+            sample_aggregate(stream);
+        }
+    }
+}
+/* handle events until the next measurement, sample or phased packet is due */
+void
+wait_for_deadline(struct muxlist *mul)
+{
+    struct timeval due;
+    struct mux *mux;
+
+    due.tv_sec = next_sample;
+    due.tv_usec = 0;
+
+    if (symon_resolution && timercmp(&next_subsample, &due, <))
+        due = next_subsample;
+
+    SLIST_FOREACH(mux, mul, muxes) {
+        if (mux->sendpending && timercmp(&mux->sendtime, &due, <))
+            due = mux->sendtime;
+    }
+
+    event_wait(&due);
+}
+/* send packets whose phase has passed */
+void
+send_phased(struct muxlist *mul)
+{
+    struct timeval tv;
+    struct mux *mux;
+
+    gettimeofday(&tv, NULL);
+    SLIST_FOREACH(mux, mul, muxes) {
+        if (mux->sendpending && !timercmp(&tv, &mux->sendtime, <)) {
+            mux->sendpending = 0;
+            send_packets(mul, mux);
         }
     }
+}
+/* a module saw a threshold crossed; its streams are sent right away */
+void
+stream_alert(int type)
+{
+    alerted[type] = 1;
+    flag_alert = 1;
+    event_wake();
+}
+/* measure and send the streams of alerted types in a packet of their own */
+void
+send_alerts(struct muxlist *mul)
+{
+    struct stream *stream;
+    struct timeval tv;
+    struct mux *mux;
+    int type, any;
+
+    flag_alert = 0;
+    gettimeofday(&tv, NULL);
+
+    /* rrds take one update per second, and a measurement is coming up */
+    if (tv.tv_sec <= now || tv.tv_sec <= last_alert || tv.tv_sec >= next_sample) {
+        bzero(alerted, sizeof(alerted));
+        return;
+    }
+    last_alert = tv.tv_sec;
+
+    /* leave modules alone that a probe is still busy with */
+    for (type = 0; type < MT_EOT; type++) {
+        if (alerted[type] && probe_busy(type))
+            alerted[type] = 0;
+        else if (alerted[type] && streamfunc[type].gets != NULL)
+            (streamfunc[type].gets) ();
+    }
 
-    /* setup alarm */
-    timerclear(&alarminterval.it_interval);
-    timerclear(&alarminterval.it_value);
-    alarminterval.it_interval.tv_sec =
-        alarminterval.it_value.tv_sec = symon_interval;
+    SLIST_FOREACH(mux, mul, muxes) {
+        if (mux->leader != NULL)
+            continue;
+
+        any = 0;
+        SLIST_FOREACH(stream, &mux->sl, streams)
+            if (alerted[stream->type] && !stream->pattern && stream->agg == NULL)
+                any = 1;
+        if (!any)
+            continue;
+
+        /* a pending packet keeps its own sample time */
+        if (mux->sendpending) {
+            mux->sendpending = 0;
+            send_packets(mul, mux);
+        }
 
-    if (setitimer(ITIMER_REAL, &alarminterval, NULL) != 0) {
-        fatal("alarm setup failed: %.200s", strerror(errno));
+        prepare_packet(mux, tv.tv_sec);
+        SLIST_FOREACH(stream, &mux->sl, streams)
+            if (alerted[stream->type] && !stream->pattern && stream->agg == NULL)
+                mux->packet.offset +=
+                    (streamfunc[stream->type].get)
+                    (mux->packet.data + mux->packet.offset,
+                     mux->packet.size - mux->packet.offset, stream);
+        finish_packet(mux);
+        send_packets(mul, mux);
     }
+
+    bzero(alerted, sizeof(alerted));
 }
 void
 drop_privileges(int unsecure)
@@ -168,12 +379,6 @@ drop_privileges(int unsecure)
             fatal("can't set effective user id: %.200s", strerror(errno));
     }
 }
-/* alarmhandler that gets called every symon_interval */
-void
-alarmhandler(int s)
-{
-    /* EMPTY */
-}
 void
 exithandler(int s)
 {
@@ -195,19 +400,19 @@ huphandler(int s)
  * - in a secure way.
  *
  * Measurements are processed by a second program called symux. symon and symux
- * communicate via udp.
+ * communicate via udp or tcp.
  */
 int
 main(int argc, char *argv[])
 {
     struct muxlist mul, newmul;
     struct stream *stream;
+    struct timeval tv, deadline;
     struct mux *mux;
-    time_t last_update;
     FILE *pidfile;
     char *cfgpath;
+    int missed;
     int ch;
-    int i;
 
     SLIST_INIT(&mul);
 
@@ -255,11 +460,15 @@ main(int argc, char *argv[])
 
     SLIST_FOREACH(mux, &mul, muxes) {
         /* privinit modules */
-        SLIST_FOREACH(stream, &mux->sl, streams) {
-            streamfunc[stream->type].used = 1;
-            if (streamfunc[stream->type].privinit != NULL)
-                streamfunc[stream->type].privinit(stream);
-        }
+        if (mux->leader == NULL)
+            SLIST_FOREACH(stream, &mux->sl, streams) {
+                streamfunc[stream->type].used = 1;
+                if (streamfunc[stream->type].privinit != NULL)
+                    streamfunc[stream->type].privinit(stream);
+            }
+
+        if (mux->spoolfile != NULL)
+            spool_open(mux);
     }
 
     if ((pidfile = fopen(SYMON_PID_FILE, "w")) == NULL)
@@ -288,18 +497,21 @@ main(int argc, char *argv[])
     if (flag_debug == 1)
         info("program id=%d", (u_int) getpid());
 
-    /* setup signal handlers */
-    signal(SIGALRM, alarmhandler);
-    signal(SIGHUP, huphandler);
-    signal(SIGINT, exithandler);
-    signal(SIGQUIT, exithandler);
-    signal(SIGTERM, exithandler);
+    /* setup signal handlers; they run from the event loop */
+    event_init();
+    event_signal(SIGHUP, huphandler);
+    event_signal(SIGINT, exithandler);
+    signal(SIGPIPE, SIG_IGN);
+    event_signal(SIGQUIT, exithandler);
+    event_signal(SIGTERM, exithandler);
 
     /* prepare crc32 */
     init_crc32();
 
     init_streams(&mul);
 
+    probe_start();
+
 #ifdef HAS_UNVEIL
     if (unveil(SYMON_PID_FILE, "w") == -1)
         fatal("unveil %s: %.200s", SYMON_PID_FILE, strerror(errno));
@@ -311,10 +523,14 @@ main(int argc, char *argv[])
         fatal("disable unveil: %.200s", strerror(errno));
 #endif
 
-    last_update = time(NULL);
     for (;;) {                  /* FOREVER */
-        sleep(symon_interval * 2);      /* alarm will interrupt sleep */
-        now = time(NULL);
+        /* hup ends the wait */
+        wait_for_deadline(&mul);
+
+        send_phased(&mul);
+
+        if (flag_alert)
+            send_alerts(&mul);
 
         if (flag_hup == 1) {
             flag_hup = 0;
@@ -326,10 +542,23 @@ main(int argc, char *argv[])
                     info("new configuration contains errors; keeping old configuration");
                     free_muxlist(&newmul);
                 } else {
+                    SLIST_FOREACH(mux, &mul, muxes) {
+                        if (mux->sendpending) {
+                            mux->sendpending = 0;
+                            send_packets(&mul, mux);
+                        }
+                        spool_close(mux);
+                        /* a stuck probe keeps the streams it measures */
+                        probe_detach(&mux->sl);
+                    }
                     free_muxlist(&mul);
                     mul = newmul;
                     info("read configuration file '%.200s' successfully", cfgpath);
 
+                    SLIST_FOREACH(mux, &mul, muxes)
+                        if (mux->spoolfile != NULL)
+                            spool_open(mux);
+
                     /* init modules */
                     init_streams(&mul);
                 }
@@ -337,46 +566,82 @@ main(int argc, char *argv[])
                 info("configuration unreachable because of privsep; keeping old configuration");
             }
         } else {
-            /* check timing to catch ntp drifts */
-            if (now < last_update ||
-                now > last_update + symon_interval + symon_interval) {
-                info("last update seems long ago - assuming system time change");
-                last_update = now;
-            } else if (now < last_update + symon_interval) {
-                debug("did not sleep %d seconds - skipping a measurement", symon_interval);
+            gettimeofday(&tv, NULL);
+
+            /* samples of aggregated streams; late ones are skipped */
+            if (symon_resolution && !timercmp(&tv, &next_subsample, <)) {
+                sample_streams(&mul, next_subsample.tv_usec / 1000);
+                align_subsample(&tv);
+            }
+
+            if (tv.tv_sec < next_sample) {
+                if (next_sample - tv.tv_sec > symon_interval) {
+                    info("system time went back - realigning measurements");
+                    next_sample = tv.tv_sec - (tv.tv_sec % symon_interval) +
+                        symon_interval;
+                    align_subsample(&tv);
+                }
                 continue;
             }
-            last_update = now;
 
-            /* populate for modules that get all their measurements in one
-             * go. we bunch up calls together to ensure that the measurements
-             * happen "at the same time" */
-            for (i = 0; i < MT_EOT; i++)
-                streamfunc[i].used = 0;
+            /* measurements that are overdue by a full interval are skipped */
+            missed = (tv.tv_sec - next_sample) / symon_interval;
+            if (missed > 0) {
+                info("skipping %d measurement(s) - system busy or time change",
+                     missed);
+                next_sample += (time_t) missed * symon_interval;
+            }
+
+            /* the deadline is the sample time, even when we wake up late */
+            now = next_sample;
+            next_sample += symon_interval;
+
+            /* follow objects that wildcard streams match */
+            expand_streams(&mul);
+
+            /* measure all due streams, with the modules running side by
+             * side, so that the measurements happen "at the same time". A
+             * module gets half an interval. */
+            probe_begin();
             SLIST_FOREACH(mux, &mul, muxes) {
-                mux->last += symon_interval;
-                if (mux->last >= mux->interval) {
-                    SLIST_FOREACH(stream, &mux->sl, streams) {
-                        if (streamfunc[stream->type].used == 0) {
-                            streamfunc[stream->type].used = 1;
-                            if (streamfunc[stream->type].gets != NULL)
-                                (streamfunc[stream->type].gets)();
-                        }
-                    }
+                if ((now % mux->interval) == 0 && mux->leader == NULL) {
+                    SLIST_FOREACH(stream, &mux->sl, streams)
+                        if (stream->agg == NULL && stream_due(stream, now))
+                            probe_add(stream);
                 }
             }
+            deadline.tv_sec = now + symon_interval / 2;
+            deadline.tv_usec = (symon_interval % 2) * 500000;
+            probe_run(&deadline);
 
             SLIST_FOREACH(mux, &mul, muxes) {
-                if (mux->last >= mux->interval) {
-                    mux->last = 0;
+                if ((now % mux->interval) == 0) {
+                    /* followers are sent to together with their leader */
+                    if (mux->leader != NULL)
+                        continue;
+
+                    /* a late packet is sent before it is overwritten */
+                    if (mux->sendpending) {
+                        mux->sendpending = 0;
+                        send_packets(&mul, mux);
+                    }
+
                     prepare_packet(mux, now);
 
                     SLIST_FOREACH(stream, &mux->sl, streams)
-                        stream_in_packet(stream, mux);
+                        if (!stream->pattern && stream_due(stream, now))
+                            stream_in_packet(stream, mux);
 
                     finish_packet(mux);
 
-                    send_packet(mux);
+                    if (mux->phase == 0) {
+                        send_packets(&mul, mux);
+                    } else {
+                        /* header keeps the sample time */
+                        mux->sendtime.tv_sec = now + mux->phase / 1000;
+                        mux->sendtime.tv_usec = (mux->phase % 1000) * 1000;
+                        mux->sendpending = 1;
+                    }
                 }
             }
         }
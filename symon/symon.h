@@ -36,6 +36,13 @@
 
 #define SYMON_PID_FILE "/var/run/symon.pid"
 #define SYMON_DEFAULT_INTERVAL 5        /* measurement interval */
+#define SYMON_DEFAULT_SPOOLSIZE 1024    /* spool size in kilobytes */
+#define SYMON_SPOOLREPLAY 100           /* spooled packets sent per interval */
+#define SYMON_PHASE_AUTO -1             /* derive phase from hostname and mux */
+#define SYMON_DEFAULT_RESOLUTION 100    /* ms between aggregated samples */
+#define SYMON_WORKERS 4                 /* threads available for probes */
+#define SYMON_MAXWORKERS 16             /* threads including stuck ones */
+#define SYMON_MAXBACKOFF 6              /* quarantine at most 2^6 intervals */
 
 /* funcmap holds functions to be called for the individual monitors:
  *
@@ -44,6 +51,8 @@
  * - gets     = called every monitor interval, can be used by modules that get
  *              all their measurements in one go.
  * - get      = obtain measurement
+ * - names    = name of the nth object seen by the last gets, NULL past the
+ *              end; used to expand wildcard arguments
  */
 struct funcmap {
     int type;
@@ -52,17 +61,35 @@ struct funcmap {
     void (*init) (struct stream *);
     void (*gets) (void);
     int (*get) (char *, int, struct stream *);
+    char *(*names) (int);
 };
 extern struct funcmap streamfunc[];
 
+extern int flag_unsecure;
 extern int symon_interval;
+extern int symon_resolution;
 extern time_t now;
+extern char *symon_plugindir;
 
 /* prototypes */
+/* symon.c */
+extern void stream_alert(int);
+
+/* sm_cgroup.c */
+extern void init_cgroup(struct stream *);
+extern void gets_cgroup(void);
+extern int get_cgroup(char *, int, struct stream *);
+extern char *names_cgroup(int);
+
 /* sm_cpu.c */
 extern void init_cpu(struct stream *);
 extern void gets_cpu(void);
 extern int get_cpu(char *, int, struct stream *);
+extern char *names_cpu(int);
+
+/* sm_cpuhist.c; shares gets_cpu */
+extern void init_cpuhist(struct stream *);
+extern int get_cpuhist(char *, int, struct stream *);
 
 /* sm_cpuiow.c */
 extern void init_cpuiow(struct stream *);
@@ -78,11 +105,13 @@ extern int get_mem(char *, int, struct stream *);
 extern void init_if(struct stream *);
 extern void gets_if(void);
 extern int get_if(char *, int, struct stream *);
+extern char *names_if(int);
 
 /* sm_io.c */
 extern void init_io(struct stream *);
 extern void gets_io(void);
 extern int get_io(char *, int, struct stream *);
+extern char *names_io(int);
 
 /* sm_pf.c */
 extern void privinit_pf(struct stream *);
@@ -113,12 +142,14 @@ extern int get_proc(char *, int, struct stream *);
 /* sm_sensor.c */
 extern void privinit_sensor(struct stream *);
 extern void init_sensor(struct stream *);
+extern void gets_sensor(void);
 extern int get_sensor(char *, int, struct stream *);
 
 /* sm_df.c */
 extern void init_df(struct stream *);
 extern void gets_df(void);
 extern int get_df(char *, int, struct stream *);
+extern char *names_df(int);
 
 /* sm_smart.c */
 extern void privinit_smart(struct stream *);
@@ -131,6 +162,17 @@ extern void init_load(struct stream *);
 extern void gets_load(void);
 extern int get_load(char *, int, struct stream *);
 
+/* sm_exec.c */
+extern void privinit_exec(struct stream *);
+extern void init_exec(struct stream *);
+extern int get_exec(char *, int, struct stream *);
+
+/* sm_pressure.c */
+extern void privinit_pressure(struct stream *);
+extern void init_pressure(struct stream *);
+extern void gets_pressure(void);
+extern int get_pressure(char *, int, struct stream *);
+
 /* sm_flukso.c */
 void init_flukso(struct stream *);
 void gets_flukso(void);
@@ -141,8 +183,33 @@ extern void init_wg(struct stream *);
 extern void gets_wg(void);
 extern int get_wg(char *, int, struct stream *);
 
+/* sm_plugin.c */
+extern void privinit_plugin(struct stream *);
+extern void init_plugin(struct stream *);
+extern void gets_plugin(void);
+extern int get_plugin(char *, int, struct stream *);
+
 /* sm_time.c */
 extern void init_time(struct stream *);
 extern int get_time(char *, int, struct stream *);
 
+/* aggregate.c */
+extern int aggregate_base(int);
+extern void init_aggregate(struct stream *);
+extern void sample_aggregate(struct stream *);
+extern int get_aggregate(char *, int, struct stream *);
+
+/* event.c */
+extern void event_init(void);
+extern void event_signal(int, void (*) (int));
+extern void event_watch(int, void (*) (int, void *), void *);
+extern void event_urgent(int, void (*) (int, void *), void *);
+extern void event_unwatch(int);
+extern void event_wait(struct timeval *);
+extern void event_wake(void);
+
+/* wildcard.c */
+extern int wildcard_type(int);
+extern void expand_streams(struct muxlist *);
+
 #endif                          /* _SYMON_SYMON_H */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Interface for symon probe plugins.
+ *
+ * A plugin is a shared object in the plugin directory of symon that exports
+ * a struct symon_plugin named symon_plugin. It is measured by plugin(name) or
+ * plugin(name:arg) streams, where name is the file name without ".so" and arg
+ * is passed to init.
+ *
+ * format declares the values of a measurement, one letter each in the order
+ * that get fills them: 'L' for an unsigned 64 bit counter and 'D' for a
+ * gauge, kept with 6 decimals. A plugin has at most SYMON_PLUGIN_MAXL
+ * counters and SYMON_PLUGIN_MAXD gauges.
+ *
+ * The shared object is loaded before symon drops its privileges; init is
+ * called for each stream after that and returns 0 on success, with state
+ * set to whatever the plugin needs for the stream. gets, when not NULL, is
+ * called once per measurement before the get calls of that measurement and
+ * on the same thread. get fills the preallocated, zeroed values and returns
+ * 1, or 0 if there is no measurement. Calls can take at most half of the
+ * measurement interval.
+ */
+#ifndef _SYMON_PLUGIN_H
+#define _SYMON_PLUGIN_H
+
+#include <stdint.h>
+
+#define SYMON_PLUGIN_ABI  1
+#define SYMON_PLUGIN_MAXL 8
+#define SYMON_PLUGIN_MAXD 8
+
+union symon_value {
+    uint64_t l;
+    double d;
+};
+
+struct symon_plugin {
+    int abi;                    /* SYMON_PLUGIN_ABI */
+    const char *format;
+    int (*init) (const char *arg, void **state);
+    void (*gets) (void);
+    int (*get) (void *state, union symon_value *values);
+};
+#endif                          /* _SYMON_PLUGIN_H */
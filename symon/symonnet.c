@@ -30,58 +30,402 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <netdb.h>
+#include <netinet/tcp.h>
 
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "conf.h"
 #include "error.h"
 #include "data.h"
 #include "symon.h"
 #include "net.h"
+#include "probe.h"
+#include "spool.h"
+#include "xmalloc.h"
+
+/* States of a tcp connection to a mux */
+#define TCP_CLOSED     0
+#define TCP_CONNECTING 1
+#define TCP_CONNECTED  2
+
+void tcp_connect(struct mux *);
+void tcp_close(struct mux *, int);
+void tcp_enqueue(struct mux *);
+void tcp_flush(struct mux *);
+void tcp_replay(struct mux *);
+void report_senderr(struct mux *);
+u_int32_t framelen(char *);
 
 /* Fill a mux structure with inet details */
 void
 connect2mux(struct mux * mux)
 {
-    struct sockaddr_storage sockaddr;
-
     int family;
 
-    bzero((void *) &sockaddr, sizeof(sockaddr));
+    bzero((void *) &mux->localsockaddr, sizeof(mux->localsockaddr));
 
-    get_mux_sockaddr(mux, SOCK_DGRAM);
+    get_mux_sockaddr(mux, mux->socktype);
     family = mux->sockaddr.ss_family;
 
-    get_sockaddr(&sockaddr, family, SOCK_DGRAM, AI_PASSIVE, mux->localaddr, "0");
+    get_sockaddr(&mux->localsockaddr, family, mux->socktype, AI_PASSIVE, mux->localaddr, "0");
+
+    if (mux->socktype == SOCK_STREAM) {
+        mux->queuesize = SYMON_TCPQUEUE * (SYMON_FRAMEHDR + mux->packet.size);
+        mux->queue = xmalloc(mux->queuesize);
+        mux->queuelen = mux->queuesent = 0;
+
+        info("sending packets to tcp %.200s", mux->name);
+        tcp_connect(mux);
+        return;
+    }
+
+    if (mux->leader != NULL && mux->leader->socktype == SOCK_DGRAM &&
+        mux->leader->sockaddr.ss_family == family &&
+        ((mux->localaddr == NULL && mux->leader->localaddr == NULL) ||
+         (mux->localaddr != NULL && mux->leader->localaddr != NULL &&
+          strcmp(mux->localaddr, mux->leader->localaddr) == 0))) {
+        /* packets are sent together with those of the leader */
+        info("sending packets to udp %.200s via socket of %.200s",
+             mux->name, mux->leader->name);
+        return;
+    }
 
     if ((mux->symuxsocket = socket(family, SOCK_DGRAM, 0)) == -1)
         fatal("could not obtain socket: %.200s", strerror(errno));
 
-    if (bind(mux->symuxsocket, (struct sockaddr *) & sockaddr, SS_LEN(&sockaddr)) == -1)
+    if (bind(mux->symuxsocket, (struct sockaddr *) & mux->localsockaddr, SS_LEN(&mux->localsockaddr)) == -1)
         fatal("could not bind socket: %.200s", strerror(errno));
 
     info("sending packets to udp %.200s", mux->name);
 }
+/* Start a non blocking tcp connection to a mux */
+void
+tcp_connect(struct mux * mux)
+{
+    int one = 1;
+    int flags;
+
+    mux->tcpstate = TCP_CLOSED;
+
+    if ((mux->symuxsocket = socket(mux->sockaddr.ss_family, SOCK_STREAM, 0)) == -1) {
+        warning("could not obtain socket: %.200s", strerror(errno));
+        mux->symuxsocket = 0;
+        return;
+    }
+
+    /* frames are batched by symon itself; do not let nagle delay them */
+    if (setsockopt(mux->symuxsocket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == -1)
+        warning("could not set socket options: %.200s", strerror(errno));
+
+    if (((flags = fcntl(mux->symuxsocket, F_GETFL)) == -1) ||
+        (fcntl(mux->symuxsocket, F_SETFL, flags | O_NONBLOCK) == -1) ||
+        (bind(mux->symuxsocket, (struct sockaddr *) & mux->localsockaddr, SS_LEN(&mux->localsockaddr)) == -1)) {
+        tcp_close(mux, errno);
+        return;
+    }
+
+    if (connect(mux->symuxsocket, (struct sockaddr *) & mux->sockaddr, SS_LEN(&mux->sockaddr)) == 0) {
+        mux->tcpstate = TCP_CONNECTED;
+        info("connected to mux(%.200s)", mux->name);
+    } else if (errno == EINPROGRESS) {
+        mux->tcpstate = TCP_CONNECTING;
+    } else {
+        tcp_close(mux, errno);
+    }
+}
+/* Close the connection to a mux; frames that were partially written are lost,
+ * unless they are spooled */
+void
+tcp_close(struct mux * mux, int error)
+{
+    u_int32_t len;
+
+    if (mux->tcpstate == TCP_CONNECTED)
+        warning("connection to mux(%.200s) lost: %.200s", mux->name, strerror(error));
+    else
+        debug("could not connect to mux(%.200s): %.200s", mux->name, strerror(error));
+
+    close(mux->symuxsocket);
+    mux->symuxsocket = 0;
+    mux->tcpstate = TCP_CLOSED;
+
+    if (mux->spool != NULL) {
+        /* unacknowledged packets are sent again from the spool */
+        mux->queuelen = mux->queuesent = 0;
+        spool_rewind(mux->spool);
+    } else if (mux->queuesent > 0) {
+        len = SYMON_FRAMEHDR + framelen(mux->queue);
+        memmove(mux->queue, mux->queue + len, mux->queuelen - len);
+        mux->queuelen -= len;
+        mux->queuesent = 0;
+        mux->senderr++;
+    }
+}
+/* Length of the packet in the frame at p */
+u_int32_t
+framelen(char *p)
+{
+    u_int16_t len;
+
+    bcopy(p, &len, sizeof(len));
+
+    return ntohs(len);
+}
+/* Append the current packet to the tcp queue. When the mux cannot keep up the
+ * oldest unsent frames are dropped. */
+void
+tcp_enqueue(struct mux * mux)
+{
+    u_int32_t keep, len, need;
+    u_int16_t nlen;
+
+    need = SYMON_FRAMEHDR + mux->packet.offset;
+    keep = (mux->queuesent > 0) ? SYMON_FRAMEHDR + framelen(mux->queue) : 0;
+
+    while ((mux->queuelen + need > mux->queuesize) && (mux->queuelen > keep)) {
+        len = SYMON_FRAMEHDR + framelen(mux->queue + keep);
+        memmove(mux->queue + keep, mux->queue + keep + len, mux->queuelen - keep - len);
+        mux->queuelen -= len;
+        mux->senderr++;
+    }
+
+    if (mux->queuelen + need > mux->queuesize) {
+        mux->senderr++;
+        return;
+    }
+
+    nlen = htons(mux->packet.offset);
+    bcopy(&nlen, mux->queue + mux->queuelen, SYMON_FRAMEHDR);
+    bcopy(mux->packet.data, mux->queue + mux->queuelen + SYMON_FRAMEHDR, mux->packet.offset);
+    mux->queuelen += need;
+}
+/* Write as much of the tcp queue as the connection will take without
+ * blocking. Whatever remains is sent together with the next packet. */
+void
+tcp_flush(struct mux * mux)
+{
+    struct pollfd pfd;
+    char acks[256];
+    socklen_t sl;
+    u_int32_t off, len;
+    ssize_t n;
+    int error;
+
+    if (mux->tcpstate == TCP_CLOSED)
+        tcp_connect(mux);
+
+    if (mux->tcpstate == TCP_CLOSED)
+        return;
+
+    pfd.fd = mux->symuxsocket;
+    pfd.events = POLLIN | POLLOUT;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) == -1)
+        return;
+
+    if (mux->tcpstate == TCP_CONNECTING) {
+        if (!(pfd.revents & (POLLOUT | POLLERR | POLLHUP)))
+            return;
+
+        error = 0;
+        sl = sizeof(error);
+        if (getsockopt(mux->symuxsocket, SOL_SOCKET, SO_ERROR, &error, &sl) == -1)
+            error = errno;
+
+        if (error) {
+            tcp_close(mux, error);
+            return;
+        }
+
+        mux->tcpstate = TCP_CONNECTED;
+        info("connected to mux(%.200s)", mux->name);
+    }
+
+    /* symux only talks back to acknowledge packets */
+    if (pfd.revents & (POLLIN | POLLHUP)) {
+        while ((n = recv(mux->symuxsocket, acks, sizeof(acks), 0)) > 0)
+            if (mux->spool != NULL)
+                spool_ack(mux->spool, acks, n);
+
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            tcp_close(mux, (n == 0) ? ECONNRESET : errno);
+            return;
+        }
+    }
+
+    while (mux->queuesent < mux->queuelen) {
+        n = send(mux->symuxsocket, mux->queue + mux->queuesent,
+                 mux->queuelen - mux->queuesent, 0);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                tcp_close(mux, errno);
+            break;
+        }
+        mux->queuesent += n;
+    }
+
+    /* drop frames that have been written completely */
+    off = 0;
+    while (off + SYMON_FRAMEHDR <= mux->queuesent) {
+        len = SYMON_FRAMEHDR + framelen(mux->queue + off);
+        if (off + len > mux->queuesent)
+            break;
+        off += len;
+    }
+
+    if (off > 0) {
+        memmove(mux->queue, mux->queue + off, mux->queuelen - off);
+        mux->queuelen -= off;
+        mux->queuesent -= off;
+    }
+}
+/* Move spooled frames that were not sent yet to the tcp queue. Spools are
+ * replayed at SYMON_SPOOLREPLAY packets per interval, oldest first. */
+void
+tcp_replay(struct mux * mux)
+{
+    char *frame;
+    u_int32_t len;
+    int n;
+
+    for (n = 0; n < SYMON_SPOOLREPLAY && mux->tcpstate == TCP_CONNECTED; n++) {
+        if ((frame = spool_next(mux->spool)) == NULL)
+            break;
+
+        len = SYMON_FRAMEHDR + framelen(frame);
+        if (mux->queuelen + len > mux->queuesize) {
+            tcp_flush(mux);
+            if (mux->tcpstate != TCP_CONNECTED ||
+                mux->queuelen + len > mux->queuesize)
+                break;
+        }
+
+        bcopy(frame, mux->queue + mux->queuelen, len);
+        mux->queuelen += len;
+        spool_sent(mux->spool);
+    }
+
+    if (mux->tcpstate == TCP_CONNECTED)
+        tcp_flush(mux);
+}
+/* Warn about lost packets every now and then */
+void
+report_senderr(struct mux * mux)
+{
+    if (mux->senderr >= SYMON_WARN_SENDERR) {
+        warning("%d updates to mux(%.200s) lost due to send errors",
+                mux->senderr, mux->name);
+        mux->senderr = 0;
+    }
+}
 /* Send data stored in the mux structure to a mux */
 void
 send_packet(struct mux * mux)
 {
-    if (sendto(mux->symuxsocket, mux->packet.data,
+    if (mux->socktype == SOCK_STREAM && mux->spool != NULL) {
+        mux->senderr += spool_push(mux->spool, mux->packet.data, mux->packet.offset);
+        tcp_flush(mux);
+        tcp_replay(mux);
+    } else if (mux->socktype == SOCK_STREAM) {
+        tcp_enqueue(mux);
+        tcp_flush(mux);
+    } else if (sendto(mux->symuxsocket, mux->packet.data,
                mux->packet.offset, 0, (struct sockaddr *) & mux->sockaddr,
                SS_LEN(&mux->sockaddr))
         != mux->packet.offset) {
         mux->senderr++;
     }
 
-    if (mux->senderr >= SYMON_WARN_SENDERR) {
-        warning("%d updates to mux(%.200s) lost due to send errors",
-                mux->senderr, mux->name);
-        mux->senderr = 0;
+    report_senderr(mux);
+}
+/*
+ * Send the packet of a leader to the leader and to all muxes that follow it.
+ * Udp muxes without a socket of their own go out over the leader socket in a
+ * single sendmmsg.
+ */
+void
+send_packets(struct muxlist * mul, struct mux * leader)
+{
+    static struct mux **targets = NULL;
+    static int maxtargets = 0;
+    struct mux *mux;
+    int i, n;
+#ifdef HAS_SENDMMSG
+    static struct mmsghdr *msgs = NULL;
+    struct iovec iov;
+    int sent;
+#endif
+
+    n = 0;
+    SLIST_FOREACH(mux, mul, muxes) {
+        if (mux != leader && mux->leader != leader)
+            continue;
+
+        if (mux->socktype == SOCK_DGRAM &&
+            (mux == leader || mux->symuxsocket == 0)) {
+            if (n == maxtargets) {
+                maxtargets += 8;
+                targets = xrealloc(targets, maxtargets * sizeof(struct mux *));
+#ifdef HAS_SENDMMSG
+                msgs = xrealloc(msgs, maxtargets * sizeof(struct mmsghdr));
+#endif
+            }
+            targets[n++] = mux;
+            continue;
+        }
+
+        if (mux != leader) {
+            bcopy(leader->packet.data, mux->packet.data, leader->packet.offset);
+            mux->packet.offset = leader->packet.offset;
+            mux->packet.header = leader->packet.header;
+        }
+        send_packet(mux);
+    }
+
+    if (n == 0)
+        return;
+
+#ifdef HAS_SENDMMSG
+    iov.iov_base = leader->packet.data;
+    iov.iov_len = leader->packet.offset;
+
+    bzero(msgs, n * sizeof(struct mmsghdr));
+    for (i = 0; i < n; i++) {
+        msgs[i].msg_hdr.msg_name = (void *) &targets[i]->sockaddr;
+        msgs[i].msg_hdr.msg_namelen = SS_LEN(&targets[i]->sockaddr);
+        msgs[i].msg_hdr.msg_iov = &iov;
+        msgs[i].msg_hdr.msg_iovlen = 1;
     }
+
+    for (i = 0; i < n; i += sent) {
+        if ((sent = sendmmsg(leader->symuxsocket, msgs + i, n - i, 0)) <= 0) {
+            /* skip the target that failed */
+            targets[i]->senderr++;
+            sent = 1;
+        }
+    }
+#else
+    for (i = 0; i < n; i++)
+        if (sendto(leader->symuxsocket, leader->packet.data,
+                   leader->packet.offset, 0,
+                   (struct sockaddr *) & targets[i]->sockaddr,
+                   SS_LEN(&targets[i]->sockaddr))
+            != leader->packet.offset)
+            targets[i]->senderr++;
+#endif
+
+    for (i = 0; i < n; i++)
+        report_senderr(targets[i]);
 }
 /* Prepare a packet for data */
 void
@@ -100,11 +444,18 @@ prepare_packet(struct mux * mux, time_t t)
 void
 stream_in_packet(struct stream * stream, struct mux * mux)
 {
-    mux->packet.offset +=
-        (streamfunc[stream->type].get)      /* call getter of stream */
-        (mux->packet.data + mux->packet.offset,    /* packet buffer */
-         mux->packet.size - mux->packet.offset,    /* maxlen */
-         stream);
+    /* aggregated streams are summarised here; the rest was measured by
+     * their probe */
+    if (stream->agg != NULL)
+        mux->packet.offset +=
+            (streamfunc[stream->type].get)  /* call getter of stream */
+            (mux->packet.data + mux->packet.offset,        /* packet buffer */
+             mux->packet.size - mux->packet.offset,        /* maxlen */
+             stream);
+    else
+        mux->packet.offset +=
+            probe_sample(stream, mux->packet.data + mux->packet.offset,
+                         mux->packet.size - mux->packet.offset);
 }
 /* Ready a packet for transmission, set length and crc */
 void
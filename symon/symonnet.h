@@ -36,6 +36,7 @@
 /* prototypes */
 void connect2mux(struct mux *);
 void send_packet(struct mux *);
+void send_packets(struct muxlist *, struct mux *);
 void prepare_packet(struct mux *, time_t t);
 void stream_in_packet(struct stream *, struct mux *);
 void finish_packet(struct mux *);
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2026 Willem Dijkstra
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    - Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    - Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Wildcard streams. A stream like if(veth*) is not measured itself; it is
+ * expanded into a stream per matching object that the module saw in its last
+ * gets. Expanded streams directly follow their wildcard stream in name order,
+ * so that packets keep a stable layout while objects come and go.
+ */
+#include <sys/types.h>
+
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "conf.h"
+#include "data.h"
+#include "error.h"
+#include "probe.h"
+#include "symon.h"
+#include "xmalloc.h"
+
+int wildcard_cmp(const void *, const void *);
+void expand_stream(struct mux *, struct stream *);
+
+static char **wc_names = NULL;
+static int wc_maxnames = 0;
+
+/* Can streams of this type have a wildcard argument on this platform */
+int
+wildcard_type(int type)
+{
+    return (streamfunc[type].names != NULL);
+}
+int
+wildcard_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+/* Bring the streams expanded from a wildcard in line with the module */
+void
+expand_stream(struct mux *mux, struct stream *wild)
+{
+    struct stream *prev, *stream;
+    char *name;
+    int i, n, cmp;
+
+    /* matching objects in name order, without duplicates */
+    n = 0;
+    for (i = 0; (name = (streamfunc[wild->type].names) (i)) != NULL; i++) {
+        if (strlen(name) >= SYMON_PS_ARGLENV2 || fnmatch(wild->arg, name, 0) != 0)
+            continue;
+
+        if (n == wc_maxnames) {
+            wc_maxnames = (wc_maxnames == 0) ? 64 : wc_maxnames * 2;
+            wc_names = xrealloc(wc_names, wc_maxnames * sizeof(char *));
+        }
+        wc_names[n++] = name;
+    }
+
+    qsort(wc_names, n, sizeof(char *), wildcard_cmp);
+
+    /* merge with the streams of the previous expansion */
+    prev = wild;
+    i = 0;
+    for (;;) {
+        while (i > 0 && i < n && strcmp(wc_names[i - 1], wc_names[i]) == 0)
+            i++;
+
+        stream = SLIST_NEXT(prev, streams);
+        if (stream != NULL && stream->origin != wild)
+            stream = NULL;
+
+        if (stream == NULL && i == n)
+            break;
+
+        if (stream == NULL)
+            cmp = 1;
+        else if (i == n)
+            cmp = -1;
+        else
+            cmp = strcmp(stream->arg, wc_names[i]);
+
+        if (cmp < 0) {
+            /* object went away */
+            debug("%.200s(%.200s) no longer matches %.200s",
+                  type2str(stream->type), stream->arg, wild->arg);
+            SLIST_NEXT(prev, streams) = SLIST_NEXT(stream, streams);
+            free_stream(stream);
+        } else if (cmp == 0) {
+            prev = stream;
+            i++;
+        } else {
+            /* new object; streams that are configured by name win */
+            if (find_mux_stream(mux, wild->type, wc_names[i]) == NULL) {
+                stream = create_stream(wild->type, wc_names[i]);
+                stream->origin = wild;
+                stream->interval = wild->interval;
+                SLIST_INSERT_AFTER(prev, stream, streams);
+                (streamfunc[stream->type].init) (stream);
+                debug("%.200s(%.200s) matches %.200s",
+                      type2str(stream->type), stream->arg, wild->arg);
+                prev = stream;
+            }
+            i++;
+        }
+    }
+}
+/* Expand all wildcard streams; modules that a probe is still busy with keep
+ * their current expansion */
+void
+expand_streams(struct muxlist *mul)
+{
+    struct stream *stream;
+    struct mux *mux;
+
+    SLIST_FOREACH(mux, mul, muxes) {
+        if (mux->leader != NULL)
+            continue;
+
+        SLIST_FOREACH(stream, &mux->sl, streams)
+            if (stream->pattern && !stream->uninit &&
+                !probe_busy(stream->type))
+                expand_stream(mux, stream);
+    }
+}
@@ -332,6 +332,95 @@ flukso_*.rrd)
         DS:watts:GAUGE:$INTERVAL:0:U
     ;;
 
+cpuagg[0-9]*.rrd)
+    # Build aggregated cpu file
+    create_rrd $i \
+	DS:busy_min:GAUGE:$INTERVAL:0:100 \
+	DS:busy_max:GAUGE:$INTERVAL:0:100 \
+	DS:busy_avg:GAUGE:$INTERVAL:0:100 \
+	DS:busy_p99:GAUGE:$INTERVAL:0:100
+    ;;
+
+cgroup_*.rrd)
+    # Build cgroup file; time in microseconds, memory in bytes
+    create_rrd $i \
+	DS:usage_usec:COUNTER:$INTERVAL:U:U DS:user_usec:COUNTER:$INTERVAL:U:U \
+	DS:system_usec:COUNTER:$INTERVAL:U:U DS:nr_throttled:COUNTER:$INTERVAL:U:U \
+	DS:throttled_usec:COUNTER:$INTERVAL:U:U DS:mem_current:GAUGE:$INTERVAL:0:U \
+	DS:mem_anon:GAUGE:$INTERVAL:0:U DS:mem_file:GAUGE:$INTERVAL:0:U \
+	DS:rbytes:COUNTER:$INTERVAL:U:U DS:wbytes:COUNTER:$INTERVAL:U:U \
+	DS:rios:COUNTER:$INTERVAL:U:U DS:wios:COUNTER:$INTERVAL:U:U \
+	DS:cpu_some:GAUGE:$INTERVAL:0:100 DS:mem_some:GAUGE:$INTERVAL:0:100 \
+	DS:mem_full:GAUGE:$INTERVAL:0:100
+    ;;
+
+pressure_*.rrd)
+    # Build pressure stall file; totals are microseconds stalled
+    create_rrd $i \
+	DS:some_avg10:GAUGE:$INTERVAL:0:100 DS:some_avg60:GAUGE:$INTERVAL:0:100 \
+	DS:some_avg300:GAUGE:$INTERVAL:0:100 DS:some_total:COUNTER:$INTERVAL:U:U \
+	DS:full_avg10:GAUGE:$INTERVAL:0:100 DS:full_avg60:GAUGE:$INTERVAL:0:100 \
+	DS:full_avg300:GAUGE:$INTERVAL:0:100 DS:full_total:COUNTER:$INTERVAL:U:U
+    ;;
+
+exec_*.rrd)
+    # Build external collector file
+    create_rrd $i \
+	DS:v0:GAUGE:$INTERVAL:U:U DS:v1:GAUGE:$INTERVAL:U:U \
+	DS:v2:GAUGE:$INTERVAL:U:U DS:v3:GAUGE:$INTERVAL:U:U \
+	DS:v4:GAUGE:$INTERVAL:U:U DS:v5:GAUGE:$INTERVAL:U:U \
+	DS:v6:GAUGE:$INTERVAL:U:U DS:v7:GAUGE:$INTERVAL:U:U
+    ;;
+
+plugin_*.rrd)
+    # Build plugin file; counters and gauges as declared by the plugin
+    create_rrd $i \
+	DS:c0:COUNTER:$INTERVAL:U:U DS:c1:COUNTER:$INTERVAL:U:U \
+	DS:c2:COUNTER:$INTERVAL:U:U DS:c3:COUNTER:$INTERVAL:U:U \
+	DS:c4:COUNTER:$INTERVAL:U:U DS:c5:COUNTER:$INTERVAL:U:U \
+	DS:c6:COUNTER:$INTERVAL:U:U DS:c7:COUNTER:$INTERVAL:U:U \
+	DS:g0:GAUGE:$INTERVAL:U:U DS:g1:GAUGE:$INTERVAL:U:U \
+	DS:g2:GAUGE:$INTERVAL:U:U DS:g3:GAUGE:$INTERVAL:U:U \
+	DS:g4:GAUGE:$INTERVAL:U:U DS:g5:GAUGE:$INTERVAL:U:U \
+	DS:g6:GAUGE:$INTERVAL:U:U DS:g7:GAUGE:$INTERVAL:U:U
+    ;;
+
+cpuhist.rrd)
+    # Build cpu histogram file; cpus per 10% busy bucket
+    create_rrd $i \
+	DS:b0_10:GAUGE:$INTERVAL:0:U DS:b10_20:GAUGE:$INTERVAL:0:U \
+	DS:b20_30:GAUGE:$INTERVAL:0:U DS:b30_40:GAUGE:$INTERVAL:0:U \
+	DS:b40_50:GAUGE:$INTERVAL:0:U DS:b50_60:GAUGE:$INTERVAL:0:U \
+	DS:b60_70:GAUGE:$INTERVAL:0:U DS:b70_80:GAUGE:$INTERVAL:0:U \
+	DS:b80_90:GAUGE:$INTERVAL:0:U DS:b90_100:GAUGE:$INTERVAL:0:U
+    ;;
+
+ifagg_*.rrd)
+    # Build aggregated interface files; rates per second
+    create_rrd $i \
+	DS:ibytes_min:GAUGE:$INTERVAL:0:U DS:ibytes_max:GAUGE:$INTERVAL:0:U \
+	DS:ibytes_avg:GAUGE:$INTERVAL:0:U DS:ibytes_p99:GAUGE:$INTERVAL:0:U \
+	DS:obytes_min:GAUGE:$INTERVAL:0:U DS:obytes_max:GAUGE:$INTERVAL:0:U \
+	DS:obytes_avg:GAUGE:$INTERVAL:0:U DS:obytes_p99:GAUGE:$INTERVAL:0:U \
+	DS:ipackets_min:GAUGE:$INTERVAL:0:U DS:ipackets_max:GAUGE:$INTERVAL:0:U \
+	DS:ipackets_avg:GAUGE:$INTERVAL:0:U DS:ipackets_p99:GAUGE:$INTERVAL:0:U \
+	DS:opackets_min:GAUGE:$INTERVAL:0:U DS:opackets_max:GAUGE:$INTERVAL:0:U \
+	DS:opackets_avg:GAUGE:$INTERVAL:0:U DS:opackets_p99:GAUGE:$INTERVAL:0:U
+    ;;
+
+ioagg_*.rrd)
+    # Build aggregated io files; rates per second
+    create_rrd $i \
+	DS:rbytes_min:GAUGE:$INTERVAL:0:U DS:rbytes_max:GAUGE:$INTERVAL:0:U \
+	DS:rbytes_avg:GAUGE:$INTERVAL:0:U DS:rbytes_p99:GAUGE:$INTERVAL:0:U \
+	DS:wbytes_min:GAUGE:$INTERVAL:0:U DS:wbytes_max:GAUGE:$INTERVAL:0:U \
+	DS:wbytes_avg:GAUGE:$INTERVAL:0:U DS:wbytes_p99:GAUGE:$INTERVAL:0:U \
+	DS:rxfer_min:GAUGE:$INTERVAL:0:U DS:rxfer_max:GAUGE:$INTERVAL:0:U \
+	DS:rxfer_avg:GAUGE:$INTERVAL:0:U DS:rxfer_p99:GAUGE:$INTERVAL:0:U \
+	DS:wxfer_min:GAUGE:$INTERVAL:0:U DS:wxfer_max:GAUGE:$INTERVAL:0:U \
+	DS:wxfer_avg:GAUGE:$INTERVAL:0:U DS:wxfer_p99:GAUGE:$INTERVAL:0:U
+    ;;
+
 wg_*.rrd)
     # Build wireguard files
     create_rrd $i \
@@ -44,7 +44,6 @@
 
 int read_mux(struct muxlist * mul, struct lex *);
 int read_source(struct sourcelist * sol, struct lex *, int);
-int insert_filename(char *, int, int, char *);
 
 const char *default_symux_port = SYMUX_PORT;
 
@@ -134,6 +133,38 @@ insert_filename(char *path, int maxlen, int type, char *args)
         ts = "wg_";
         ta = args;
         break;
+    case MT_CPUAGG:
+        ts = "cpuagg";
+        ta = args;
+        break;
+    case MT_IFAGG:
+        ts = "ifagg_";
+        ta = args;
+        break;
+    case MT_IOAGG:
+        ts = "ioagg_";
+        ta = args;
+        break;
+    case MT_CPUHIST:
+        ts = "cpuhist";
+        ta = "";
+        break;
+    case MT_CGROUP:
+        ts = "cgroup_";
+        ta = args;
+        break;
+    case MT_PLUGIN:
+        ts = "plugin_";
+        ta = args;
+        break;
+    case MT_EXEC:
+        ts = "exec_";
+        ta = args;
+        break;
+    case MT_PRESSURE:
+        ts = "pressure_";
+        ta = args;
+        break;
 
     default:
         warning("%.200s:%d: internal error: type (%d) unknown",
@@ -157,7 +188,7 @@ insert_filename(char *path, int maxlen, int type, char *args)
     xfree(fta);
     return result;
 }
-/* parse "'mux' (ip4addr | ip6addr | hostname) [['port' | ',' portnumber]" */
+/* parse "'mux' (ip4addr | ip6addr | hostname) [['port' | ',' portnumber] ['tcp']" */
 int
 read_mux(struct muxlist * mul, struct lex * l)
 {
@@ -193,6 +224,14 @@ read_mux(struct muxlist * mul, struct lex * l)
         mux->port = xstrdup((const char *) l->token);
     }
 
+    /* check for tcp statement; udp is always served */
+    lex_nexttoken(l);
+
+    if (l->op == LXT_TCP)
+        mux->socktype = SOCK_STREAM;
+    else
+        lex_ungettoken(l);
+
     bzero(&muxname, sizeof(muxname));
     snprintf(&muxname[0], sizeof(muxname), "%s %s", mux->addr, mux->port);
 
@@ -253,6 +292,14 @@ read_source(struct sourcelist * sol, struct lex * l, int filecheck)
                 case LXT_FLUKSO:
                 case LXT_TIME:
                 case LXT_WG:
+                case LXT_CPUAGG:
+                case LXT_IFAGG:
+                case LXT_IOAGG:
+                case LXT_CPUHIST:
+                case LXT_CGROUP:
+                case LXT_PLUGIN:
+                case LXT_EXEC:
+                case LXT_PRESSURE:
                     st = token2type(l->op);
                     strncpy(&sn[0], l->token, (_POSIX2_LINE_MAX - 1));
 
@@ -289,12 +336,14 @@ read_source(struct sourcelist * sol, struct lex * l, int filecheck)
                                 l->filename, l->cline, sn, sa);
                         return 0;
                     }
+                    /* matching streams are accepted when they arrive */
+                    stream->pattern = is_wildcard(sa);
 
                     break;      /* LXT_resource */
                 case LXT_COMMA:
                     break;
                 default:
-                    parse_error(l, "{cpu|cpuiow|df|if|if1|io|io1|mem|mem1|pf|pfq|mbuf|debug|proc|sensor|smart|load|flukso|wg|time}");
+                    parse_error(l, "{cpu|cpuiow|df|if|if1|io|io1|mem|mem1|pf|pfq|mbuf|debug|proc|sensor|smart|load|flukso|wg|time|cpuagg|ifagg|ioagg|cpuhist|cgroup|plugin|exec|pressure}");
                     return 0;
 
                     break;
@@ -342,7 +391,7 @@ read_source(struct sourcelist * sol, struct lex * l, int filecheck)
 
             /* add path to empty streams */
             SLIST_FOREACH(stream, &source->sl, streams) {
-                if (stream->file == NULL) {
+                if (stream->file == NULL && !stream->pattern) {
                     if (!(insert_filename(&path[pc],
                                           _POSIX2_LINE_MAX - pc,
                                           stream->type,
@@ -402,6 +451,14 @@ read_source(struct sourcelist * sol, struct lex * l, int filecheck)
             case LXT_LOAD:
             case LXT_FLUKSO:
             case LXT_WG:
+            case LXT_CPUAGG:
+            case LXT_IFAGG:
+            case LXT_IOAGG:
+            case LXT_CPUHIST:
+            case LXT_CGROUP:
+            case LXT_PLUGIN:
+            case LXT_EXEC:
+            case LXT_PRESSURE:
                 st = token2type(l->op);
                 strncpy(&sn[0], l->token, (_POSIX2_LINE_MAX - 1));
 
@@ -429,6 +486,13 @@ read_source(struct sourcelist * sol, struct lex * l, int filecheck)
 
                 lex_nexttoken(l);
 
+                if (is_wildcard(sa)) {
+                    warning("%.200s:%d: stream %.200s(%.200s) is a wildcard; "
+                            "its streams are written to the datadir",
+                            l->filename, l->cline, sn, sa);
+                    return 0;
+                }
+
                 if ((stream = find_source_stream(source, st, sa)) == NULL) {
                     if (strlen(sa)) {
                         warning("%.200s:%d: stream %.200s(%.200s) is not accepted for %.200s",
@@ -546,7 +610,10 @@ read_config_file(struct muxlist * mul, const char *filename, int filechecks)
                 return 0;
             } else {
                 SLIST_FOREACH(stream, &source->sl, streams) {
-                    if (stream->file == NULL) {
+                    if (stream->pattern && source->datadir == NULL) {
+                        warning("%.200s: wildcard stream '%.200s(%.200s)' in source '%.200s' needs a datadir",
+                                l->filename, type2str(stream->type), stream->arg, source->addr);
+                    } else if (stream->file == NULL && !stream->pattern) {
                         /* warn, but allow */
                         warning("%.200s: no filename specified for stream '%.200s(%.200s)' in source '%.200s'",
                                 l->filename, type2str(stream->type), stream->arg, source->addr);
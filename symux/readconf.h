@@ -34,6 +34,7 @@
 
 #include "data.h"
 
+int insert_filename(char *, int, int, char *);
 int read_config_file(struct muxlist *, const char *, int);
 
 #endif                          /* _SYMUX_READCONF_H */
@@ -37,13 +37,16 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <pwd.h>
 #include <rrd.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sysexits.h>
 #include <syslog.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "conf.h"
@@ -59,10 +62,18 @@
 #include "platform.h"
 
 char *drop_privileges(void);
+struct stream *accept_stream(struct source *, int, char *, char *, time_t);
+int expire_streams(struct source *, time_t);
+char *find_rrd(struct source *, struct stream *, char *);
+int store_sample(struct stream *, time_t, char *, int);
+int flush_samples(struct stream *);
+int flush_source(struct source *);
+int update_rrd(struct stream *, int, char **);
 
 int flag_testconf = 0;
 fd_set fdset;
 int maxfd;
+unsigned int rrderrors = 0;
 
 char *
 drop_privileges(void)
@@ -103,6 +114,242 @@ drop_privileges(void)
     return chrootdir;
 }
 
+/* Write samples ("timestamp:value:...") to the rrd file of a stream. Returns 0
+ * if rrdtool refused them. */
+int
+update_rrd(struct stream *stream, int n, char **samples)
+{
+    const char *arg_ra[3 + SYMUX_BACKFILL_BATCH];
+    int i;
+
+    /* clear optind for getopt call by rrdupdate */
+    optind = 0;
+    arg_ra[0] = "rrdupdate";
+    arg_ra[1] = "--";
+    arg_ra[2] = stream->file;
+    for (i = 0; i < n; i++)
+        arg_ra[3 + i] = samples[i];
+
+    rrd_update(3 + n, arg_ra);
+
+    if (rrd_test_error()) {
+        if (rrderrors < SYMUX_MAXRRDERRORS) {
+            rrderrors++;
+            warning("rrd_update:%.200s", rrd_get_error());
+            warning("%.200s %.200s %.200s %.200s%.200s", arg_ra[0], arg_ra[1],
+                arg_ra[2], arg_ra[3], (n > 1) ? " ..." : "");
+            if (rrderrors == SYMUX_MAXRRDERRORS) {
+                warning("maximum rrd errors reached - "
+                        "will stop reporting them");
+            }
+        }
+        rrd_clear_error();
+        return 0;
+    }
+
+    if (flag_debug == 1)
+        debug("%.200s %.200s %.200s %.200s%.200s", arg_ra[0], arg_ra[1],
+            arg_ra[2], arg_ra[3], (n > 1) ? " ..." : "");
+
+    return 1;
+}
+/* Write out samples that were held back for a batch update. Returns 0 if they
+ * could not be stored; the stream then remembers that until flush_source. */
+int
+flush_samples(struct stream *stream)
+{
+    int i, stored;
+
+    if (stream->npending == 0)
+        return 1;
+
+    stored = update_rrd(stream, stream->npending, stream->pending);
+
+    for (i = 0; i < stream->npending; i++)
+        xfree(stream->pending[i]);
+    stream->npending = 0;
+
+    /* have the rrd consulted again, so that a resend is not ignored */
+    if (!stored) {
+        stream->last = 0;
+        stream->failed = 1;
+    }
+
+    return stored;
+}
+/* Write out the held back samples of all streams of a source. Returns 0 if
+ * any batch since the last call could not be stored. */
+int
+flush_source(struct source *source)
+{
+    struct stream *stream;
+    int stored = 1;
+
+    SLIST_FOREACH (stream, &source->sl, streams) {
+        flush_samples(stream);
+        if (stream->failed)
+            stored = 0;
+        stream->failed = 0;
+    }
+
+    return stored;
+}
+/*
+ * Store a sample for a stream. Samples older than what the rrd file already
+ * holds are dropped here; rrdtool would refuse them anyway. Samples from a
+ * replayed spool are collected and written in a single rrd_update. Returns 1
+ * if the sample was held back.
+ */
+int
+store_sample(struct stream *stream, time_t timestamp, char *sample,
+    int backfill)
+{
+    time_t last;
+
+    if (stream->last == 0) {
+        last = rrd_last_r(stream->file);
+        if (rrd_test_error())
+            rrd_clear_error();
+        /* 1 = rrd consulted */
+        stream->last = (last > 0) ? last : 1;
+    }
+
+    if (timestamp <= stream->last) {
+        debug("%.200s: ignored sample of %u; already stored up to %u",
+            stream->file, (unsigned int)timestamp,
+            (unsigned int)stream->last);
+        return 0;
+    }
+    stream->last = timestamp;
+
+    if (backfill) {
+        if (stream->pending == NULL)
+            stream->pending = xmalloc(SYMUX_BACKFILL_BATCH * sizeof(char *));
+        stream->pending[stream->npending++] = xstrdup(sample);
+        if (stream->npending == SYMUX_BACKFILL_BATCH)
+            flush_samples(stream);
+        return 1;
+    }
+
+    flush_samples(stream);
+    if (!update_rrd(stream, 1, &sample)) {
+        debug("%.200s: sample of %u not stored", stream->file,
+            (unsigned int)timestamp);
+        stream->last = 0;
+    }
+    return 0;
+}
+
+/*
+ * Look for the rrd file that the datadir of source guesses for an accepted
+ * stream. Returns its name, or NULL if none can be guessed; the file of the
+ * stream is only set if it exists.
+ */
+char *
+find_rrd(struct source *source, struct stream *stream, char *chrootdir)
+{
+    static char path[_POSIX2_LINE_MAX];
+    char *file;
+    int fd, pc;
+
+    stream->tried = stream->seen;
+
+    snprintf(path, sizeof(path), "%s", source->datadir);
+    pc = strlen(path);
+    if (!insert_filename(&path[pc], sizeof(path) - pc, stream->type, stream->arg))
+        return NULL;
+
+    /* datadir is given outside of the chroot */
+    file = path;
+    if (chrootdir != NULL && strncmp(file, chrootdir, strlen(chrootdir)) == 0)
+        file += strlen(chrootdir);
+
+    if ((fd = open(file, O_RDWR | O_NONBLOCK, 0)) != -1) {
+        close(fd);
+        stream->file = xstrdup(file);
+    }
+
+    return file;
+}
+/*
+ * Forget the accepted streams of a source that have not sent samples for a
+ * while. Returns the number of accepted streams that are left.
+ */
+int
+expire_streams(struct source *source, time_t t)
+{
+    struct stream *stream, *prev, *next;
+    int n = 0;
+
+    prev = NULL;
+    for (stream = SLIST_FIRST(&source->sl); stream != NULL; stream = next) {
+        next = SLIST_NEXT(stream, streams);
+        if (stream->origin == NULL || t - stream->seen < SYMUX_ACCEPT_AGE) {
+            if (stream->origin != NULL)
+                n++;
+            prev = stream;
+            continue;
+        }
+
+        info("forgot %.200s(%.200s) from %.200s; no samples since %d s",
+             type2str(stream->type), stream->arg, source->addr,
+             (int)(t - stream->seen));
+        flush_samples(stream);
+        if (prev == NULL)
+            SLIST_FIRST(&source->sl) = next;
+        else
+            SLIST_NEXT(prev, streams) = next;
+        free_stream(stream);
+    }
+
+    return n;
+}
+/*
+ * Accept a stream that matches a wildcard of its source. Its samples are
+ * stored in the datadir, if the rrd file for it exists.
+ */
+struct stream *
+accept_stream(struct source *source, int type, char *arg, char *chrootdir,
+    time_t t)
+{
+    struct stream *stream, *wild;
+    char *file;
+
+    SLIST_FOREACH(wild, &source->sl, streams) {
+        if (wild->pattern && wild->type == type &&
+            fnmatch(wild->arg, arg, 0) == 0)
+            break;
+    }
+
+    if (wild == NULL)
+        return NULL;
+
+    if (expire_streams(source, t) >= SYMUX_MAXACCEPT) {
+        debug("ignored %.200s(%.200s) from %.200s; %d streams accepted already",
+              type2str(type), arg, source->addr, SYMUX_MAXACCEPT);
+        return NULL;
+    }
+
+    if ((stream = add_source_stream(source, type, arg)) == NULL)
+        return NULL;
+
+    stream->origin = wild;
+    stream->seen = t;
+
+    if (source->datadir == NULL ||
+        (file = find_rrd(source, stream, chrootdir)) == NULL)
+        return stream;
+
+    if (stream->file != NULL)
+        info("accepted %.200s(%.200s) from %.200s into '%.200s'",
+             type2str(type), arg, source->addr, file);
+    else
+        info("accepted %.200s(%.200s) from %.200s; no file '%.200s' to store it",
+             type2str(type), arg, source->addr, file);
+
+    return stream;
+}
+
 /*
  * symux is the receiver of symon performance measurements.
  *
@@ -128,9 +375,9 @@ main(int argc, char *argv[])
     char *stringbuf;
     char *stringptr;
     char *chrootdir = NULL;
+    char *sample;
     int maxstringlen;
     struct muxlist mul;
-    const char *arg_ra[4];
     struct stream *stream;
     struct source *source;
     struct sourcelist *sol;
@@ -142,9 +389,12 @@ main(int argc, char *argv[])
     int flag_list;
     int offset;
     int result;
-    unsigned int rrderrors;
+    int backfill;
+    int pending;
+    int stored;
+    struct symonconn *conn;
     int len;
-    time_t timestamp;
+    time_t timestamp, t;
 
     SLIST_INIT(&mul);
 
@@ -342,7 +592,10 @@ main(int argc, char *argv[])
     if (get_symon_sockets(mux) == 0)
         fatal("no sockets could be opened for incoming symon traffic");
 
-    rrderrors = 0;
+    /* symon connections can go away while we write acknowledgements */
+    signal(SIGPIPE, SIG_IGN);
+
+    pending = 0;
 #ifdef HAS_PLEDGE
     if (pledge("stdio rpath wpath flock", NULL) == -1)
         fatal("pledge failed %s", strerror(errno));
@@ -350,7 +603,34 @@ main(int argc, char *argv[])
 
     /* main loop */
     for (;;) { /* FOREVER */
-        wait_for_traffic(mux, &source);
+        wait_for_traffic(mux, &source, pending ? SYMUX_BACKFILL_WAIT : -1);
+
+        if (source == NULL) {
+            /* traffic stopped; write held back samples and ack them */
+            if (pending) {
+                SLIST_FOREACH (source, &mux->sol, sources)
+                    release_symon_packets(mux, source, flush_source(source));
+                pending = 0;
+            }
+            continue;
+        }
+
+        /* more packets of this source are queued; it is catching up */
+        backfill = mux->backlog;
+        t = time(NULL);
+
+        /* the replay is over; store what it held back before new samples */
+        stored = 1;
+        if (!backfill && pending)
+            stored = flush_source(source);
+
+        /* a lost replay is sent again; newer samples would overtake it */
+        if (!stored) {
+            conn = mux->ackconn;
+            release_symon_packets(mux, source, 0);
+            if (conn != NULL && mux->ackconn == NULL)
+                continue;
+        }
 
         /*
          * Put information from packet into stringbuf (shared region).
@@ -382,7 +662,19 @@ main(int argc, char *argv[])
             }
 
             /* find stream in source */
-            stream = find_source_stream(source, ps.type, ps.arg);
+            if ((stream = find_source_stream(source, ps.type, ps.arg)) == NULL)
+                stream = accept_stream(source, ps.type, ps.arg, chrootdir, t);
+
+            /* rrd files of accepted streams may be created later on */
+            if (stream != NULL && stream->origin != NULL) {
+                stream->seen = t;
+                if (stream->file == NULL && source->datadir != NULL &&
+                    t - stream->tried >= SYMUX_ACCEPT_RETRY &&
+                    find_rrd(source, stream, chrootdir) != NULL &&
+                    stream->file != NULL)
+                    info("storing %.200s(%.200s) from %.200s into '%.200s'",
+                         type2str(ps.type), ps.arg, source->addr, stream->file);
+            }
 
             if (stream != NULL) {
                 /* put type and arg in and hide from rrd */
@@ -393,48 +685,16 @@ main(int argc, char *argv[])
                 /* put timestamp in and show to rrd */
                 snprintf(stringptr, maxstringlen, "%u",
                          (unsigned int)timestamp);
-                arg_ra[3] = stringptr;
+                sample = stringptr;
                 maxstringlen -= strlen(stringptr);
                 stringptr += strlen(stringptr);
 
                 /* put measurements in */
                 ps2strn(&ps, stringptr, maxstringlen, PS2STR_RRD);
 
-                if (stream->file != NULL) {
-                    /* clear optind for getopt call by rrdupdate */
-                    optind = 0;
-                    /* save if file specified */
-                    arg_ra[0] = "rrdupdate";
-                    arg_ra[1] = "--";
-                    arg_ra[2] = stream->file;
-
-                    /*
-                     * This call will cost a lot (symux will become
-                     * unresponsive and eat up massive amounts of cpu) if
-                     * the rrdfile is out of sync.
-                     */
-                    rrd_update(4, arg_ra);
-
-                    if (rrd_test_error()) {
-                        if (rrderrors < SYMUX_MAXRRDERRORS) {
-                            rrderrors++;
-                            warning("rrd_update:%.200s", rrd_get_error());
-                            warning("%.200s %.200s %.200s %.200s",
-                                    arg_ra[0], arg_ra[1], arg_ra[2],
-                                    arg_ra[3]);
-                            if (rrderrors == SYMUX_MAXRRDERRORS) {
-                                warning("maximum rrd errors reached - "
-                                        "will stop reporting them");
-                            }
-                        }
-                        rrd_clear_error();
-                    } else {
-                        if (flag_debug == 1)
-                            debug("%.200s %.200s %.200s %.200s",
-                                  arg_ra[0], arg_ra[1], arg_ra[2],
-                                  arg_ra[3]);
-                    }
-                }
+                if (stream->file != NULL)
+                    pending |= store_sample(stream, timestamp, sample, backfill);
+
                 maxstringlen -= strlen(stringptr);
                 stringptr += strlen(stringptr);
                 snprintf(stringptr, maxstringlen, ";");
@@ -453,10 +713,23 @@ main(int argc, char *argv[])
         snprintf(stringptr, maxstringlen, "\n");
         stringptr += strlen(stringptr);
         len = (stringptr - stringbuf);
-        if (fifofd != -1 && write(fifofd, stringbuf, len) < len) {
+        /* fifo clients want current data, not a replayed spool */
+        if (!backfill && fifofd != -1 && write(fifofd, stringbuf, len) < len) {
             debug("write is short -- no client listening?");
         }
         debug("churnbuffer used: %d", len);
+
+        /*
+         * A replayed spool is only acked once its samples are in the rrd
+         * files; symon keeps unacked packets and sends them again.
+         */
+        if (backfill) {
+            hold_symon_packet(mux);
+            pending = 1;
+        } else {
+            release_symon_packets(mux, source, 1);
+            ack_symon_packet(mux);
+        }
     } /* forever */
 
     /* NOT REACHED */
@@ -42,6 +42,27 @@
 /* Number of retries allowed in recvfrom */
 #define SYMUX_MAXREADTRIES 5
 
+/* Maximum number of concurrent symon tcp connections */
+#define SYMUX_MAXCONN 4096
+
+/* Minimum read buffer for a symon tcp connection */
+#define SYMUX_CONNBUFSIZE 16384
+
+/* Samples of a replayed spool written per rrd_update */
+#define SYMUX_BACKFILL_BATCH 64
+
+/* Milliseconds without traffic before held back samples are written */
+#define SYMUX_BACKFILL_WAIT 1000
+
+/* Streams a source can have accepted through its wildcards */
+#define SYMUX_MAXACCEPT 1024
+
+/* Seconds without samples before an accepted stream is forgotten */
+#define SYMUX_ACCEPT_AGE 86400
+
+/* Seconds between looks for the missing rrd file of an accepted stream */
+#define SYMUX_ACCEPT_RETRY 300
+
 /* Number of rrd errors logged before smothering sets in */
 #define SYMUX_MAXRRDERRORS 5
 
@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -45,7 +46,11 @@
 #include "symuxnet.h"
 #include "xmalloc.h"
 
-int check_crc_packet(struct symonpacket *);
+int check_crc_packet(struct symonpacket *, unsigned int);
+int get_symon_listener(struct mux *, int);
+int recv_symon_frame(struct mux *, struct symonconn *, struct source **);
+int ack_frame(struct mux *, struct symonconn *);
+void close_connection(struct mux *, struct symonconn *);
 
 /* Obtain sockets for incoming symon traffic */
 int
@@ -78,7 +83,7 @@ get_symon_sockets(struct mux *mux)
                         SO_REUSEADDR, &one, sizeof(one))
                     == -1) {
                     warning(
-                        "could set socket options: %.200s", strerror(errno));
+                        "could not set socket options: %.200s", strerror(errno));
                 }
 
                 /*
@@ -132,48 +137,353 @@ get_symon_sockets(struct mux *mux)
                 }
             }
         }
+
+        if (mux->socktype == SOCK_STREAM && mux->symonlistener[family] <= 0)
+            nsocks += get_symon_listener(mux, family);
     }
     return nsocks;
 }
+/* Obtain a tcp listen socket for family; returns 1 if successful */
+int
+get_symon_listener(struct mux *mux, int family)
+{
+    struct sockaddr_storage sockaddr;
+    int flags, sock, one = 1;
+
+    if ((sock = socket(family, SOCK_STREAM, 0)) == -1) {
+        warning("could not obtain socket: %.200s", strerror(errno));
+        return 0;
+    }
+
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1)
+        warning("could not set socket options: %.200s", strerror(errno));
+
+    if (mux->sockaddr.ss_family == family) {
+        cpysock((struct sockaddr *)&mux->sockaddr, &sockaddr);
+    } else {
+        get_sockaddr(
+            &sockaddr, family, SOCK_STREAM, AI_PASSIVE, NULL, mux->port);
+    }
+
+    if (((flags = fcntl(sock, F_GETFL)) == -1)
+        || (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
+        || (bind(sock, (struct sockaddr *)&sockaddr, SS_LEN(&sockaddr)) == -1)
+        || (listen(sock, SOMAXCONN) == -1)) {
+        warning("mux tcp port %.200s unavailable: %.200s", mux->port,
+            strerror(errno));
+        close(sock);
+        return 0;
+    }
+
+    mux->symonlistener[family] = sock;
+
+    if (get_numeric_name(&sockaddr))
+        info("listening for incoming symon traffic on tcp for family %d",
+            family);
+    else
+        info("listening for incoming symon traffic on tcp %.200s %.200s",
+            res_host, res_service);
+
+    return 1;
+}
+/* Accept a tcp connection from a symon on listen socket sock */
+int
+accept_connection(struct mux *mux, int sock)
+{
+    struct sockaddr_storage sind;
+    struct symonconn *conn;
+    struct source *source;
+    socklen_t sl;
+    int fd, flags, nconn, one = 1;
+
+    sl = sizeof(sind);
+    if ((fd = accept(sock, (struct sockaddr *)&sind, &sl)) == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR
+            && errno != ECONNABORTED)
+            warning("accept failed: %.200s", strerror(errno));
+        return 0;
+    }
+
+    source = find_source_sockaddr(&mux->sol, (struct sockaddr *)&sind);
+    get_numeric_name(&sind);
+
+    if (source == NULL) {
+        debug("ignored connection from %.200s:%.200s", res_host, res_service);
+        close(fd);
+        return 0;
+    }
+
+    nconn = 0;
+    SLIST_FOREACH (conn, &mux->cl, conns)
+        nconn++;
+
+    if (nconn >= SYMUX_MAXCONN) {
+        warning("too many connections; refused %.200s:%.200s", res_host,
+            res_service);
+        close(fd);
+        return 0;
+    }
+
+    if (((flags = fcntl(fd, F_GETFL)) == -1)
+        || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        warning("could not set socket to non blocking: %.200s",
+            strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    /* notice symon hosts that disappear without closing */
+    if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one)) == -1)
+        warning("could not set socket options: %.200s", strerror(errno));
+
+    conn = xmalloc(sizeof(struct symonconn));
+    bzero(conn, sizeof(struct symonconn));
+    conn->fd = fd;
+    conn->source = source;
+    cpysock((struct sockaddr *)&sind, &conn->sockaddr);
+    /* room for several frames, so that spool replays can be batched */
+    conn->size = SYMON_FRAMEHDR + mux->packet.size;
+    if (conn->size < SYMUX_CONNBUFSIZE)
+        conn->size = SYMUX_CONNBUFSIZE;
+    conn->data = xmalloc(conn->size);
+    SLIST_INSERT_HEAD(&mux->cl, conn, conns);
+
+    info("accepted connection from %.200s:%.200s", res_host, res_service);
+
+    return 1;
+}
+/* Forget a tcp connection */
+void
+close_connection(struct mux *mux, struct symonconn *conn)
+{
+    get_numeric_name(&conn->sockaddr);
+    info("connection from %.200s:%.200s closed", res_host, res_service);
+
+    if (mux->ackconn == conn)
+        mux->ackconn = NULL;
+
+    SLIST_REMOVE(&mux->cl, conn, symonconn, conns);
+    close(conn->fd);
+    xfree(conn->data);
+    xfree(conn);
+}
+/*
+ * Take the next complete frame buffered for a connection and put it in the
+ * mux packet. Returns 1 if a valid packet was found.
+ */
+int
+recv_symon_frame(struct mux *mux, struct symonconn *conn,
+    struct source **source)
+{
+    u_int16_t nlen;
+    u_int32_t len;
+
+    for (;;) {
+        /* discard remainder of an oversized frame */
+        if (conn->skip > 0) {
+            len = (conn->skip < conn->len) ? conn->skip : conn->len;
+            memmove(conn->data, conn->data + len, conn->len - len);
+            conn->len -= len;
+            conn->skip -= len;
+            if (conn->skip > 0)
+                return 0;
+        }
+
+        if (conn->len < SYMON_FRAMEHDR)
+            return 0;
+
+        bcopy(conn->data, &nlen, sizeof(nlen));
+        len = ntohs(nlen);
+
+        if (len > mux->packet.size) {
+            get_numeric_name(&conn->sockaddr);
+            warning("ignored oversized packet from %.200s:%.200s; client "
+                    "and server have different stream configurations",
+                res_host, res_service);
+            conn->skip = SYMON_FRAMEHDR + len;
+            continue;
+        }
+
+        if (conn->len < SYMON_FRAMEHDR + len)
+            return 0;
+
+        bcopy(conn->data + SYMON_FRAMEHDR, mux->packet.data, len);
+        bcopy(conn->data + SYMON_FRAMEHDR, &conn->ack, sizeof(conn->ack));
+        conn->len -= SYMON_FRAMEHDR + len;
+        memmove(conn->data, conn->data + SYMON_FRAMEHDR + len, conn->len);
+
+        get_numeric_name(&conn->sockaddr);
+        if (check_crc_packet(&mux->packet, len)) {
+            *source = conn->source;
+
+            /* a burst of waiting frames is a spool being replayed */
+            mux->backlog = 0;
+            if (conn->len >= SYMON_FRAMEHDR) {
+                bcopy(conn->data, &nlen, sizeof(nlen));
+                len = ntohs(nlen);
+                mux->backlog = (conn->len >= SYMON_FRAMEHDR + len);
+            }
+            mux->ackconn = conn;
+            return 1;
+        }
+
+        /* bad frames will not get better by sending them again */
+        if (!ack_frame(mux, conn))
+            return 0;
+    }
+}
+/* Acknowledge the last frame received on conn. Returns 0 if the connection
+ * had to be closed. */
+int
+ack_frame(struct mux *mux, struct symonconn *conn)
+{
+    /* a partial ack would garble the ack stream; start over instead */
+    if (send(conn->fd, &conn->ack, sizeof(conn->ack), 0)
+        != sizeof(conn->ack)) {
+        close_connection(mux, conn);
+        return 0;
+    }
+
+    return 1;
+}
+/* Acknowledge the current packet if it came in over tcp */
+void
+ack_symon_packet(struct mux *mux)
+{
+    if (mux->ackconn != NULL)
+        ack_frame(mux, mux->ackconn);
+
+    mux->ackconn = NULL;
+}
+/* Hold back the ack of the current packet until its samples are stored. Acks
+ * are cumulative, so the ack of a later frame also covers this one. */
+void
+hold_symon_packet(struct mux *mux)
+{
+    if (mux->ackconn != NULL)
+        mux->ackconn->held = 1;
+
+    mux->ackconn = NULL;
+}
+/*
+ * Send the held back acks of a source once its samples are stored. If storing
+ * failed the connections are closed instead: acks are cumulative, so only a
+ * reconnect has symon send the unacked packets again.
+ */
+void
+release_symon_packets(struct mux *mux, struct source *source, int stored)
+{
+    struct symonconn *conn, *nconn;
+
+    for (conn = SLIST_FIRST(&mux->cl); conn != NULL; conn = nconn) {
+        nconn = SLIST_NEXT(conn, conns);
+        if (conn->source != source || !conn->held)
+            continue;
+        conn->held = 0;
+        if (stored) {
+            ack_frame(mux, conn);
+        } else {
+            get_numeric_name(&conn->sockaddr);
+            warning("replayed samples from %.200s:%.200s could not be stored; "
+                    "closing the connection to have them sent again",
+                res_host, res_service);
+            close_connection(mux, conn);
+        }
+    }
+}
 
 /*
  * Wait for traffic (symon reports from a source in sourcelist)
- * Returns the <source> and <packet>
+ * Returns the <source> and <packet>, or a NULL <source> if nothing arrived
+ * within timeout milliseconds (-1 = forever) or a signal was received.
  */
 void
-wait_for_traffic(struct mux *mux, struct source **source)
+wait_for_traffic(struct mux *mux, struct source **source, int timeout)
 {
-    fd_set readset;
-    int i;
-    int socksactive;
-    int maxsock;
+    static struct pollfd *pfd = NULL;
+    static int maxpfd = 0;
+    struct symonconn *conn, *nconn;
+    int i, n, npfd, first;
+    ssize_t size;
+
+    *source = NULL;
+    mux->ackconn = NULL;
+    mux->backlog = 0;
 
     for (;;) { /* FOREVER - until a valid symon packet is
                 * received */
-        FD_ZERO(&readset);
+        /* frames that are already buffered go first */
+        for (conn = SLIST_FIRST(&mux->cl); conn != NULL; conn = nconn) {
+            nconn = SLIST_NEXT(conn, conns);
+            if (recv_symon_frame(mux, conn, source))
+                return;
+        }
+
+        n = 2 * AF_MAX;
+        SLIST_FOREACH (conn, &mux->cl, conns)
+            n++;
+
+        if (n > maxpfd) {
+            maxpfd = n;
+            pfd = xrealloc(pfd, maxpfd * sizeof(struct pollfd));
+        }
 
-        maxsock = 0;
+        npfd = 0;
         for (i = 0; i < AF_MAX; i++) {
             if (mux->symonsocket[i] > 0) {
-                FD_SET(mux->symonsocket[i], &readset);
-                maxsock
-                    = ((maxsock < mux->symonsocket[i]) ? mux->symonsocket[i]
-                                                       : maxsock);
+                pfd[npfd].fd = mux->symonsocket[i];
+                pfd[npfd++].events = POLLIN;
             }
         }
+        for (i = 0; i < AF_MAX; i++) {
+            if (mux->symonlistener[i] > 0) {
+                pfd[npfd].fd = mux->symonlistener[i];
+                pfd[npfd++].events = POLLIN;
+            }
+        }
+        first = npfd;
+        SLIST_FOREACH (conn, &mux->cl, conns) {
+            pfd[npfd].fd = conn->fd;
+            pfd[npfd++].events = POLLIN;
+        }
 
-        maxsock++;
-        socksactive = select(maxsock, &readset, NULL, NULL, NULL);
-
-        if (socksactive != -1) {
-            for (i = 0; i < AF_MAX; i++)
-                if (FD_ISSET(mux->symonsocket[i], &readset)) {
-                    if (recv_symon_packet(mux, i, source))
-                        return;
-                }
-        } else {
+        switch (poll(pfd, npfd, timeout)) {
+        case -1:
             if (errno == EINTR)
                 return; /* signal received while waiting, bail out */
+            continue;
+        case 0:
+            return;
+        }
+
+        /* read connections before accepting new ones to keep pfd in sync */
+        n = first;
+        for (conn = SLIST_FIRST(&mux->cl); conn != NULL; conn = nconn) {
+            nconn = SLIST_NEXT(conn, conns);
+            if (pfd[n++].revents == 0)
+                continue;
+
+            size = read(conn->fd, conn->data + conn->len,
+                conn->size - conn->len);
+            if (size > 0)
+                conn->len += size;
+            else if (size == 0 || (errno != EAGAIN && errno != EINTR))
+                close_connection(mux, conn);
+        }
+
+        n = 0;
+        for (i = 0; i < AF_MAX; i++) {
+            if (mux->symonsocket[i] > 0) {
+                if ((pfd[n++].revents & POLLIN)
+                    && recv_symon_packet(mux, i, source))
+                    return;
+            }
+        }
+        for (i = 0; i < AF_MAX; i++) {
+            if (mux->symonlistener[i] > 0) {
+                if (pfd[n++].revents & POLLIN)
+                    accept_connection(mux, mux->symonlistener[i]);
+            }
         }
     }
 }
@@ -187,7 +497,6 @@ recv_symon_packet(struct mux *mux, int socknr, struct source **source)
     socklen_t sl;
     int size, tries;
     unsigned int received;
-    u_int32_t crc;
 
     received = 0;
     tries = 0;
@@ -217,36 +526,51 @@ recv_symon_packet(struct mux *mux, int socknr, struct source **source)
     if (*source == NULL) {
         debug("ignored data from %.200s:%.200s", res_host, res_service);
         return 0;
+    }
+
+    if (!check_crc_packet(&mux->packet, received)) {
+        *source = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+/* Check crc and version of a packet of received bytes. The sender must be in
+ * res_host and res_service for reporting. Returns 1 if the packet is valid.
+ */
+int
+check_crc_packet(struct symonpacket *packet, unsigned int received)
+{
+    u_int32_t crc;
+
+    /* get header stream */
+    packet->offset = getheader(packet->data, &packet->header);
+    /* check crc */
+    crc = packet->header.crc;
+    packet->header.crc = 0;
+    setheader(packet->data, &packet->header);
+    crc ^= crc32(packet->data, received);
+    if (crc != 0) {
+        if (packet->header.length > packet->size)
+            warning("ignored oversized packet from %.200s:%.200s; client "
+                    "and server have different stream configurations",
+                res_host, res_service);
+        else
+            warning("ignored packet with bad crc from %.200s:%.200s",
+                res_host, res_service);
+        return 0;
+    }
+    /* check packet version */
+    if (packet->header.symon_version > SYMON_PACKET_VER) {
+        warning("ignored packet with unsupported version %d from "
+                "%.200s:%.200s",
+            packet->header.symon_version, res_host, res_service);
+        return 0;
     } else {
-        /* get header stream */
-        mux->packet.offset = getheader(mux->packet.data, &mux->packet.header);
-        /* check crc */
-        crc = mux->packet.header.crc;
-        mux->packet.header.crc = 0;
-        setheader(mux->packet.data, &mux->packet.header);
-        crc ^= crc32(mux->packet.data, received);
-        if (crc != 0) {
-            if (mux->packet.header.length > mux->packet.size)
-                warning("ignored oversized packet from %.200s:%.200s; client "
-                        "and server have different stream configurations",
-                    res_host, res_service);
-            else
-                warning("ignored packet with bad crc from %.200s:%.200s",
-                    res_host, res_service);
-            return 0;
-        }
-        /* check packet version */
-        if (mux->packet.header.symon_version > SYMON_PACKET_VER) {
-            warning("ignored packet with unsupported version %d from "
-                    "%.200s:%.200s",
-                mux->packet.header.symon_version, res_host, res_service);
-            return 0;
-        } else {
-            if (flag_debug) {
-                debug("good data received from %.200s:%.200s", res_host,
-                    res_service);
-            }
-            return 1; /* good packet received */
+        if (flag_debug) {
+            debug("good data received from %.200s:%.200s", res_host,
+                res_service);
         }
+        return 1; /* good packet received */
     }
 }
@@ -35,7 +35,10 @@
 
 /* prototypes */
 int get_symon_sockets(struct mux *);
-int accept_connection(int);
+int accept_connection(struct mux *, int);
 int recv_symon_packet(struct mux *, int, struct source **);
-void wait_for_traffic(struct mux *, struct source **);
+void ack_symon_packet(struct mux *);
+void hold_symon_packet(struct mux *);
+void release_symon_packets(struct mux *, struct source *, int);
+void wait_for_traffic(struct mux *, struct source **, int);
 #endif /* _SYMUX_SYMUXNET_H */